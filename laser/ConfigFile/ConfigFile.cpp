@@ -21,126 +21,215 @@
  * 
  */
 #include "ConfigFile.h"
+#include "LaosLog.h"
 
-// Make new config file object
-ConfigFile::ConfigFile(char *file) 
+// parser states
+#define CF_LINE 0     // start of a line
+#define CF_KEY 1      // reading the key
+#define CF_SPACE 2    // skip white space between key and value
+#define CF_VALUE 3    // reading the value
+#define CF_COMMENT 4  // skip upto eol
+
+typedef struct {
+  unsigned short hash;
+  unsigned short key;   // offset of the key in cf_text
+  unsigned short value; // offset of the value in cf_text
+} tConfigKey;
+
+// The table is only used during boot: keep it out of the main RAM
+static tConfigKey cf_keys[CONFIG_MAX_KEYS] __attribute__((section("AHBSRAM0")));
+static char cf_text[CONFIG_TEXT_SIZE] __attribute__((section("AHBSRAM0")));
+static int cf_nkeys, cf_used;
+
+// 16 bit FNV-1a (folded)
+static unsigned short cf_hash(const char *s)
+{
+  unsigned long h = 2166136261UL;
+  while (*s)
+  {
+    h ^= (unsigned char)*s++;
+    h *= 16777619UL;
+  }
+  return (h >> 16) ^ (h & 0xffff);
+}
+
+// Make new config file object, read the complete file
+ConfigFile::ConfigFile(const char *file) 
 {
   printf("ConfigFile:ConfigFile (%s)\n\r", file);
   extern LaosFileSystem sd;
-  fp =sd.openfile(file, "r");
+  FILE *fp = sd.openfile((char*)file, "r");
   if (fp==NULL) {
     char tmpname[32];
-    sprintf(tmpname, "/local/%s", file);
+    snprintf(tmpname, sizeof(tmpname), "/local/%s", file);
     fp = fopen(tmpname,"r");
   } 
+  cf_nkeys = cf_used = 0;
+  m_Full = false;
+  m_Open = (fp != NULL);
+  if ( fp != NULL )
+  {
+    Parse(fp);
+    fclose(fp);
+  }
+  if ( m_Full )
+    LOG_WARN(LOG_CONFIG, "Config file too large, %d keys read\n\r", cf_nkeys);
 }
 
-// Destroy a config file (closes the file handle)
 ConfigFile::~ConfigFile() 
 {
-  if ( fp != NULL )
-    fclose(fp);
 }
 
-// Read value
-bool ConfigFile::Value(const std::string& key, char *value,  size_t maxlen, const std::string& def)
+// Read the file in blocks and fill the table
+void ConfigFile::Parse(FILE *fp)
 {
-  unsigned int m=0,n=0,c,s=0;
-  char *v = value;
-  char *newkey = new char[key.size()+1];
-  strcpy(newkey, key.c_str());
-  if (fp == NULL)
+  char buf[64];
+  size_t n;
+  m_State = CF_LINE;
+  while ( (n = fread(buf, 1, sizeof(buf), fp)) > 0 )
   {
-    strncpy(value, def.c_str(), maxlen);
-    return false;
-  }
-
-  n = strlen(newkey);
-  fseek(fp, 0L, SEEK_SET);
-  while( s != 99  ) 
-  {
-    c = fgetc(fp);
-    if ( c == EOF ) 
-      break;
-    // printf("%d(%d): '%c'\n\r", s, m, c);
-    switch( s  )// sate machine
-    { 
-      case 0: // (re) start: note: no break; fall through to case 1
-        m=0; 
-        s=1;
-      case 1: // read newkey, skip spaces
-        if ( c == newkey[m] ) 
-          m++; 
-        else 
-          s = 0;
-        if ( c == ';' ) 
-          s = 10; 
-        else if ( c == ' ' || c == '\t' || c == '\n' || c == '\r') 
-        {
-          if ( n == m ) // newkey found
+    for (size_t i=0; i < n; i++)
+    {
+      char c = buf[i];
+      bool eol = (c == '\n' || c == '\r');
+      bool space = (c == ' ' || c == '\t');
+      switch( m_State )
+      {
+        case CF_LINE:
+          if ( c == ';' ) 
+            m_State = CF_COMMENT;
+          else if ( !eol && !space )
+          {
+            m_Key = cf_used;
+            Add(c);
+            m_State = CF_KEY;
+          }
+          break;
+        case CF_KEY: // a key without a value is ignored
+          if ( space )
+          {
+            EndKey();
+            m_State = CF_SPACE;
+          }
+          else if ( eol || c == ';' )
           {
-            s = 2;
-            m = 0; 
+            cf_used = m_Key;
+            m_State = (eol ? CF_LINE : CF_COMMENT);
           }
           else
-            s = 0;
-        }
-        break;
-      case 2: // newkey matched, skip whitepaces upto the first char
-        if ( c == ';' ) s = 99;
-        else if ( c != ' ' && c != '\t' ) 
-        { 
-          s = 3;
-          m = 1;
-          if ( m < maxlen) 
-            *value++ = c;
-        }
-        break;
-        
-      case 3: // copy value content, upto eol or comment
-        if ( m == maxlen || c == '\n' || c == '\r' || c == ';' ) 
-          s = 99;
-        else
-        {
-          m++;
-          *value++ = c;
-        }
-        break;         
-      case 10: // skip comments, upto eol or eof
-        if ( c == '\n' || c == '\r' ) s = 0;
-        break;
-     }
+            Add(c);
+          break;
+        case CF_SPACE: // an empty value hides later values of the same key
+          if ( eol || c == ';' ) 
+          {
+            EndValue();
+            m_State = (eol ? CF_LINE : CF_COMMENT);
+          }
+          else if ( !space )
+          {
+            Add(c);
+            m_State = CF_VALUE;
+          }
+          break;
+        case CF_VALUE: // copy value content, upto eol or comment
+          if ( eol || c == ';' )
+          {
+            EndValue();
+            m_State = (eol ? CF_LINE : CF_COMMENT);
+          }
+          else
+            Add(c);
+          break;
+        case CF_COMMENT: // skip comments, upto eol or eof
+          if ( eol ) 
+            m_State = CF_LINE;
+          break;
+      }
+    }
+  }
+  if ( m_State == CF_SPACE || m_State == CF_VALUE )
+    EndValue();
+}
+
+// Add a char to the text pool
+void ConfigFile::Add(char c)
+{
+  if ( cf_used < CONFIG_TEXT_SIZE-1 )
+    cf_text[cf_used++] = c;
+  else
+    m_Full = true;
+}
+
+// Terminate the key, the value starts after it
+void ConfigFile::EndKey()
+{
+  Add(0);
+  if ( cf_nkeys < CONFIG_MAX_KEYS )
+  {
+    cf_keys[cf_nkeys].hash = cf_hash(cf_text + m_Key);
+    cf_keys[cf_nkeys].key = m_Key;
+    cf_keys[cf_nkeys].value = cf_used;
+  }
+  else
+    m_Full = true;
+}
+
+// Terminate the value (without trailing white space) and store the entry
+void ConfigFile::EndValue()
+{
+  tConfigKey *k = &cf_keys[cf_nkeys];
+  if ( m_Full ) // do not store truncated text
+  {
+    cf_used = m_Key;
+    return;
   }
-  if ( s == 99 && m > 0) // newkey found, and value assigned
+  while ( cf_used > k->value && (cf_text[cf_used-1] == ' ' || cf_text[cf_used-1] == '\t') )
+    cf_used--;
+  Add(0);
+  if ( m_Full )
+    cf_used = m_Key;
+  else
+    cf_nkeys++;
+}
+
+// Find the value of a key, NULL if it is not there
+const char *ConfigFile::Find(const char *key)
+{
+  unsigned short h = cf_hash(key);
+  for (int i=0; i < cf_nkeys; i++)
+    if ( cf_keys[i].hash == h && !strcmp(cf_text + cf_keys[i].key, key) )
+      return cf_text + cf_keys[i].value;
+  return NULL;
+}
+
+// Read value
+bool ConfigFile::Value(const char *key, char *value, size_t maxlen, const char *def)
+{
+  const char *v = Find(key);
+  if ( v != NULL && *v ) // key found, and value assigned
   {
-    *value = 0; // terminate string
-    printf("'%s'='%s'\n\r", newkey,v);
+    strncpy(value, v, maxlen-1);
+    value[maxlen-1] = 0; // terminate string
+    LOGSTR2(LOG_LEVEL_DEBUG, LOG_CONFIG, "'%s'='%s'\n\r", key, value);
     return true; 
   }
   else
   {
-    strncpy(value, def.c_str(), maxlen);
-    printf("'%s'='%s' (default)\n\r", newkey,v);
+    strncpy(value, def, maxlen-1);
+    value[maxlen-1] = 0;
+    LOGSTR2(LOG_LEVEL_DEBUG, LOG_CONFIG, "'%s'='%s' (default)\n\r", key, value);
     return false;
   } 
 }
 
 // Read int value
-bool ConfigFile::Value(const std::string& key, int *value, int def)
+bool ConfigFile::Value(const char *key, int *value, int def)
 {
-  char *newkey = new char[key.size()+1];
-  strcpy(newkey, key.c_str());
   char val[32];
-  bool b = Value(newkey, val, 31, "");
+  bool b = Value(key, val, sizeof(val), "");
   if ( b )
-  {
     *value = atoi(val);
-     // printf("%s: numeric value=%d\n\r", newkey, *value);
-  }
   else
-  {
     *value = def;
-     // printf("%s default (%d)\n\r", newkey, *value);
-  }
   return b;
 }
@@ -22,7 +22,11 @@
  * Reads a setting, based on the key. (case sensitive)
  * If the key is not found, the default value is returned.
  *
- * Simple, not (time) efficient. For every request, the complete file is reset and read again
+ * The file is read once, in blocks, when the object is made. All keys and
+ * values are stored in a static table (CONFIG_MAX_KEYS entries, with the
+ * text in a CONFIG_TEXT_SIZE pool), so a Value() call does not touch the
+ * file. The first occurrence of a key wins. There is one table: only one
+ * ConfigFile object can be in use at a time.
  *
  @code 
  file format
@@ -44,11 +48,12 @@
 #include "global.h"
 #include "laosfilesystem.h"
 
+#define CONFIG_MAX_KEYS 128   // max number of keys in a file
+#define CONFIG_TEXT_SIZE 2048 // room for all keys and values [bytes]
+
     /** Simple config file object
-      * Only supports reading config files. Tries to limit memory usage.
-      * Note: the file handle is kept open during the lifetime of this object.
-      * To close the file: destroy this ConfigFile object! A simple way is to enclose the creation
-      * of this object inside a code block
+      * Only supports reading config files. Does not use the heap.
+      * The file is closed as soon as it is read.
       * Example:
       * @code 
       * char ip[16];
@@ -62,12 +67,10 @@
       */
 class ConfigFile {
 public:
-    /** Make new ConfigFile object. Open config file.
-      * Note: the file handle is kept open during the lifetime of this object.
-      * To close the file: destroy this ConfigFile object!
+    /** Make new ConfigFile object. Open the config file and read all settings.
       * @param file Filename of the configuration file.
       */
-    ConfigFile(char *name);
+    ConfigFile(const char *name);
 
     ~ConfigFile();
 
@@ -78,7 +81,7 @@ public:
   * @param def Default value. If the key is not found in the file, this value is copied. 
   * @return "true" if the key is found "false" is key is not found (default value is returned)
   */ 
-    bool Value(const std::string& key, char *value,  size_t maxlen, const std::string& def);
+    bool Value(const char *key, char *value, size_t maxlen, const char *def);
 
 /** Read Integer value. If file is not open, or key does not exist: copy default value (return false)
   * @param key name of the key in the file
@@ -86,16 +89,25 @@ public:
   * @param def Default value. If the key is not found in the file, this value is copied. 
   * @return "true" if the key is found "false" is key is not found (default value is returned)
   */ 
-    bool Value(const std::string& key, int *value, int def);
+    bool Value(const char *key, int *value, int def);
     
   /** See if file was present
   * @return "true" if file is open, "false" file is not found 
   */ 
-  bool IsOpen(void) { return fp != NULL; }
+  bool IsOpen(void) { return m_Open; }
   
 private:
-    FILE *fp;
+    void Parse(FILE *fp);
+    void Add(char c);
+    void EndKey();
+    void EndValue();
+    const char *Find(const char *key);
 
+private:
+    bool m_Open;
+    int m_State;        // parser state
+    int m_Key;          // offset of the key being read in the text pool
+    bool m_Full;        // table or text pool ran out
 };
 
 
@@ -0,0 +1,72 @@
+/**
+ * LaosBoot.cpp
+ * Boot phase timing
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include "LaosBoot.h"
+
+typedef struct {
+  const char *name;
+  int start;            // [ms]
+  volatile int end;     // [ms], -1 while the phase runs
+} tBootPhase;
+
+static tBootPhase boot_phases[BOOT_PHASES];
+static int boot_count = 0;
+
+int boot_begin(const char *name, int ms)
+{
+  if (boot_count == BOOT_PHASES)
+    return -1;
+  tBootPhase *p = &boot_phases[boot_count];
+  p->name = name;
+  p->start = ms;
+  p->end = -1;
+  return boot_count++;
+}
+
+void boot_end(int p, int ms)
+{
+  if (p >= 0 && p < boot_count)
+    boot_phases[p].end = ms;
+}
+
+bool boot_done(int p)
+{
+  return (p < 0) || (p >= boot_count) || (boot_phases[p].end >= 0);
+}
+
+void boot_print()
+{
+  int total = 0;
+  printf("Boot phases [ms]:\n\r");
+  for (int i = 0; i < boot_count; i++)
+  {
+    tBootPhase *p = &boot_phases[i];
+    if (p->end < 0)
+    {
+      printf("  %-10s %6d .. (running)\n\r", p->name, p->start);
+      continue;
+    }
+    printf("  %-10s %6d .. %6d  %6d\n\r", p->name, p->start, p->end, p->end - p->start);
+    if (p->end > total)
+      total = p->end;
+  }
+  printf("  ready after %d ms\n\r", total);
+}
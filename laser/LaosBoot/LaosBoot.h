@@ -0,0 +1,53 @@
+/**
+ * LaosBoot.h
+ * Boot phase timing
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * main() marks the start and end of each boot phase. Phases may overlap
+ * (the network comes up in its own thread while the machine homes), so
+ * each phase has its own start and end time. The times are passed in, so
+ * this has no mbed dependencies.
+ *
+ * Only boot_begin() adds a phase: call it from one thread. boot_end() may
+ * be called from another thread.
+ *
+ @code
+ int p = boot_begin("config", systime.read_ms());
+ cfg = new GlobalConfig("config.txt");
+ boot_end(p, systime.read_ms());
+ ...
+ boot_print();
+ @endcode
+ */
+#ifndef LAOSBOOTH
+#define LAOSBOOTH
+
+#define BOOT_PHASES 12
+
+// Start a phase at time ms; returns its index (-1 if the table is full)
+int boot_begin(const char *name, int ms);
+
+// End phase p at time ms
+void boot_end(int p, int ms);
+
+// True if phase p has ended
+bool boot_done(int p);
+
+// Print all phases on the serial port
+void boot_print();
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * LaosCheckpoint.cpp
+ * Job checkpoints on the SD card, to resume an interrupted job
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stddef.h>
+#include "LaosCheckpoint.h"
+
+// open the checkpoint file
+static FILE *checkpoint_open(const char *mode)
+{
+  extern LaosFileSystem sd;
+  char fullname[MAXFILESIZE+SHORTFILESIZE+1];
+  sprintf(fullname, "%s%s", sd.pathname, CHECKPOINT_FILE);
+  return fopen(fullname, mode);
+}
+
+// checksum of the record, up to the checksum field
+static unsigned long checkpoint_checksum(const tCheckpoint *cp)
+{
+  const unsigned char *p = (const unsigned char *)cp;
+  unsigned long sum = 0;
+  for (unsigned int i = 0; i < offsetof(tCheckpoint, checksum); i++)
+    sum = (sum << 5) + (sum >> 27) + p[i];
+  return sum;
+}
+
+bool checkpoint_load(tCheckpoint *cp)
+{
+  extern LaosFileSystem sd;
+  FILE *fp = checkpoint_open("rb");
+  if (fp == NULL)
+    return false;
+  bool ok = (fread(cp, sizeof(tCheckpoint), 1, fp) == 1) && (cp->magic == CHECKPOINT_MAGIC) &&
+    (cp->checksum == checkpoint_checksum(cp)) && cp->name[0];
+  fclose(fp);
+  if (!ok)
+    return false;
+  // the job must still be there, unchanged
+  fp = sd.openfile(cp->name, "rb");
+  if (fp == NULL)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  unsigned long size = ftell(fp);
+  fclose(fp);
+  return (size == cp->size) && (cp->offset > 0) && ((unsigned long)cp->offset <= size);
+}
+
+// Overwrite the record in place: no FAT update while a job runs
+void checkpoint_save(const tCheckpoint *cp)
+{
+  tCheckpoint rec = *cp;
+  rec.magic = CHECKPOINT_MAGIC;
+  rec.checksum = checkpoint_checksum(&rec);
+  FILE *fp = checkpoint_open("r+b");
+  if (fp == NULL)
+    fp = checkpoint_open("w+b");
+  if (fp == NULL)
+    return;
+  fwrite(&rec, sizeof(tCheckpoint), 1, fp);
+  fclose(fp);
+}
+
+void checkpoint_clear()
+{
+  tCheckpoint cp;
+  FILE *fp = checkpoint_open("r+b");
+  if (fp == NULL)
+    return;
+  memset(&cp, 0, sizeof(cp));
+  fwrite(&cp, sizeof(cp), 1, fp);
+  fclose(fp);
+}
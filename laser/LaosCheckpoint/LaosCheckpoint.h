@@ -0,0 +1,67 @@
+/**
+ * LaosCheckpoint.h
+ * Job checkpoints on the SD card, to resume an interrupted job
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * While a job runs, the menu takes a checkpoint every sys.checkpoint
+ * seconds, at a simplecode command boundary: the file offset, the origin
+ * and the parser state of LaosMotion. It is only written to CHECKPOINT_FILE
+ * once the stepper has executed all moves queued up to that point, so
+ * after a power loss the machine has really been there. A job that
+ * completes removes the checkpoint; a cancelled one keeps it. The record
+ * starts with CHECKPOINT_MAGIC and ends with a checksum: one of another
+ * firmware version, or one that was not completely written, is ignored.
+ *
+ * RESUME JOB homes the machine, restores the origin and the parser
+ * state, moves (laser off) to the checkpoint position and continues
+ * reading the file at the offset.
+ *
+ @code
+ tCheckpoint cp;
+ if (checkpoint_load(&cp)) ...
+ @endcode
+ */
+#ifndef LAOSCHECKPOINTH
+#define LAOSCHECKPOINTH
+
+#include "laosfilesystem.h"
+#include "LaosMotion.h"
+
+#define CHECKPOINT_FILE "resume.sys"
+#define CHECKPOINT_MAGIC 0x4c435032 // "LCP2": change it with the layout of tCheckpoint
+
+typedef struct {
+  unsigned long magic;      // CHECKPOINT_MAGIC, set by checkpoint_save()
+  char name[MAXFILESIZE];   // long file name of the job
+  unsigned long size;       // file size [bytes]
+  long offset;              // continue reading here [bytes]
+  int origin[3];            // absolute origin x, y, z [micron]
+  tMotionState state;       // LaosMotion parser state at the offset
+  unsigned long checksum;   // of all fields before it, set by checkpoint_save()
+} tCheckpoint;
+
+// Read the checkpoint; false if there is none, it is not valid, or the job
+// file has changed
+bool checkpoint_load(tCheckpoint *cp);
+
+// Store the checkpoint, replacing the previous one
+void checkpoint_save(const tCheckpoint *cp);
+
+// Remove the checkpoint
+void checkpoint_clear();
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * LaosCurve.cpp
+ * Flatten arcs and cubic Bezier curves into line segments
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <math.h>
+#include "LaosCurve.h"
+
+#define lround(x) ( (long)floor(x+0.5) )
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+LaosCurve::LaosCurve()
+{
+  m_Tolerance = 10;
+  m_Index = m_Count = 0;
+  m_X0 = m_Y0 = m_X = m_Y = 0;
+  m_Type = ctArc;
+}
+
+void LaosCurve::SetTolerance(int tolerance)
+{
+  m_Tolerance = (tolerance < 1) ? 1 : tolerance;
+}
+
+// number of segments, at least 1
+int LaosCurve::Limit(float n)
+{
+  if ( !(n < LAOSCURVE_MAX_SEGMENTS) ) return LAOSCURVE_MAX_SEGMENTS;
+  return (n < 1) ? 1 : (int)ceil(n);
+}
+
+// Arc from x0,y0 to x,y around cx,cy; a full circle if start and end are equal
+void LaosCurve::Arc(int x0, int y0, int x, int y, int cx, int cy, bool ccw)
+{
+  m_Type = ctArc;
+  m_X0 = x0; m_Y0 = y0;
+  m_X = x; m_Y = y;
+  m_Cx = cx; m_Cy = cy;
+  m_R0 = sqrt((x0-m_Cx)*(x0-m_Cx) + (y0-m_Cy)*(y0-m_Cy));
+  m_R1 = sqrt((x-m_Cx)*(x-m_Cx) + (y-m_Cy)*(y-m_Cy));
+  m_A0 = atan2(y0 - m_Cy, x0 - m_Cx);
+  m_Sweep = atan2(y - m_Cy, x - m_Cx) - m_A0;
+  if ( ccw && m_Sweep <= 0 ) m_Sweep += 2*M_PI;
+  if ( !ccw && m_Sweep >= 0 ) m_Sweep -= 2*M_PI;
+
+  // the chord of angle a deviates r*(1-cos(a/2)) from the arc
+  float r = (m_R0 > m_R1) ? m_R0 : m_R1;
+  float c = 1 - (m_Tolerance - 0.5) / (r > 0 ? r : 1); // 0.5: rounding to micron
+  float a = 2 * acos(c > 0 ? c : 0);
+  m_Count = Limit(fabs(m_Sweep) / a);
+  m_Index = 0;
+}
+
+// Cubic Bezier from x0,y0 to x,y, control points x1,y1 and x2,y2
+void LaosCurve::Bezier(int x0, int y0, int x1, int y1, int x2, int y2, int x, int y)
+{
+  m_Type = ctBezier;
+  m_X0 = x0; m_Y0 = y0;
+  m_X = x; m_Y = y;
+  m_P[0] = x1; m_P[1] = y1;
+  m_P[2] = x2; m_P[3] = y2;
+
+  // n equal steps of t deviate at most 3/4 * L / n^2 from the curve, with L
+  // the largest second difference of the control points
+  float ax = x0 - 2.0*x1 + x2, ay = y0 - 2.0*y1 + y2;
+  float bx = x1 - 2.0*x2 + x, by = y1 - 2.0*y2 + y;
+  float l = fmax(sqrt(ax*ax + ay*ay), sqrt(bx*bx + by*by));
+  m_Count = Limit(sqrt(0.75 * l / (m_Tolerance - 0.5)));
+  m_Index = 0;
+}
+
+bool LaosCurve::Next(int &x, int &y)
+{
+  if ( m_Index >= m_Count )
+    return false;
+  m_Index++;
+  if ( m_Index == m_Count )
+  {
+    x = m_X;
+    y = m_Y;
+    return true;
+  }
+  float t = (float)m_Index / m_Count;
+  if ( m_Type == ctArc )
+  {
+    float a = m_A0 + t * m_Sweep;
+    float r = m_R0 + t * (m_R1 - m_R0);
+    x = lround(m_Cx + r * cos(a));
+    y = lround(m_Cy + r * sin(a));
+  }
+  else
+  {
+    float u = 1 - t;
+    float b0 = u*u*u, b1 = 3*u*u*t, b2 = 3*u*t*t, b3 = t*t*t;
+    x = lround(b0*m_X0 + b1*m_P[0] + b2*m_P[2] + b3*m_X);
+    y = lround(b0*m_Y0 + b1*m_P[1] + b2*m_P[3] + b3*m_Y);
+  }
+  return true;
+}
+
+// extend min..max with the Bezier coordinate (p0..p3) where its derivative is 0
+static void bezier_extremes(float p0, float p1, float p2, float p3, float &min, float &max)
+{
+  float a = -p0 + 3*p1 - 3*p2 + p3;
+  float b = 2 * (p0 - 2*p1 + p2);
+  float c = p1 - p0;
+  float t[2];
+  int n = 0;
+  if ( fabs(a) < 1e-6 )
+  {
+    if ( fabs(b) > 1e-6 ) t[n++] = -c / b;
+  }
+  else
+  {
+    float d = b*b - 4*a*c;
+    if ( d >= 0 )
+    {
+      t[n++] = (-b + sqrt(d)) / (2*a);
+      t[n++] = (-b - sqrt(d)) / (2*a);
+    }
+  }
+  for ( int i = 0; i < n; i++ )
+  {
+    if ( t[i] <= 0 || t[i] >= 1 ) continue;
+    float u = 1 - t[i];
+    float v = u*u*u*p0 + 3*u*u*t[i]*p1 + 3*u*t[i]*t[i]*p2 + t[i]*t[i]*t[i]*p3;
+    if ( v < min ) min = v;
+    if ( v > max ) max = v;
+  }
+}
+
+void LaosCurve::GetBounds(int &minx, int &miny, int &maxx, int &maxy) const
+{
+  float x0 = (m_X0 < m_X) ? m_X0 : m_X, x1 = (m_X0 < m_X) ? m_X : m_X0;
+  float y0 = (m_Y0 < m_Y) ? m_Y0 : m_Y, y1 = (m_Y0 < m_Y) ? m_Y : m_Y0;
+  if ( m_Type == ctArc )
+  {
+    // add the points on the axes through the center, if the arc passes them
+    for ( int q = 0; q < 4; q++ )
+    {
+      float a = q * M_PI / 2;
+      float d = (m_Sweep > 0) ? (a - m_A0) : (m_A0 - a);
+      d = fmod(d, 2*M_PI);
+      if ( d < 0 ) d += 2*M_PI;
+      if ( d > fabs(m_Sweep) ) continue;
+      float r = m_R0 + (d / fabs(m_Sweep)) * (m_R1 - m_R0);
+      float x = m_Cx + r * cos(a), y = m_Cy + r * sin(a);
+      if ( x < x0 ) x0 = x;
+      if ( x > x1 ) x1 = x;
+      if ( y < y0 ) y0 = y;
+      if ( y > y1 ) y1 = y;
+    }
+  }
+  else
+  {
+    bezier_extremes(m_X0, m_P[0], m_P[2], m_X, x0, x1);
+    bezier_extremes(m_Y0, m_P[1], m_P[3], m_Y, y0, y1);
+  }
+  minx = floor(x0);
+  miny = floor(y0);
+  maxx = ceil(x1);
+  maxy = ceil(y1);
+}
@@ -0,0 +1,82 @@
+/**
+ * LaosCurve.h
+ * Flatten arcs and cubic Bezier curves into line segments
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Simplecode curve commands (absolute coordinates [micron], laser on):
+ *
+ *   10 x y cx cy              clockwise arc to x,y around cx,cy
+ *   11 x y cx cy              counter clockwise arc to x,y around cx,cy
+ *   13 x1 y1 x2 y2 x y        cubic Bezier to x,y with control points x1,y1 and x2,y2
+ *
+ * An arc that ends where it starts is a full circle. The curve starts at
+ * the end of the previous command.
+ *
+ * Related, but not a curve (LaosMotion queues the lines directly):
+ *
+ *   14 n dx1 dy1 ... dxn dyn  polyline of n lines, each relative to the end of the
+ *                             previous one [micron], laser on
+ *
+ * Arc() and Bezier() only compute the number of segments; Next() returns
+ * one segment end point at a time, so a curve of any length takes the same
+ * (small) amount of memory. The segments stay within the tolerance of the
+ * curve; the last one ends exactly on the end point.
+ *
+ * No mbed dependencies: LaosMotion, LaosExtent and LaosEstimate all use it.
+ *
+ @code
+ LaosCurve curve;
+ curve.SetTolerance(10);
+ curve.Arc(x0, y0, x, y, cx, cy, false);
+ while (curve.Next(x, y)) line_to(x, y);
+ @endcode
+ */
+#ifndef LAOSCURVEH
+#define LAOSCURVEH
+
+#define LAOSCURVE_MAX_SEGMENTS 10000 // per curve
+
+class LaosCurve {
+
+public:
+  LaosCurve();
+  void SetTolerance(int tolerance); // max distance between segments and curve [micron]
+  void Arc(int x0, int y0, int x, int y, int cx, int cy, bool ccw);
+  void Bezier(int x0, int y0, int x1, int y1, int x2, int y2, int x, int y);
+  bool Next(int &x, int &y);  // end point of the next segment; false if the curve is done
+  void Stop() { m_Index = m_Count; }
+  bool Busy() const { return m_Index < m_Count; }
+  int Segments() const { return m_Count; }
+  // bounding box of the curve that was started last
+  void GetBounds(int &minx, int &miny, int &maxx, int &maxy) const;
+
+private:
+  typedef enum { ctArc, ctBezier } TType;
+  static int Limit(float n);
+
+private:
+  TType m_Type;
+  int m_Tolerance;
+  int m_Index, m_Count;
+  int m_X0, m_Y0, m_X, m_Y;     // start, end
+  float m_P[4];                 // Bezier: control points x1,y1,x2,y2
+  float m_Cx, m_Cy;             // arc: center
+  float m_R0, m_R1;             // arc: radius at start and end
+  float m_A0, m_Sweep;          // arc: start angle, sweep (< 0: clockwise) [rad]
+};
+
+#endif
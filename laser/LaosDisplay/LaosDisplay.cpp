@@ -38,6 +38,8 @@ MODI2C i2c(p9, p10);        // sda, scl
 #define _I2C_HOME 0xFE
 #define _I2C_CLS 0xFF
 #define _I2C_BAUD 9600
+#define _I2C_WRITE_OK 0x28
+#define _I2C_READ_OK 0x58
 
 // Make new config file object
 LaosDisplay::LaosDisplay()
@@ -49,11 +51,22 @@ LaosDisplay::LaosDisplay()
   serial.baud(serialBaud);
 #endif
 
+  m_FrameValid = false;
+  m_Unchanged = 0;
+  m_TxStatus = _I2C_WRITE_OK;
+  m_SampleDue = m_Sampling = m_Cancel = false;
+  m_KeyHead = m_KeyTail = 0;
+
   char key;
   // test I2C, if we cannot read, display is not attached, enable simulation
-  // wait 1 second to make sure that I2C has time to power on!
-  wait(3);
-  sim = i2c.read(_I2C_ADDRESS ,&key, 1) != 0; 
+  // the display needs some time to power on: poll it for at most 3 seconds
+  Timer t;
+  t.start();
+  do {
+    sim = i2c.read(_I2C_ADDRESS ,&key, 1) != 0;
+    if (sim)
+      wait_ms(50);
+  } while (sim && t.read_ms() < 3000);
   if (sim) {
     printf("LaosDisplay()\n");
     printf("Display() Simulation=ON, I2C Baudrate=%d\n", i2cBaud  );
@@ -80,13 +93,54 @@ void LaosDisplay::write(char *s)
 #endif
     return;
   } else {
-    while (*s) {
-      i2c.write(_I2C_ADDRESS, s++, 1);
-      while(i2c.getQueue()) wait_us(1);
+    m_FrameValid = false; // we do not know what this does to the screen
+    int len = strlen(s);
+    while (len > 0) {
+      int n = len > (int)sizeof(m_TxBuf) ? sizeof(m_TxBuf) : len;
+      send(s, n);
+      s += n;
+      len -= n;
     }
   }
 }
 
+// Send len bytes (at most sizeof(m_TxBuf)) in I2C writes of LCD_I2C_CHUNK
+// bytes. The last write is left running (non-blocking); the others, and
+// the last one of the previous send, are waited for.
+void LaosDisplay::send(const char *s, int len)
+{
+  waitTx();
+  memcpy(m_TxBuf, s, len);
+  for (int i = 0; i < len; i += LCD_I2C_CHUNK) {
+    if (i > 0 && !waitTx())
+      return; // the rest would not make sense
+    int n = len - i > LCD_I2C_CHUNK ? LCD_I2C_CHUNK : len - i;
+    m_TxStatus = 0;
+    i2c.write(_I2C_ADDRESS, &m_TxBuf[i], n, false, (int*)&m_TxStatus);
+  }
+}
+
+// Wait for the I2C write in progress, at most LCD_TX_TIMEOUT: a write that
+// hangs (the display stretches the clock) is aborted and the bus reset.
+// Returns false if the write failed: the shadow copy is no longer valid
+// (once, the failure is cleared).
+bool LaosDisplay::waitTx()
+{
+  if (m_TxStatus == 0) {
+    Timer t;
+    t.start();
+    while ((m_TxStatus == 0) && (t.read_ms() < LCD_TX_TIMEOUT))
+      wait_us(1);
+    if (m_TxStatus == 0)
+      i2c.abort(); // status I2C_ABORTED
+  }
+  if (m_TxStatus == _I2C_WRITE_OK)
+    return true;
+  m_FrameValid = false;
+  m_TxStatus = _I2C_WRITE_OK;
+  return false;
+}
+
 // Clear screen
 void LaosDisplay::cls() 
 {
@@ -136,8 +190,8 @@ int LaosDisplay::read_nb()
   else
   {
     if(status) {
-      // last I2C read has finished now
-      key = bg_buf;
+      // last I2C read has finished now (it may have been aborted)
+      key = (status == _I2C_READ_OK) ? bg_buf : 0;
       i2c.read_nb(_I2C_ADDRESS ,&bg_buf, 1, false, &status);
     }
   }
@@ -146,6 +200,57 @@ int LaosDisplay::read_nb()
   return key;   
 }
 
+// Start sampling the keypad from a ticker
+void LaosDisplay::StartKeySampling(float interval)
+{
+  m_KeyHead = m_KeyTail = 0;
+  m_Cancel = false;
+  m_SampleDue = false;
+  m_Sampling = true;
+  m_SampleTicker.attach(this, &LaosDisplay::OnSampleTick, interval);
+}
+
+// Stop sampling the keypad, discard sampled keys
+void LaosDisplay::StopKeySampling()
+{
+  m_SampleTicker.detach();
+  m_Sampling = false;
+  m_SampleDue = false;
+  m_KeyHead = m_KeyTail = 0;
+  m_Cancel = false;
+}
+
+// Read the keypad (non blocking), queue the key
+bool LaosDisplay::SampleKeys()
+{
+  m_SampleDue = false;
+  int key = read_nb();
+  if (key == K_CANCEL) {
+    m_Cancel = true;
+  } else if (key) {
+    unsigned char next = (m_KeyHead + 1) % KEY_QUEUE_SIZE;
+    if (next != m_KeyTail) { // drop the key if the queue is full
+      m_Keys[m_KeyHead] = key;
+      m_KeyHead = next;
+    }
+  }
+  return key != 0;
+}
+
+// Get next sampled key
+int LaosDisplay::GetKey()
+{
+  if (m_Cancel) {
+    m_Cancel = false;
+    return K_CANCEL;
+  }
+  if (m_KeyHead == m_KeyTail)
+    return 0;
+  int key = m_Keys[m_KeyTail];
+  m_KeyTail = (m_KeyTail + 1) % KEY_QUEUE_SIZE;
+  return key;
+}
+
 /**
 *** Screens are defined with:
 *** name, line[2], int* i[4], char *s;
@@ -216,7 +321,37 @@ void LaosDisplay::ShowScreen(const char *l, int *arg, char *s)
     l++;
   }
   *p=0;
-  write(str);
+
+  // pad to a full screen, so it can be compared to the shadow copy
+  char *frame = &str[1];
+  int len = p - frame;
+  if (len > LCD_SIZE) len = LCD_SIZE;
+  while (len < LCD_SIZE) frame[len++] = ' ';
+
+  // find the last changed character; there is no cursor positioning
+  // command, so everything from home up to there is sent
+  if (!sim)
+    waitTx(); // the previous update may have failed
+  if (m_Unchanged >= LCD_REFRESH)
+    m_FrameValid = false; // resend now and then, in case the display was reset
+  int last = LCD_SIZE - 1;
+  if (m_FrameValid)
+    while ((last >= 0) && (frame[last] == m_Frame[last]))
+      last--;
+  if (last < 0) {
+    m_Unchanged++;
+    return;
+  }
+  m_Unchanged = 0;
+  memcpy(m_Frame, frame, LCD_SIZE);
+  m_FrameValid = true;
+
+  if (sim) {
+    str[LCD_SIZE+1] = 0;
+    write(str);
+  } else {
+    send(str, last+2); // home + changed part
+  }
 }
 
 // EOF
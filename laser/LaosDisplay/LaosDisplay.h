@@ -25,7 +25,21 @@
 #ifndef _LAOS_DISPLAY_H_
 #define _LAOS_DISPLAY_H_
 
+#include "mbed.h"
+
 extern "C" void mbed_reset();
+
+#define LCD_COLS 16
+#define LCD_ROWS 2
+#define LCD_SIZE (LCD_COLS*LCD_ROWS)
+#define LCD_REFRESH 100     // resend the full screen after this many unchanged updates
+#define LCD_TX_TIMEOUT 50   // [ms] an I2C write that takes longer is aborted
+#ifndef LCD_I2C_CHUNK
+#define LCD_I2C_CHUNK 1     // bytes per I2C write; the display is only known to take one
+#endif
+
+#define KEY_SAMPLE_INTERVAL 0.05    // keypad sample interval while running [sec]
+#define KEY_QUEUE_SIZE 8
     /** LaosDisplay
       * Connect to LCD terminal or PC
       * Example:
@@ -45,6 +59,10 @@ public:
   * @param s The string to display
   */ 
   void write(char *s);
+/** Show a screen template (see LaosDisplay.cpp). The text on the display is
+  * kept in a shadow buffer; only the part up to the last changed character
+  * is sent, nothing if the screen did not change.
+  */
   void ShowScreen(const char *l, int *arg, char *s);
   void testI2C();
    
@@ -62,10 +80,44 @@ public:
   * @return (ASCII) character value, zero if no character is available
   */ 
   int read_nb();
-    
+
+/** Sample the keypad from a timer (e.g. while a job runs), instead of
+  * polling it for every token. The ticker only raises a flag; the I2C
+  * read is started from PollKeys(), outside interrupt context.
+  * @param interval sample interval in seconds
+  */
+  void StartKeySampling(float interval = KEY_SAMPLE_INTERVAL);
+  void StopKeySampling();
+  bool Sampling() { return m_Sampling; }
+
+/** Read the keypad if a sample is due, cheap (a flag test) if it is not
+  * @return true if a key was read
+  */
+  bool PollKeys() { return m_SampleDue ? SampleKeys() : false; }
+
+/** Get the next sampled key (a sampled cancel is returned first)
+  * @return (ASCII) character value, zero if no key was sampled
+  */
+  int GetKey();
+
 private:
+  void send(const char *s, int len);
+  bool waitTx();
+  bool SampleKeys();
+  void OnSampleTick() { m_SampleDue = true; }
+
   bool sim;
   int i2cBaud;
+  char m_Frame[LCD_SIZE];     // text currently on the display
+  bool m_FrameValid;
+  int m_Unchanged;            // updates skipped since the last transfer
+  char m_TxBuf[LCD_SIZE+1];   // I2C transfer in progress (non-blocking)
+  volatile int m_TxStatus;    // MODI2C status of its last write, 0 while busy
+  Ticker m_SampleTicker;
+  volatile bool m_SampleDue;
+  bool m_Sampling, m_Cancel;
+  char m_Keys[KEY_QUEUE_SIZE];
+  unsigned char m_KeyHead, m_KeyTail;
 };
 
 /* PC keyboard and I2C display
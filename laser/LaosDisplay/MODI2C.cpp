@@ -131,6 +131,25 @@ int MODI2C::getQueue( void ) {
     return Buffer->queue;
     }
 
+void MODI2C::abort( void ) {
+    I2CBuffer *Buffer;
+    if (I2CMODULE == LPC_I2C1) {
+        Buffer = &Buffer1;
+    } else {
+        Buffer = &Buffer2;
+    }
+    _clearISR(I2CMODULE);
+    for (int i = 0; i < Buffer->queue; i++)
+        *Buffer->Data[i].status = I2C_ABORTED;
+    Buffer->queue = 0;
+    Buffer->count = 0;
+
+    //Disable the interface (clears all control bits), enable it again and release the bus
+    I2CMODULE->I2CONCLR = 1<<I2C_ENABLE | 1<<I2C_START | 1<<I2C_FLAG | 1<<I2C_ASSERT_ACK;
+    writeSettings();
+    _stop(I2CMODULE);
+    }
+
 
 
 //*******************************************
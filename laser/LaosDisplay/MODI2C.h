@@ -37,6 +37,8 @@ Face it, dinos much cooler than copyright notices.*/
 #define IRQ_I2C_READ        1
 #define IRQ_I2C_WRITE       2
 
+#define I2C_ABORTED         0xF8    //Status of commands dropped by abort()
+
 
 
 #ifndef I2C_BUFFER
@@ -183,6 +185,14 @@ public:
     */
     int getQueue( void );
 
+    /**
+    * Drops all queued commands (their status becomes I2C_ABORTED) and resets the I2C interface
+    *
+    * For a transfer that never finishes, e.g. a slave that stretches the clock forever. A slave
+    * that holds SDA low is not freed by this.
+    */
+    void abort( void );
+
 
 private:
 
@@ -0,0 +1,339 @@
+/**
+ * LaosEstimate.cpp
+ * Job run time estimate, using the same motion model as the planner
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <math.h>
+#include <string.h>
+#include "LaosEstimate.h"
+
+#define lround(x) ( (long)floor(x+0.5) )
+
+LaosEstimate::LaosEstimate()
+{
+  memset(&m_Set, 0, sizeof(m_Set));
+  Reset();
+}
+
+void LaosEstimate::Setup(const TSettings &settings)
+{
+  m_Set = settings;
+  m_Curve.SetTolerance(settings.curve_tolerance);
+}
+
+// x, y: start position [micron]
+void LaosEstimate::Reset(int x, int y)
+{
+  m_Tail = m_Count = 0;
+  m_PosX = lround(x / 1000.0 * m_Set.steps_per_mm_x);
+  m_PosY = lround(y / 1000.0 * m_Set.steps_per_mm_y);
+  m_LastX = x;
+  m_LastY = y;
+  m_RoundX = m_RoundY = 0;
+  m_PrevUnitX = m_PrevUnitY = 0;
+  m_PrevNominal = 0;
+  m_Step = m_Command = m_TargetX = m_Param = 0;
+  m_MarkSpeed = m_Set.speed;
+  m_BitmapSpeed = m_Set.bitmap_speed;
+  m_BitmapBpp = 1;
+  m_BitmapSize = 0;
+  m_BitmapEnable = false;
+  m_Time = m_LaserTime = m_Travel = m_LaserDist = 0;
+}
+
+void LaosEstimate::Finish()
+{
+  Flush();
+}
+
+// Feed simplecode; follows LaosMotion::write()
+void LaosEstimate::Write(int i)
+{
+  if ( m_Step == 0 )
+  {
+    m_Command = i;
+    m_Step++;
+    return;
+  }
+  switch( m_Command )
+  {
+    case 0: // move x,y (laser off)
+    case 1: // line x,y (laser on)
+      if ( m_Step == 1 )
+      {
+        m_TargetX = i;
+      }
+      else
+      {
+        bool bitmap = m_BitmapEnable && m_Command;
+        if ( bitmap ) m_BitmapEnable = false;
+        int speed = m_Command ? (bitmap ? m_BitmapSpeed : m_MarkSpeed) : m_Set.speed;
+        AddLine(m_TargetX, i, speed, m_Command, bitmap);
+        m_Step = 0;
+      }
+      break;
+    case 2: // move z: LaosMotion does not change the target
+      m_Step = 0;
+      break;
+    case 4: // set x,y,z (absolute)
+      if ( m_Step == 1 )
+      {
+        m_TargetX = i;
+      }
+      else if ( m_Step == 2 )
+      {
+        Flush();
+        m_PosX = lround(m_TargetX / 1000.0 * m_Set.steps_per_mm_x);
+        m_PosY = lround(i / 1000.0 * m_Set.steps_per_mm_y);
+        m_LastX = m_TargetX;
+        m_LastY = i;
+        m_PrevNominal = 0;
+      }
+      else
+      {
+        m_Step = 0;
+      }
+      break;
+    case 5: // nop
+      m_Step = 0;
+      break;
+    case 7: // set index,value
+      if ( m_Step == 1 )
+      {
+        m_Param = i;
+      }
+      else
+      {
+        if ( m_Param == 100 )
+        {
+          if ( i < 1 ) i = 1;
+          if ( i > 9999 ) i = 10000;
+          m_MarkSpeed = i * m_Set.speed / 10000;
+          m_BitmapSpeed = i * m_Set.bitmap_speed / 10000;
+        }
+        m_Step = 0;
+      }
+      break;
+    case 9: // bitmap: 9 <bpp> <width> <data-0> <data-1> ... <data-n>
+      if ( m_Step == 1 )
+      {
+        m_BitmapBpp = i;
+      }
+      else if ( m_Step == 2 )
+      {
+        Flush(); // LaosMotion waits for an empty queue
+        m_BitmapEnable = true;
+        m_BitmapSize = (m_BitmapBpp * i) / 32;
+        if ( (m_BitmapBpp * i) % 32 )
+          m_BitmapSize++;
+      }
+      else if ( m_Step - 2 == m_BitmapSize ) // last dword
+      {
+        m_Step = 0;
+      }
+      break;
+    case 10: // arc: 10/11 <x> <y> <cx> <cy> (laser on)
+    case 11:
+    case 13: // cubic Bezier: 13 <x1> <y1> <x2> <y2> <x> <y> (laser on)
+      m_Args[m_Step-1] = i;
+      if ( m_Step == (m_Command == 13 ? 6 : 4) )
+      {
+        int *a = m_Args;
+        int x, y;
+        if ( m_Command == 13 )
+          m_Curve.Bezier(m_LastX, m_LastY, a[0], a[1], a[2], a[3], a[4], a[5]);
+        else
+          m_Curve.Arc(m_LastX, m_LastY, a[0], a[1], a[2], a[3], m_Command == 11);
+        while ( m_Curve.Next(x, y) )
+          AddLine(x, y, m_MarkSpeed, true, false);
+        m_Step = 0;
+      }
+      break;
+    case 14: // polyline: 14 <n> <dx-1> <dy-1> ... <dx-n> <dy-n> (relative, laser on)
+      if ( m_Step == 1 )
+      {
+        m_Args[0] = i;
+        if ( i < 1 ) m_Step = 0;
+      }
+      else if ( m_Step % 2 == 0 )
+      {
+        m_Args[1] = i;
+      }
+      else
+      {
+        AddLine(m_LastX + m_Args[1], m_LastY + i, m_MarkSpeed, true, false);
+        if ( (m_Step-1)/2 == m_Args[0] )
+          m_Step = 0;
+      }
+      break;
+    default:
+      m_Step = 0;
+      break;
+  }
+  if ( m_Step )
+    m_Step++;
+}
+
+// Plan a line to x,y [micron]; follows plan_buffer_line()
+void LaosEstimate::AddLine(int x, int y, int speed, bool laser, bool bitmap)
+{
+  m_LastX = x;
+  m_LastY = y;
+  float fx = x / 1000.0 * m_Set.steps_per_mm_x + m_RoundX;
+  float fy = y / 1000.0 * m_Set.steps_per_mm_y + m_RoundY;
+  long tx = lround(fx), ty = lround(fy);
+  m_RoundX = fx - tx;
+  m_RoundY = fy - ty;
+  if ( tx == m_PosX && ty == m_PosY )
+    return; // zero length block
+  float dx = (tx - m_PosX) / m_Set.steps_per_mm_x;
+  float dy = (ty - m_PosY) / m_Set.steps_per_mm_y;
+  m_PosX = tx;
+  m_PosY = ty;
+
+  if ( bitmap )
+    Flush();
+  if ( m_Count == LAOSESTIMATE_WINDOW )
+    ExecuteOldest(); // the planner waits for a free block
+
+  TBlock &b = Block(m_Count);
+  b.mm = sqrt(dx*dx + dy*dy);
+  b.steps = fmax(fabs(dx * m_Set.steps_per_mm_x), fabs(dy * m_Set.steps_per_mm_y));
+  b.laser = laser;
+  float ux = dx / b.mm, uy = dy / b.mm;
+
+  // path acceleration: the lowest the axes allow
+  b.accel = 0;
+  if ( ux != 0 )
+    b.accel = (bitmap ? m_Set.accel_raster : m_Set.accel_x) / fabs(ux);
+  if ( uy != 0 && (b.accel == 0 || m_Set.accel_y / fabs(uy) < b.accel) )
+    b.accel = m_Set.accel_y / fabs(uy);
+
+  // limit speed per axis
+  float factor = 1;
+  if ( fabs(ux) * speed > m_Set.max_speed_x )
+    factor = m_Set.max_speed_x / (fabs(ux) * speed);
+  if ( fabs(uy) * speed > m_Set.max_speed_y )
+    factor = fmin(factor, m_Set.max_speed_y / (fabs(uy) * speed));
+  b.nominal = speed * factor;
+
+  // junction speed
+  float vmax_junction = 0;
+  if ( (m_Count > 0) && (m_PrevNominal > 0) )
+  {
+    float cos_theta = - m_PrevUnitX * ux - m_PrevUnitY * uy;
+    if ( cos_theta < 0.95 )
+    {
+      vmax_junction = fmin(m_PrevNominal, b.nominal);
+      if ( cos_theta > -0.95 )
+      {
+        float sin_theta_d2 = sqrt(0.5*(1.0-cos_theta));
+        vmax_junction = fmin(vmax_junction,
+          sqrt(b.accel * m_Set.junction_deviation * sin_theta_d2/(1.0-sin_theta_d2)));
+      }
+    }
+  }
+  b.max_entry = vmax_junction;
+  float v_allowable = sqrt(2 * b.accel * b.mm);
+  b.entry = fmin(vmax_junction, v_allowable);
+  b.nominal_length = (b.nominal <= v_allowable);
+  m_PrevUnitX = ux;
+  m_PrevUnitY = uy;
+  m_PrevNominal = b.nominal;
+  m_Count++;
+
+  Recalculate();
+  if ( bitmap )
+    Flush();
+}
+
+// Reverse and forward pass over the window, as planner_recalculate()
+void LaosEstimate::Recalculate()
+{
+  for ( int i = m_Count-2; i > 0; i-- )
+  {
+    TBlock &cur = Block(i), &next = Block(i+1);
+    if ( cur.entry != cur.max_entry )
+    {
+      if ( (!cur.nominal_length) && (cur.max_entry > next.entry) )
+        cur.entry = fmin(cur.max_entry, sqrt(next.entry*next.entry + 2*cur.accel*cur.mm));
+      else
+        cur.entry = cur.max_entry;
+    }
+  }
+  for ( int i = 1; i < m_Count; i++ )
+  {
+    TBlock &prev = Block(i-1), &cur = Block(i);
+    if ( (!prev.nominal_length) && (prev.entry < cur.entry) )
+      cur.entry = fmin(cur.entry, sqrt(prev.entry*prev.entry + 2*prev.accel*prev.mm));
+  }
+}
+
+// Run the oldest block: its exit speed is the entry speed of the next one
+void LaosEstimate::ExecuteOldest()
+{
+  TBlock &b = Block(0);
+  float nominal = StepSpeed(b);
+  float exit = (m_Count > 1) ? Block(1).entry : 0;
+  float t = BlockTime(b.mm, fmin(b.entry, nominal), nominal, fmin(exit, nominal), b.accel);
+  m_Time += t;
+  if ( b.laser )
+  {
+    m_LaserTime += t;
+    m_LaserDist += b.mm;
+  }
+  else
+  {
+    m_Travel += b.mm;
+  }
+  m_Tail = (m_Tail + 1) % LAOSESTIMATE_WINDOW;
+  m_Count--;
+}
+
+// Run all planned blocks, the last one ends at standstill
+void LaosEstimate::Flush()
+{
+  while ( m_Count )
+    ExecuteOldest();
+}
+
+// Plateau speed [mm/sec] the step interrupt runs a block at: ramp.h stops
+// ramping up at step n = v^2/(2a), rounded down, so it runs at the period
+// of that step. Slow blocks (a few steps of ramp) run at a lower speed.
+float LaosEstimate::StepSpeed(const TBlock &b)
+{
+  float spm = b.steps / b.mm; // along the axis with the most steps
+  int n = b.nominal * b.nominal * spm / (2 * b.accel);
+  return sqrt(b.accel / (2 * spm)) / (sqrt(n + 1.0) - sqrt((float)n));
+}
+
+// Time [sec] to travel mm, from speed v0 via (at most) vn to v1, with
+// acceleration a
+float LaosEstimate::BlockTime(float mm, float v0, float vn, float v1, float a)
+{
+  if ( vn <= 0 || a <= 0 )
+    return 0;
+  float da = (vn*vn - v0*v0) / (2*a);
+  float dd = (vn*vn - v1*v1) / (2*a);
+  if ( da + dd <= mm )
+    return (vn - v0) / a + (vn - v1) / a + (mm - da - dd) / vn;
+  // no plateau: accelerate to vp, then brake
+  float vp = sqrt(a*mm + (v0*v0 + v1*v1) / 2);
+  vp = fmax(vp, fmax(v0, v1));
+  return (vp - v0) / a + (vp - v1) / a;
+}
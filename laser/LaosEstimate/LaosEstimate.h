@@ -0,0 +1,116 @@
+/**
+ * LaosEstimate.h
+ * Job run time estimate, using the same motion model as the planner
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Feed it a simplecode file (like LaosExtent) and it plans the moves the
+ * way planner.cpp does: per axis speed limits, junction speeds from the
+ * junction deviation, the path acceleration from the axis limits, reverse
+ * and forward passes over a window of LAOSESTIMATE_WINDOW blocks, and a
+ * trapezoid per block, at the plateau speed the step interrupt reaches. The block that leaves the window is "executed" and
+ * its time is added up. Bitmap lines are planned on their own, as
+ * LaosMotion empties the queue around them. Arcs and Bezier curves are split into
+ * lines with LaosCurve, as LaosMotion does.
+ *
+ * No mbed dependencies: all machine settings are passed in TSettings, so
+ * this also builds on a PC to estimate jobs before sending them.
+ *
+ @code
+ LaosEstimate est;
+ est.Setup(settings);
+ est.Reset(x, y);
+ while (!feof(fp)) est.Write(readint(fp));
+ est.Finish();
+ printf("%d s\n", (int)est.GetTime());
+ @endcode
+ */
+#ifndef LAOSESTIMATEH
+#define LAOSESTIMATEH
+
+#include "LaosCurve.h"
+
+// the planner holds BLOCK_BUFFER_SIZE-1 blocks
+#define LAOSESTIMATE_WINDOW 15
+
+class LaosEstimate {
+
+public:
+  typedef struct {
+    float steps_per_mm_x, steps_per_mm_y;
+    float max_speed_x, max_speed_y; // axis speed limits [mm/sec]
+    float accel_x, accel_y;   // axis acceleration limits [mm/sec2]
+    float accel_raster;       // X acceleration limit of bitmap lines [mm/sec2]
+    float junction_deviation; // [mm]
+    int speed;                // travel speed and 100% marking speed [mm/sec]
+    int bitmap_speed;         // 100% bitmap speed [mm/sec]
+    int curve_tolerance;      // arc/Bezier segment tolerance [micron]
+  } TSettings;
+
+  LaosEstimate();
+  void Setup(const TSettings &settings);
+  void Reset(int x = 0, int y = 0); // start a new job at this position [micron]
+  void Write(int i);    // feed a simplecode value
+  void Finish();        // end of the file: bring the last moves to a stop
+
+  // results, valid after Finish()
+  float GetTime() const { return m_Time; }                // [sec]
+  float GetLaserTime() const { return m_LaserTime; }      // [sec]
+  float GetTravelDistance() const { return m_Travel; }    // laser off [mm]
+  float GetLaserDistance() const { return m_LaserDist; }  // laser on [mm]
+
+private:
+  typedef struct {
+    float mm;           // length [mm]
+    float steps;        // step events
+    float nominal;      // nominal speed [mm/sec]
+    float entry;        // planned entry speed [mm/sec]
+    float max_entry;    // junction speed limit [mm/sec]
+    float accel;        // [mm/sec2]
+    bool nominal_length;
+    bool laser;
+  } TBlock;
+
+  void AddLine(int x, int y, int feedrate, bool laser, bool bitmap);
+  void Recalculate();
+  void ExecuteOldest();
+  void Flush();
+  TBlock &Block(int i) { return m_Block[(m_Tail + i) % LAOSESTIMATE_WINDOW]; }
+  static float StepSpeed(const TBlock &b);
+  static float BlockTime(float mm, float v0, float vn, float v1, float a);
+
+private:
+  TSettings m_Set;
+  TBlock m_Block[LAOSESTIMATE_WINDOW];
+  int m_Tail, m_Count;
+  long m_PosX, m_PosY;              // planned position [steps]
+  float m_RoundX, m_RoundY;         // rounding errors [steps]
+  float m_PrevUnitX, m_PrevUnitY;
+  float m_PrevNominal;
+
+  // simplecode state
+  int m_Step, m_Command, m_TargetX;
+  int m_LastX, m_LastY;             // end of the last line [micron]
+  int m_Args[6];                    // curve parameters
+  LaosCurve m_Curve;
+  int m_Param, m_MarkSpeed, m_BitmapSpeed;
+  int m_BitmapBpp, m_BitmapSize;
+  bool m_BitmapEnable;
+
+  float m_Time, m_LaserTime, m_Travel, m_LaserDist;
+};
+
+#endif
@@ -63,6 +63,21 @@ void LaosExtent::AddToBoundary(int x, int y)
 	m_HasMinMaxCoordinates=true;
 }
 
+// add the bounding box of a curve that starts at the current target
+void LaosExtent::AddCurve()
+{
+	int minx, miny, maxx, maxy;
+	if(m_Command == 13)
+		m_Curve.Bezier(m_TargetX, m_TargetY, m_Args[0], m_Args[1], m_Args[2], m_Args[3], m_Args[4], m_Args[5]);
+	else
+		m_Curve.Arc(m_TargetX, m_TargetY, m_Args[0], m_Args[1], m_Args[2], m_Args[3], m_Command == 11);
+	m_Curve.GetBounds(minx, miny, maxx, maxy);
+	AddToBoundary(minx, miny);
+	AddToBoundary(maxx, maxy);
+	m_TargetX = (m_Command == 13) ? m_Args[4] : m_Args[0];
+	m_TargetY = (m_Command == 13) ? m_Args[5] : m_Args[1];
+}
+
 LaosExtent::TError LaosExtent::GetBoundary(int &minx, int &miny, int &maxx, int &maxy) const
 {
 	minx=m_MinX;
@@ -78,6 +93,16 @@ LaosExtent::TError LaosExtent::GetBoundary(int &minx, int &miny, int &maxx, int
 		return m_Error;
 	}
 }
+void LaosExtent::SetBoundary(TError err, int minx, int miny, int maxx, int maxy)
+{
+	m_MinX=minx;
+	m_MinY=miny;
+	m_MaxX=maxx;
+	m_MaxY=maxy;
+	m_HasMinMaxCoordinates=(err != errEmpty);
+	m_Error=(err == errEmpty) ? errNone : err;
+}
+
 // Feed simplecode
 void LaosExtent::Write(int i)
 {
@@ -150,6 +175,41 @@ void LaosExtent::Write(int i)
               }
             }
             break;
+         case 10: // arc: 10/11 <x> <y> <cx> <cy> (laser on)
+         case 11:
+          	m_Args[m_Step-1] = i;
+          	if(m_Step == 4)
+          	{
+          		AddCurve();
+          		m_Step=0;
+          	}
+          	break;
+         case 13: // cubic Bezier: 13 <x1> <y1> <x2> <y2> <x> <y> (laser on)
+          	m_Args[m_Step-1] = i;
+          	if(m_Step == 6)
+          	{
+          		AddCurve();
+          		m_Step=0;
+          	}
+          	break;
+         case 14: // polyline: 14 <n> <dx-1> <dy-1> ... <dx-n> <dy-n> (relative, laser on)
+          	if(m_Step == 1)
+          	{
+          		m_Args[0] = i;
+          		if(i < 1) m_Step=0;
+          		else AddToBoundary(m_TargetX, m_TargetY);
+          	}
+          	else if(m_Step % 2 == 0)
+          	{
+          		m_TargetX += i;
+          	}
+          	else
+          	{
+          		m_TargetY += i;
+          		AddToBoundary(m_TargetX, m_TargetY);
+          		if((m_Step-1)/2 == m_Args[0]) m_Step=0;
+          	}
+          	break;
          default: // I do not understand:
          	//if(!m_Error) m_Error = errFileFormatError;
             m_Step = 0;
@@ -4,6 +4,7 @@
 #include "global.h"
 #include "pins.h"
 #include "planner.h"
+#include "LaosCurve.h"
 
 // forward decls:
 class LaosMotion;
@@ -24,16 +25,21 @@ public:
 	// get the boundaries
 	// result is value only if the returned error code is errNone
 	TError GetBoundary(int &minx, int &miny, int &maxx, int &maxy) const;
+	// restore a result of GetBoundary() (e.g. cached when the file was uploaded)
+	void SetBoundary(TError err, int minx, int miny, int maxx, int maxy);
 	// show boundaries by moving the head:
 	void ShowBoundaries(LaosMotion *mot) const;
 
 private:
 	void AddToBoundary(int x, int y);
+	void AddCurve();
 
 private:
 	int m_MinX, m_MaxX, m_MinY, m_MaxY;  // boundaries (multiplied by 1000)
 	bool m_HasMinMaxCoordinates;         // initially false; will be set true once the laser fires
 	int m_TargetX, m_TargetY;            // target pos of current command
+	int m_Args[6];                       // curve parameters
+	LaosCurve m_Curve;
 	int m_BitmapSize;
 	int m_BitmapBpp;
 	int m_Step;
@@ -22,6 +22,9 @@
  *
  */
 #include "laosfilesystem.h"
+#include "LaosJobMeta.h"
+#include "LaosPrefetch.h"
+#include "LaosQueue.h"
 
 LaosFileSystem::LaosFileSystem(PinName mosi, PinName miso, PinName sclk, PinName cs, const char* name)
         : SDFileSystem(mosi, miso, sclk, cs, name) {
@@ -60,6 +63,41 @@ FILE* LaosFileSystem::openfile(char *name, const std::string& iom) {
     }
 }
 
+// Open a file by its long name, bypassing stdio buffering. Used where the
+// caller does its own (sector aligned) buffering, e.g. TFTP uploads.
+FATFileHandle* LaosFileSystem::openhandle(char *name, int flags) {
+    if (!islegalname(name))
+        return NULL;
+    char shortname[SHORTFILESIZE] = "";
+    getshortname(shortname, name);
+    if (strlen(shortname) == 0) {
+        if (!(flags & O_CREAT))     // no file exists
+            return NULL;
+        makeshortname(shortname, name);
+    }
+    return static_cast<FATFileHandle*>(open(shortname, flags));
+}
+
+// Replace the file with long name 'name' by newfile (a short name in this
+// directory), with renames only: the old file is moved out of the way, and
+// put back if newfile cannot take its place. Returns 0 on success; on
+// failure name is as it was, and newfile is left for the caller.
+int LaosFileSystem::replacefile(char *name, const char *newfile) {
+    char shortname[SHORTFILESIZE] = "";
+    getshortname(shortname, name);
+    if (strlen(shortname) == 0)
+        return -1;
+    remove(_LAOSFILE_REPLACE);      // left by an earlier power loss
+    if (rename(shortname, _LAOSFILE_REPLACE) < 0)
+        return -1;
+    if (rename(newfile, shortname) < 0) {
+        rename(_LAOSFILE_REPLACE, shortname);
+        return -1;
+    }
+    remove(_LAOSFILE_REPLACE);
+    return 0;
+}
+
 void LaosFileSystem::getlongname(char *result, char *searchname) {
     FILE *fp = fopen(tablename, "r");
     if (fp) {
@@ -344,7 +382,7 @@ void getprevjob(char *name) {
     d = opendir("/sd");
     if(d != NULL) {
         while((p = readdir(d)) != NULL) {
-            if (strncmp(p->d_name, "longname.sy",11)) { // skip longname.sy*
+            if (!isSystemFile(p->d_name)) { // skip longname.sys, jobstats.sys, ...
                 if (! strcmp(shortname, p->d_name)) {   // shortname = current entry
                     if (strcmp(last, "")) {
                         sd.getlongname(name, last);     // return entry before
@@ -375,7 +413,7 @@ void getnextjob(char *name) {
     d = opendir("/sd");
     if(d != NULL) {
         while((p = readdir(d)) != NULL) {
-            if (strncmp(p->d_name, "longname.sy",11)) { // skip longname.sy*
+            if (!isSystemFile(p->d_name)) { // skip longname.sys, jobstats.sys, ...
                 if (! strcmp(shortname, last)) {        // if last was shortname
                     sd.getlongname(name, p->d_name);    //    return current
                     closedir(d);
@@ -462,7 +500,10 @@ void removefile(char *name) {
         sprintf(fullname, "%s%s", sd.pathname, shortname);
         if (remove(fullname) < 0)
             printf("Error while removing file %s\n\r", fullname);
-        sd.cleanlist();           
+        sd.cleanlist();
+        jobmeta_remove(name);           
+        prefetch_forget(name);
+        queue_remove(name);
     } 
 }
 
@@ -599,6 +640,13 @@ int SDcheckFirmware() {
     return 0;
 }
 
+// Files with a .sy* extension (longname.sys and its temporary copy, job
+// statistics) belong to the firmware and are not shown as jobs
+int isSystemFile(const char *name) {
+    const char *ext = strrchr(name, '.');
+    return (ext != NULL) && (tolower(ext[1]) == 's') && (tolower(ext[2]) == 'y');
+}
+
 int isLaosFile(char *filename) {
     char name[MAXFILESIZE];
     strcpy(name, filename);
@@ -25,10 +25,12 @@
 
 #include "SDFileSystem.h"
 #include "FATFileSystem.h"
+#include "FATFileHandle.h"
 #include <string>
 #include <ctype.h>
 
 #define _LAOSFILE_TRANSTABLE "longname.sys"
+#define _LAOSFILE_REPLACE "replace.sys" // the old file, while replacefile() runs
 #define MAXFILESIZE 21
 #define SHORTFILESIZE 13
 
@@ -38,6 +40,8 @@ class LaosFileSystem : public SDFileSystem {
                 const char* name);        // Create the filesystem on SD
         virtual ~LaosFileSystem();                // destructor
         FILE* openfile(char* name, const std::string& iom);    // open a file
+        FATFileHandle* openhandle(char* name, int flags); // open without stdio
+        int replacefile(char* name, const char* newfile); // newfile becomes name
         void getlongname(char *result, char *searchname);   // return long names
         void getshortname(char* shortname, char* name); //get a short name
         char pathname[MAXFILESIZE+2];
@@ -71,4 +75,5 @@ void removeFirmware(); // remove old firmware
 char* getLaosFile(); // get filename of the first available file on S
 int SDcheckFirmware();  // check for firmware
 int isLaosFile(char *filename);   // check extension for LaOS compatibility
+int isSystemFile(const char *name); // firmware data (*.sys), not a job
 #endif
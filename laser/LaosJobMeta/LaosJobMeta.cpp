@@ -0,0 +1,203 @@
+/**
+ * LaosJobMeta.cpp
+ * Job analysis while a file is uploaded, cached in a metadata file
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "LaosJobMeta.h"
+#include "config.h"
+
+LaosJobMeta::LaosJobMeta()
+{
+  memset(&m_Meta, 0, sizeof(m_Meta));
+}
+
+void LaosJobMeta::Start(const char *name)
+{
+  memset(&m_Meta, 0, sizeof(m_Meta));
+  strncpy(m_Meta.name, name, MAXFILESIZE-1);
+  m_Value = m_Digits = 0;
+  m_Sign = 1;
+  m_Comment = false;
+  m_Extent[0].Reset(false);
+  m_Extent[1].Reset(true);
+  LaosEstimate::TSettings s;
+  GetEstimateSettings(s);
+  m_Estimate.Setup(s);
+  m_Estimate.Reset();   // the start position is not known yet: assume the origin
+}
+
+// Split data into values, with the same rules as readint()
+void LaosJobMeta::Put(const char *data, int len)
+{
+  m_Meta.size += len;
+  while (len-- > 0)
+  {
+    char c = *data++;
+    if (m_Comment)
+    {
+      // readint() skips up to and including the newline, without ending
+      // a value that was read before the ';'
+      if (c == '\n') m_Comment = false;
+      continue;
+    }
+    switch (c)
+    {
+      case '0': case '1': case '2': case '3': case '4':
+      case '5': case '6': case '7': case '8': case '9':
+        if (m_Digits < 16)
+        {
+          m_Value = m_Value * 10 + (c - '0');
+          m_Digits++;
+        }
+        break;
+      case '-': m_Sign = -1; break;
+      case ';': m_Comment = true; break;
+      case ' ': case '\t': case '\r': case '\n':
+        if (m_Digits)
+        {
+          Value(m_Value * m_Sign);
+          m_Value = m_Digits = 0;
+          m_Sign = 1;
+        }
+        break;
+    }
+  }
+}
+
+void LaosJobMeta::Value(int v)
+{
+  m_Extent[0].Write(v);
+  m_Extent[1].Write(v);
+  m_Estimate.Write(v);
+}
+
+void LaosJobMeta::Save()
+{
+  for (int i = 0; i < 2; i++)
+  {
+    int *b = m_Meta.bounds[i];
+    m_Meta.err[i] = m_Extent[i].GetBoundary(b[0], b[1], b[2], b[3]);
+  }
+  m_Estimate.Finish();
+  m_Meta.time = 1000 * m_Estimate.GetTime();
+  m_Meta.laser_time = 1000 * m_Estimate.GetLaserTime();
+  m_Meta.settings = jobmeta_settings();
+  jobmeta_save(&m_Meta);
+}
+
+// planner settings for LaosEstimate
+void LaosJobMeta::GetEstimateSettings(LaosEstimate::TSettings &s)
+{
+  extern config_t config;
+  extern GlobalConfig *cfg;
+  memset(&s, 0, sizeof(s));
+  s.steps_per_mm_x = config.steps_per_mm_x;
+  s.steps_per_mm_y = config.steps_per_mm_y;
+  s.max_speed_x = config.maximum_feedrate_x / 60.0;
+  s.max_speed_y = config.maximum_feedrate_y / 60.0;
+  s.accel_x = config.acceleration_x;
+  s.accel_y = config.acceleration_y;
+  s.accel_raster = config.acceleration_raster;
+  s.junction_deviation = config.junction_deviation;
+  s.speed = cfg->speed;
+  s.bitmap_speed = cfg->xspeed;
+  s.curve_tolerance = cfg->curvetolerance;
+}
+
+// Checksum of the estimate settings
+unsigned long jobmeta_settings()
+{
+  LaosEstimate::TSettings s;
+  LaosJobMeta::GetEstimateSettings(s);
+  const unsigned char *p = (const unsigned char *)&s;
+  unsigned long sum = 0;
+  for (unsigned int i = 0; i < sizeof(s); i++)
+    sum = (sum << 5) + (sum >> 27) + p[i];
+  return sum;
+}
+
+// open the metadata file
+static FILE *jobmeta_open(const char *mode)
+{
+  extern LaosFileSystem sd;
+  char fullname[MAXFILESIZE+SHORTFILESIZE+1];
+  sprintf(fullname, "%s%s", sd.pathname, JOBMETA_FILE);
+  return fopen(fullname, mode);
+}
+
+// Find the record of name in fp, -1 if it is not there
+static int jobmeta_find(FILE *fp, const char *name, tJobMeta *meta)
+{
+  int index = 0;
+  fseek(fp, 0, SEEK_SET);
+  while (fread(meta, sizeof(tJobMeta), 1, fp) == 1)
+  {
+    if (!strncmp(meta->name, name, MAXFILESIZE))
+      return index;
+    index++;
+  }
+  return -1;
+}
+
+bool jobmeta_load(const char *name, tJobMeta *meta, unsigned long size)
+{
+  FILE *fp = jobmeta_open("rb");
+  if (fp == NULL)
+    return false;
+  bool found = (jobmeta_find(fp, name, meta) >= 0);
+  fclose(fp);
+  return found && (meta->size == size) && (meta->settings == jobmeta_settings());
+}
+
+// Store a record, replacing the one with the same name (or a free one)
+void jobmeta_save(const tJobMeta *meta)
+{
+  tJobMeta tmp;
+  FILE *fp = jobmeta_open("r+b");
+  if (fp == NULL)
+    fp = jobmeta_open("w+b");
+  if (fp == NULL)
+    return;
+  int index = jobmeta_find(fp, meta->name, &tmp);
+  if (index < 0)
+    index = jobmeta_find(fp, "", &tmp);
+  if (index < 0)
+    fseek(fp, 0, SEEK_END);
+  else
+    fseek(fp, index * sizeof(tJobMeta), SEEK_SET);
+  fwrite(meta, sizeof(tJobMeta), 1, fp);
+  fclose(fp);
+}
+
+void jobmeta_remove(const char *name)
+{
+  tJobMeta meta;
+  if (*name == 0)
+    return;
+  FILE *fp = jobmeta_open("r+b");
+  if (fp == NULL)
+    return;
+  int index = jobmeta_find(fp, name, &meta);
+  if (index >= 0)
+  {
+    memset(&meta, 0, sizeof(meta));
+    fseek(fp, index * sizeof(tJobMeta), SEEK_SET);
+    fwrite(&meta, sizeof(tJobMeta), 1, fp);
+  }
+  fclose(fp);
+}
@@ -0,0 +1,93 @@
+/**
+ * LaosJobMeta.h
+ * Job analysis while a file is uploaded, cached in a metadata file
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The TFTP server feeds each received packet to LaosJobMeta, which splits
+ * it into simplecode values (same rules as readint()) and runs LaosExtent,
+ * in both modes, and LaosEstimate on them. When the upload completes, the
+ * result is stored as a fixed size record in JOBMETA_FILE, keyed by the
+ * long file name. ANALYZING uses the record instead of reading the file
+ * again, as long as the file size and the machine settings still match.
+ *
+ @code
+ LaosJobMeta meta;
+ meta.Start(name);
+ meta.Put(data, len); // for every received block
+ meta.Save();
+ ...
+ tJobMeta m;
+ if (jobmeta_load(name, &m, size)) ...
+ @endcode
+ */
+#ifndef LAOSJOBMETAH
+#define LAOSJOBMETAH
+
+#include "laosfilesystem.h"
+#include "LaosExtent.h"
+#include "LaosEstimate.h"
+
+#define JOBMETA_FILE "jobmeta.sys"
+
+// one record in JOBMETA_FILE
+typedef struct {
+  char name[MAXFILESIZE];   // long file name, empty: free record
+  char err[2];              // LaosExtent::TError: [0] all moves, [1] laser on
+  int bounds[2][4];         // minx, miny, maxx, maxy [micron]
+  unsigned long size;       // file size [bytes]
+  unsigned long settings;   // checksum of the estimate settings
+  int time;                 // estimated run time [ms]
+  int laser_time;           // estimated laser on time [ms]
+} tJobMeta;
+
+class LaosJobMeta {
+
+public:
+  LaosJobMeta();
+  void Start(const char *name);         // a new upload starts
+  void Put(const char *data, int len);  // feed received file data
+  void Save();                          // upload complete: store the record
+
+  // planner settings for LaosEstimate
+  static void GetEstimateSettings(LaosEstimate::TSettings &s);
+
+private:
+  void Value(int v);
+
+private:
+  tJobMeta m_Meta;
+  // tokenizer state
+  int m_Value, m_Sign, m_Digits;
+  bool m_Comment;
+  LaosExtent m_Extent[2];
+  LaosEstimate m_Estimate;
+};
+
+// Checksum of the estimate settings, stored in the record
+unsigned long jobmeta_settings();
+
+// Find the record for a job; false if there is none, or it does not match
+// the file size or the current settings
+bool jobmeta_load(const char *name, tJobMeta *meta, unsigned long size);
+
+// Store a record, replacing the one with the same name
+void jobmeta_save(const tJobMeta *meta);
+
+// Remove the record of a job
+void jobmeta_remove(const char *name);
+
+#endif
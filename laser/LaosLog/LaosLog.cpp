@@ -0,0 +1,118 @@
+/**
+ * LaosLog.cpp
+ * Deferred (ring buffered) debug logging
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "mbed.h"
+#include "LaosLog.h"
+
+typedef struct {
+  volatile uint32_t seq;    // slot number + 1, set when the entry is complete
+  const char *fmt;
+  int arg[4];
+  unsigned char level, cat, nstr;
+  char str[LOG_STR_SIZE];
+} tLogEntry;
+
+static tLogEntry ring[LOG_RING_SIZE];
+static volatile uint32_t head = 0;      // next slot to fill (any context)
+static volatile uint32_t tail = 0;      // next slot to print (log_flush only)
+static volatile uint32_t dropped = 0;   // messages lost because the ring was full
+static uint32_t reported = 0;           // dropped messages already reported
+
+// Store a message in the ring. Slots are reserved with LDREX/STREX, so
+// this may be called from interrupts as well as from the main loop.
+void log_write(int level, int cat, int nstr, const char *s1, const char *s2,
+               const char *fmt, int a, int b, int c, int d)
+{
+  uint32_t h;
+  do {
+    h = __LDREXW(&head);
+    if (h - tail >= LOG_RING_SIZE) {
+      __CLREX();
+      uint32_t n;
+      do {
+        n = __LDREXW(&dropped) + 1;
+      } while (__STREXW(n, &dropped));
+      return;
+    }
+  } while (__STREXW(h + 1, &head));
+
+  tLogEntry *e = &ring[h & (LOG_RING_SIZE-1)];
+  e->fmt = fmt;
+  e->arg[0] = a;
+  e->arg[1] = b;
+  e->arg[2] = c;
+  e->arg[3] = d;
+  e->level = level;
+  e->cat = cat;
+  e->nstr = nstr;
+  char *p = e->str, *end = &e->str[LOG_STR_SIZE-1];
+  if (nstr > 0) {
+    if (s1 == NULL) s1 = "";
+    while (*s1 && (p < end - (nstr > 1)))
+      *p++ = *s1++;
+    *p++ = 0;
+  }
+  if (nstr > 1) {
+    if (s2 == NULL) s2 = "";
+    while (*s2 && (p < end))
+      *p++ = *s2++;
+    *p = 0;
+  }
+  __DMB();
+  e->seq = h + 1;
+}
+
+// Print at most max pending messages (main loop only, this blocks on the
+// serial port); returns the number of messages still pending
+int log_flush(int max)
+{
+  if (dropped != reported) {
+    uint32_t n = dropped;
+    printf("log: %lu messages dropped\n\r", (unsigned long)(n - reported));
+    reported = n;
+  }
+  while ((max-- > 0) && (tail != head)) {
+    tLogEntry *e = &ring[tail & (LOG_RING_SIZE-1)];
+    if (e->seq != tail + 1)
+      break;    // still being written
+    const char *s1 = e->str;
+    const char *s2 = s1 + strlen(s1) + 1;
+    int *v = e->arg;
+    switch (e->nstr) {
+      case 0: printf(e->fmt, v[0], v[1], v[2], v[3]); break;
+      case 1: printf(e->fmt, s1, v[0], v[1], v[2], v[3]); break;
+      default: printf(e->fmt, s1, s2, v[0], v[1], v[2], v[3]); break;
+    }
+    tail++;
+  }
+  return head - tail;
+}
+
+// Number of messages waiting to be printed (a report of dropped ones counts)
+int log_pending()
+{
+  return (head - tail) + (dropped != reported);
+}
+
+// Number of messages dropped because the ring was full
+unsigned int log_dropped()
+{
+  return dropped;
+}
@@ -0,0 +1,100 @@
+/**
+ * LaosLog.h
+ * Deferred (ring buffered) debug logging
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A log call only stores the format pointer and its arguments in a ring
+ * buffer; the (slow, blocking) printf is done later by log_flush(), which
+ * the main loop scheduler runs while log_pending(), one message at a time
+ * while a job runs. When the ring is full, messages are dropped and
+ * counted instead of blocking the caller; jobstats.sys has the count.
+ *
+ * Rules for log calls:
+ *      * the format string must be a literal (only the pointer is stored)
+ *      * up to 4 integer arguments (no floats: scale them to int)
+ *      * LOGSTR() copies one string argument, LOGSTR2() copies two; these
+ *        are passed to the format before the integers (use %s first)
+ *      * safe to call from interrupts
+ *
+ * Levels and categories are selected at compile time; disabled calls
+ * compile to nothing. Override LOG_LEVEL / LOG_CATEGORIES with -D.
+ *
+ @code
+ LOG_DEBUG(LOG_NET, "Got block with size %d\n\r", len);
+ LOGSTR(LOG_LEVEL_INFO, LOG_FILE, "Now processing file: '%s'\n\r", name);
+ ...
+ if (log_pending()) log_flush(); // in the main loop
+ @endcode
+ */
+#ifndef _LAOSLOG_H_
+#define _LAOSLOG_H_
+
+// Levels
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Categories (bit mask)
+#define LOG_SYS     0x01    // boot, main loop
+#define LOG_NET     0x02    // ethernet, tftp
+#define LOG_MOTION  0x04    // planner, stepper, LaosMotion
+#define LOG_FILE    0x08    // sd card, job files
+#define LOG_CONFIG  0x10    // config file
+#define LOG_UI      0x20    // menu, display
+#define LOG_ALL     0xff
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#ifndef LOG_CATEGORIES
+#define LOG_CATEGORIES LOG_ALL
+#endif
+
+#define LOG_RING_SIZE 32    // number of entries, power of 2
+#define LOG_STR_SIZE 24     // room for copied string arguments
+
+#define LOG_ENABLED(lvl, cat) (((lvl) <= LOG_LEVEL) && ((cat) & LOG_CATEGORIES))
+
+#define LOG(lvl, cat, ...) \
+  do { if (LOG_ENABLED(lvl, cat)) log_write(lvl, cat, 0, 0, 0, __VA_ARGS__); } while (0)
+#define LOGSTR(lvl, cat, fmt, s, ...) \
+  do { if (LOG_ENABLED(lvl, cat)) log_write(lvl, cat, 1, s, 0, fmt, ##__VA_ARGS__); } while (0)
+#define LOGSTR2(lvl, cat, fmt, s1, s2, ...) \
+  do { if (LOG_ENABLED(lvl, cat)) log_write(lvl, cat, 2, s1, s2, fmt, ##__VA_ARGS__); } while (0)
+
+#define LOG_ERROR(cat, ...) LOG(LOG_LEVEL_ERROR, cat, __VA_ARGS__)
+#define LOG_WARN(cat, ...)  LOG(LOG_LEVEL_WARN, cat, __VA_ARGS__)
+#define LOG_INFO(cat, ...)  LOG(LOG_LEVEL_INFO, cat, __VA_ARGS__)
+#define LOG_DEBUG(cat, ...) LOG(LOG_LEVEL_DEBUG, cat, __VA_ARGS__)
+
+// Store a message in the ring (use the macros above)
+void log_write(int level, int cat, int nstr, const char *s1, const char *s2,
+               const char *fmt, int a = 0, int b = 0, int c = 0, int d = 0);
+
+// Print at most max pending messages; returns the number still pending
+int log_flush(int max = 4);
+
+// Number of messages waiting to be printed (a report of dropped ones counts)
+int log_pending();
+
+// Number of messages dropped because the ring was full
+unsigned int log_dropped();
+
+#endif
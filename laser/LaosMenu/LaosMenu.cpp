@@ -23,21 +23,31 @@
 #include "LaosMenu.h"
 #include "stepper.h"
 #include "pins.h"
+#include "profile.h"
+#include "LaosSched.h"
+#include "LaosPrefetch.h"
+#include "LaosQueue.h"
+#include "LaosLog.h"
 
 static const char *menus[] = {
     "STARTUP",     //0
     "MAIN",        //1
     "START JOB",   //2
-    "BOUNDARIES", //3
-    "DELETE JOB",  //4
-    "HOME",        //5
-    "MOVE",        //6
-    "FOCUS",       //7
-    "ORIGIN",      //8
-    "REMOVE ALL JOBS", //9
-    "IP",          //10
-    "REBOOT", //11
-    "LASER TEST", //12
+    "RESUME JOB",  //3
+    "JOB QUEUE",   //4
+    "BOUNDARIES", //5
+    "DELETE JOB",  //6
+    "HOME",        //7
+    "MOVE",        //8
+    "FOCUS",       //9
+    "ORIGIN",      //10
+    "REMOVE ALL JOBS", //11
+    "IP",          //12
+    "REBOOT", //13
+    "LASER TEST", //14
+#ifdef ST_PROFILE
+    "ISR PROFILE", //15
+#endif
     // "POWER / SPEED",//12
     // "IO", //13
 };
@@ -57,7 +67,15 @@ static const char *screens[] = {
     "RUN:            "
     "$$$$$$$$$$$$$$$$",
 
-#define BOUNDARIES (RUN+1)
+#define RESUME (RUN+1)
+    "RESUME:         "
+    "$$$$$$$$$$$$$$$$",
+
+#define QUEUE (RESUME+1)
+    "QUEUE:  210 x210"
+    "$$$$$$$$$$$$$$$$",
+
+#define BOUNDARIES (QUEUE+1)
     "BOUNDARIES:     "
     "$$$$$$$$$$$$$$$$",
 
@@ -97,7 +115,15 @@ static const char *screens[] = {
     "LASER TEST:     "
     "210ms 210%      ",
 
+#ifdef ST_PROFILE
+#define PROFILE (LASERTEST+1)
+    "ISR avg: 6543210"
+    "max 543210 D3210",
+
+#define POWER (PROFILE+1)
+#else
 #define POWER (LASERTEST+1)
+#endif
     "$$$$$$$: 6543210"
     "      [ok]      ",
 
@@ -119,8 +145,8 @@ static const char *screens[] = {
     "                ",
 
 #define RUNNING (ANALYZING+1)
-    "RUNNING...      "
-    "[cancel]        ",
+    "RUN  F210% P210%"
+    "[cancel] 543210s",
 
 #define BUSY (RUNNING+1)
     "BUSY: $$$$$$$$$$"
@@ -163,6 +189,12 @@ LaosMenu::LaosMenu(LaosDisplay *display) {
     runfile = NULL;
     m_LaserTestPower=0;
     m_LaserTestTime=0;
+    m_Underruns=0;
+    m_EstimatedTime=0;
+    m_CheckpointDue=m_CheckpointPending=false;
+    m_ResumeFound=m_Resume=false;
+    m_Queue=m_Chain=m_CoverOpened=false;
+    m_QueueCount=0;
 }
 
 /**
@@ -182,6 +214,13 @@ void LaosMenu::SetScreen(int screen) {
     Handle();
 }
 
+/**
+*** Show the job queue (a job was added)
+**/
+void LaosMenu::ShowQueue() {
+    SetScreen(QUEUE);
+}
+
 /**
 *** Goto specific screen
 **/
@@ -223,7 +262,8 @@ void LaosMenu::Handle() {
     extern GlobalConfig *cfg;
     static int count=0;
     
-    int c = dsp->read();
+    // while a job runs, keys are sampled on a timer (see RUNNING)
+    int c = dsp->Sampling() ? dsp->GetKey() : dsp->read();
     if ( count++ > 10) count = 0; // screen refresh counter (refresh once every 10 cycles(
     
     if ( c ) timeout = 10;  // keypress timeout counter
@@ -289,6 +329,67 @@ void LaosMenu::Handle() {
                 sarg = (char *)&jobname;
                 break;
 
+            case RESUME: // RESUME JOB: continue from the last checkpoint
+                if (m_Resume && mot->isHome) { // homed: restore the origin and run
+                    int *o = m_ResumePoint.origin;
+                    mot->setOriginAbsolute(o[0], o[1], o[2]);
+                    strcpy(jobname, m_ResumePoint.name);
+                    screen = ANALYZING; m_StageAfterAnalyzing = RUNNING;
+                    break;
+                }
+                m_Resume = false;
+                if (screen != prevscreen)
+                    m_ResumeFound = checkpoint_load(&m_ResumePoint);
+                switch ( c ) {
+                    case K_OK:
+                        if (m_ResumeFound) {
+                            m_Resume = true;
+                            lastscreen = RESUME;
+                            screen = HOMING;
+                        }
+                        waitup = 1;
+                        break;
+                    case K_CANCEL: screen=MAIN; waitup = 1; break;
+                }
+                sarg = m_ResumeFound ? m_ResumePoint.name : (char *)"(none)";
+                break;
+
+            case QUEUE: // JOB QUEUE: UP/DOWN runs of the first job, RIGHT: move it to the end, LEFT: remove it
+                if (c || screen != prevscreen) {
+                    switch ( c ) {
+                        case K_UP: queue_set_runs(m_QueueHead.name, m_QueueHead.runs + 1); break;
+                        case K_DOWN: if (m_QueueHead.runs > 1) queue_set_runs(m_QueueHead.name, m_QueueHead.runs - 1); break;
+                        case K_RIGHT: queue_rotate(); break;
+                        case K_LEFT: queue_remove(m_QueueHead.name); break;
+                        case K_CANCEL: screen=MAIN; break;
+                    }
+                    waitup = 1;
+                    m_QueueCount = queue_count();
+                    if (!queue_head(&m_QueueHead))
+                        memset(&m_QueueHead, 0, sizeof(m_QueueHead));
+                }
+                {
+                    // sys.queue 2: open and close the cover to start the next job
+                    bool start = (c == K_OK);
+                    if (cfg->queue == 2) {
+                        if (!mot->isStart())
+                            m_CoverOpened = true;
+                        else if (m_CoverOpened)
+                            start = true;
+                    }
+                    if (start && m_QueueCount && screen == QUEUE) {
+                        m_Queue = true;
+                        m_CoverOpened = false;
+                        strcpy(jobname, m_QueueHead.name);
+                        screen = ANALYZING; m_StageAfterAnalyzing = RUNNING;
+                        break;
+                    }
+                }
+                args[0] = m_QueueCount;
+                args[1] = m_QueueHead.runs;
+                sarg = m_QueueCount ? m_QueueHead.name : (char *)"(empty)";
+                break;
+
             case DELETE: // DELETE JOB select job to run
                 switch ( c ) {
                     case K_OK: removefile(jobname); screen=lastscreen; waitup = 1;
@@ -515,37 +616,79 @@ void LaosMenu::Handle() {
                         runfile=NULL; screen=MAIN; menu=MAIN;
                         break; */
                     default:
-                        if (runfile == NULL) {
-                            runfile = sd.openfile(jobname, "rb");
-                            if (! runfile) 
+                        if (!prefetch_isopen()) {
+                            if (!prefetch_open(jobname))
                               screen=MAIN;
-                            else
-                               mot->reset();
+                            else {
+                               if (!m_Chain) // otherwise the previous job is still running
+                                   mot->reset();
+                               m_Chain = false;
+                               SetOverride(100, 100);
+                               if (!cfg->disablecancelcheck)
+                                   dsp->StartKeySampling();
+                               StartJobStats();
+                               m_JobSize = prefetch_size();
+                               if (m_Resume) {
+                                   prefetch_seek(m_ResumePoint.offset);
+                                   mot->setState(&m_ResumePoint.state);
+                                   m_Resume = false;
+                               }
+                               m_CheckpointDue = m_CheckpointPending = false;
+                               m_CheckpointTime = m_JobStart;
+                            }
                         } else {
                                 #ifdef READ_FILE_DEBUG
                                     printf("Parsing file: \n");
                                 #endif
-                            while ((!feof(runfile)) && mot->ready()) {
-                                mot->write(readint(runfile));
-                                if(cfg->disablecancelcheck == false)
-                                {
-                                    if(dsp->read_nb() == K_CANCEL) {
-                                       while (mot->queue());
-                                       mot->reset();
-                                       fseek(runfile, 0, SEEK_END);
+                            bool changed = false;
+                            switch ( c ) {
+                                case K_CANCEL: // stop reading the job; it ends when the queued moves are done
+                                    if (!cfg->disablecancelcheck && !m_JobCancelled) {
+                                        prefetch_seek(prefetch_size());
+                                        m_JobCancelled = true;
                                     }
-                                }
+                                    break;
+                                case K_UP: changed = SetOverride(args[0] + OVERRIDE_STEP, args[1]); break;
+                                case K_DOWN: changed = SetOverride(args[0] - OVERRIDE_STEP, args[1]); break;
+                                case K_RIGHT: changed = SetOverride(args[0], args[1] + OVERRIDE_STEP); break;
+                                case K_LEFT: changed = SetOverride(args[0], args[1] - OVERRIDE_STEP); break;
                             }
+                            if (cfg->checkpoint > 0)
+                                SaveCheckpoint();
+                            if (st_stats.underruns != m_SeenUnderruns)
+                                RecordUnderrun();
                             #ifdef READ_FILE_DEBUG
                                     printf("File parsed \n");
                                 #endif
-                            if (feof(runfile) && mot->ready()) {
-                                fclose(runfile);
-                                runfile = NULL;
-                                mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
-                                screen=MAIN;
+                            if (prefetch_eof() && mot->ready() && (!m_JobCancelled || !mot->queue())) {
+                                if (m_JobCancelled) {
+                                    if (cfg->checkpoint > 0) // all moves are done
+                                        SaveCheckpoint();
+                                    mot->reset();
+                                }
+                                dsp->StopKeySampling();
+                                st_job_end();
+                                WriteJobStats();
+                                if (!m_JobCancelled)
+                                    checkpoint_clear();
+                                prefetch_close();
+                                SetOverride(100, 100);
+                                if (m_Queue && !m_JobCancelled) {
+                                    queue_done(jobname);
+                                    // sys.queue 1: analyze the next job and start it while this one finishes
+                                    m_Chain = (cfg->queue == 1) && queue_head(&m_QueueHead);
+                                }
+                                m_Queue = false;
+                                if (m_Chain) {
+                                    m_Queue = true;
+                                    strcpy(jobname, m_QueueHead.name);
+                                    screen = ANALYZING; m_StageAfterAnalyzing = RUNNING;
+                                } else {
+                                    mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
+                                    screen = (cfg->queue && queue_count()) ? QUEUE : MAIN;
+                                }
                             } else {
-                                nodisplay = 1;
+                                nodisplay = !changed; // only redraw for a new override
                             }
                         }
                 }
@@ -570,6 +713,9 @@ void LaosMenu::Handle() {
                 runfile = sd.openfile(jobname, "rb");
                 if (! runfile)
                 {
+                    if (m_Queue) // it has been removed
+                        queue_remove(jobname);
+                    m_Queue = m_Chain = false;
                     screen=MAIN;
                 }
                 else
@@ -577,11 +723,39 @@ void LaosMenu::Handle() {
                     // when running we need the bounds including all moves
                     // when executing BOUNDARIES we only need the actual lasered area
                     bool boundsOnlyWithLaserOn = (m_StageAfterAnalyzing == CALCULATEDBOUNDARIES);
-                    m_Extent.Reset(boundsOnlyWithLaserOn);
-                    while (!feof(runfile))
+                    bool estimate = (m_StageAfterAnalyzing == RUNNING);
+                    tJobMeta meta;
+                    fseek(runfile, 0, SEEK_END);
+                    unsigned long size = ftell(runfile);
+                    fseek(runfile, 0, SEEK_SET);
+                    if (jobmeta_load(jobname, &meta, size))
+                    {
+                        // analyzed while it was uploaded
+                        int i = boundsOnlyWithLaserOn ? 1 : 0;
+                        int *b = meta.bounds[i];
+                        m_Extent.SetBoundary((LaosExtent::TError)meta.err[i], b[0], b[1], b[2], b[3]);
+                        m_EstimatedTime = meta.time;
+                    }
+                    else
                     {
-                        m_Extent.Write(readint(runfile));
+                        m_Extent.Reset(boundsOnlyWithLaserOn);
+                        if (estimate)
+                            StartEstimate();
+                        while (!feof(runfile))
+                        {
+                            int v = readint(runfile);
+                            m_Extent.Write(v);
+                            if (estimate)
+                                m_Estimate.Write(v);
+                        }
+                        if (estimate) {
+                            m_Estimate.Finish();
+                            m_EstimatedTime = 1000 * m_Estimate.GetTime();
+                        }
                     }
+                    args[0] = plan_get_feed_override();
+                    args[1] = st_get_power_override();
+                    args[2] = (m_EstimatedTime + 500) / 1000;
                     fclose(runfile);
                     runfile = NULL;
                     int fileMinx, fileMiny, fileMaxx, fileMaxy;
@@ -599,6 +773,7 @@ void LaosMenu::Handle() {
                     }
                     if(outOfBounds)
                     {
+                        m_Queue = m_Chain = false;
                         screen=ERROR;
                         sarg=(char*)"Limit overrun";
                         waitup=1;                        
@@ -722,6 +897,19 @@ void LaosMenu::Handle() {
                 break;
                 
 
+#ifdef ST_PROFILE
+            case PROFILE: // stepper interrupt timing [cycles], dropped ticks
+                switch ( c ) {
+                    case K_UP: prof_print(); waitup = 1; break;
+                    case K_DOWN: prof_reset(); waitup = 1; break;
+                    case K_OK: case K_CANCEL: screen=MAIN; waitup = 1; break;
+                }
+                args[0]=prof_avg(&prof_isr);
+                args[1]=prof_isr.max;
+                args[2]=prof_drops;
+                break;
+#endif
+
             default:
                 screen = MAIN;
                 break;
@@ -734,6 +922,169 @@ void LaosMenu::Handle() {
 
 }
 
+/**
+*** Set up the estimator with the current planner settings
+**/
+void LaosMenu::StartEstimate() {
+    extern LaosMotion *mot;
+    LaosEstimate::TSettings s;
+    LaosJobMeta::GetEstimateSettings(s);
+    m_Estimate.Setup(s);
+    int x, y, z;
+    mot->getPlannedPositionRelativeToOrigin(&x, &y, &z);
+    m_Estimate.Reset(x, y);
+}
+
+/**
+*** Feed and power override [%] while a job runs (UP/DOWN: feed,
+*** RIGHT/LEFT: power). Returns true if either one changed.
+**/
+bool LaosMenu::SetOverride(int feed, int power) {
+    plan_set_feed_override(feed);
+    st_set_power_override(power);
+    bool changed = (args[0] != plan_get_feed_override()) || (args[1] != st_get_power_override());
+    args[0] = plan_get_feed_override();
+    args[1] = st_get_power_override();
+    return changed;
+}
+
+/**
+*** A job is being read (RUNNING, the prefetch buffer is open)
+**/
+bool LaosMenu::JobRunning() {
+    return (screen == RUNNING) && prefetch_isopen();
+}
+
+/**
+*** The job feeder task has work: a job runs, and LaosMotion takes the
+*** next command without waiting for the stepper
+**/
+bool LaosMenu::Feeding() {
+    extern LaosMotion *mot;
+    return JobRunning() && !prefetch_eof() && mot->ready();
+}
+
+/**
+*** Job feeder task: read the job into LaosMotion while it has room. The
+*** rest of RUNNING (keys, display, end of the job) is done by Handle()
+*** from the ui task, which also runs while the feeder has nothing to do
+**/
+void LaosMenu::Feed() {
+    extern LaosMotion *mot;
+    while ((!prefetch_eof()) && mot->ready()) {
+        mot->write(prefetch_readint());
+        if (m_CheckpointDue)
+            TakeCheckpoint();
+    }
+}
+
+/**
+*** Take a checkpoint, at a command boundary of the running job. It is
+*** saved by SaveCheckpoint() once the stepper has executed the blocks
+*** that are queued now. If LaosMotion is in the middle of something
+*** (bitmap, curve), try again after the next command.
+**/
+void LaosMenu::TakeCheckpoint() {
+    extern LaosMotion *mot;
+    tCheckpoint *cp = &m_Checkpoint;
+    if (!mot->getState(&cp->state))
+        return;
+    strncpy(cp->name, jobname, MAXFILESIZE);
+    cp->size = m_JobSize;
+    cp->offset = prefetch_tell();
+    mot->getOriginAbsolute(&cp->origin[0], &cp->origin[1], &cp->origin[2]);
+    m_CheckpointBlocks = plan_stats.queued;
+    m_CheckpointDue = false;
+    m_CheckpointPending = true;
+}
+
+/**
+*** Save the pending checkpoint when the stepper is past it, or mark the
+*** next one due after sys.checkpoint seconds
+**/
+void LaosMenu::SaveCheckpoint() {
+    extern Timer systime;
+    extern GlobalConfig *cfg;
+    if (m_CheckpointPending) {
+        // not st_stats.blocks: a chained job starts with blocks of the
+        // previous one still queued, and the job statistics are reset then
+        if (plan_blocks_done(m_CheckpointBlocks)) {
+            checkpoint_save(&m_Checkpoint);
+            m_CheckpointPending = false;
+            m_CheckpointTime = systime.read_ms();
+        }
+    } else if (systime.read_ms() - m_CheckpointTime >= cfg->checkpoint * 1000) {
+        m_CheckpointDue = true;
+    }
+}
+
+/**
+*** Start collecting statistics for the job in jobname
+**/
+void LaosMenu::StartJobStats() {
+    extern Timer systime;
+    st_job_start();
+    plan_stats.blocks = 0;
+    plan_stats.cycles = 0;
+    m_JobStart = systime.read_ms();
+    m_SeenUnderruns = 0;
+    m_Underruns = 0;
+    m_JobCancelled = false;
+    m_LogDropped = log_dropped();
+    sched_reset_stats();
+}
+
+/**
+*** The stepper ran out of blocks: remember where we were in the file
+**/
+void LaosMenu::RecordUnderrun() {
+    extern Timer systime;
+    m_SeenUnderruns = st_stats.underruns;
+    if (m_Underruns < JOB_UNDERRUNS) {
+        m_UnderrunOffset[m_Underruns] = prefetch_tell();
+        m_UnderrunTime[m_Underruns] = systime.read_ms() - m_JobStart;
+        m_Underruns++;
+    }
+}
+
+/**
+*** Append a summary of the job to JOBSTATS_FILE: run time, queue depth,
+*** number of underruns and the file offset and time [ms] of the first few
+**/
+void LaosMenu::WriteJobStats() {
+    extern LaosFileSystem sd;
+    extern Timer systime;
+    extern GlobalConfig *cfg;
+    int ms = systime.read_ms() - m_JobStart;
+    uint32_t blocks = st_stats.blocks;
+    uint32_t avg100 = blocks ? (100 * st_stats.depth_sum) / blocks : 0;
+    FILE *fp = sd.openfile((char*)JOBSTATS_FILE, "ab");
+    if (fp == NULL)
+        return;
+    fprintf(fp, "job=%s time=%d est=%d blocks=%lu underruns=%lu qmin=%lu qavg=%lu.%02lu%s",
+        jobname, ms, m_EstimatedTime, (unsigned long)blocks, (unsigned long)st_stats.underruns,
+        (unsigned long)(blocks ? st_stats.depth_min : 0),
+        (unsigned long)(avg100 / 100), (unsigned long)(avg100 % 100),
+        m_JobCancelled ? " cancelled" : "");
+    fprintf(fp, " steps=%lu sps=%lu plan=%lu%s",
+        (unsigned long)st_stats.steps,
+        (unsigned long)(ms > 0 ? (1000ULL * st_stats.steps) / ms : 0),
+        (unsigned long)(plan_stats.blocks ? plan_stats.cycles / plan_stats.blocks : 0),
+        cfg->dryrun ? " dryrun" : "");
+    fprintf(fp, " lines=%lu merged=%lu dropped=%lu",
+        (unsigned long)merge_stats.segments, (unsigned long)merge_stats.merged,
+        (unsigned long)merge_stats.dropped);
+    fprintf(fp, " pfmin=%lu pfwait=%lu sd=%lu%s",
+        prefetch_stats.min_level, prefetch_stats.starved, prefetch_stats.sd_bytes,
+        prefetch_stats.cached ? " cached" : "");
+    sched_fprint(fp);
+    fprintf(fp, " logdrop=%u", log_dropped() - m_LogDropped);
+    for (int i = 0; i < m_Underruns; i++)
+        fprintf(fp, " u=%d@%d", m_UnderrunOffset[i], m_UnderrunTime[i]);
+    fprintf(fp, "\n");
+    fclose(fp);
+}
+
 void LaosMenu::SetFileName(char * name) {
     strcpy(jobname, name);
 }
@@ -33,9 +33,17 @@
 #include "global.h"
 #include "LaosMotion.h"
 #include "LaosExtent.h"
+#include "LaosEstimate.h"
+#include "LaosJobMeta.h"
+#include "LaosCheckpoint.h"
+#include "LaosQueue.h"
 
 extern "C" void mbed_reset();
 
+#define JOBSTATS_FILE "jobstats.sys" // per job run statistics, one line per job
+#define JOB_UNDERRUNS 8 // number of underruns recorded per job
+#define OVERRIDE_STEP 10 // feed/power override change per key press [%]
+
     /** Menu system
       * Create server based on config file. 
       *
@@ -62,9 +70,20 @@ public:
   void SetScreen(int screen);
   void SetScreen(const std::string& msg);
   void SetFileName(char * name);
+  void ShowQueue();
   bool Cancel();
+  bool JobRunning(); // a job is being read
+  bool Feeding(); // the job feeder task has work
+  void Feed(); // job feeder task
   
 private:
+  void StartEstimate();
+  bool SetOverride(int feed, int power);
+  void StartJobStats();
+  void RecordUnderrun();
+  void WriteJobStats();
+  void TakeCheckpoint();
+  void SaveCheckpoint();
 
 private:
   // LaosDisplay *display;
@@ -83,12 +102,39 @@ private:
   // int xoff, yoff, zoff;
   FILE *runfile;
   LaosExtent m_Extent; // extent calculator
+  LaosEstimate m_Estimate; // run time estimate
+  int m_EstimatedTime; // [ms]
   int m_StageAfterAnalyzing;
   int m_SubStage;
   int m_PrevKey;
   bool m_MoveWaitTillQueueEmpty;
   int m_LaserTestPower; // in percent
   int m_LaserTestTime; // in ms
+
+  // job statistics
+  int m_JobStart; // systime [ms] at the start of the job
+  bool m_JobCancelled;
+  uint32_t m_SeenUnderruns; // st_stats.underruns already recorded
+  int m_Underruns; // entries used in m_UnderrunOffset/Time
+  int m_UnderrunOffset[JOB_UNDERRUNS]; // file offset [bytes]
+  int m_UnderrunTime[JOB_UNDERRUNS]; // time since job start [ms]
+  unsigned int m_LogDropped; // log_dropped() at the start of the job
+
+  // job checkpoints, see LaosCheckpoint.h
+  unsigned long m_JobSize; // [bytes]
+  tCheckpoint m_Checkpoint; // taken, saved when the stepper got there
+  bool m_CheckpointDue, m_CheckpointPending;
+  uint32_t m_CheckpointBlocks; // plan_stats.queued when it was taken
+  int m_CheckpointTime; // systime [ms] of the last one saved
+  tCheckpoint m_ResumePoint; // RESUME JOB: the checkpoint to continue from
+  bool m_ResumeFound, m_Resume;
+
+  // job queue, see LaosQueue.h
+  tQueueEntry m_QueueHead; // shown on JOB QUEUE
+  int m_QueueCount;
+  bool m_Queue; // the job comes from the queue
+  bool m_Chain; // and it starts while the previous one finishes
+  bool m_CoverOpened; // sys.queue 2: the cover was opened since the last job
 };
 
  
@@ -22,6 +22,7 @@
  *
  *
  */
+#include <math.h>
 #include "global.h"
 #include "LaosMotion.h"
 #include  "planner.h"
@@ -30,6 +31,12 @@
 
 // #define DO_MOTION_TEST 1
 
+// homing: distance of the first approach, further than any axis [mm]
+#define HOME_SEEK 2000
+
+// blocks one write() may queue: the line held for merging and a new one
+#define WRITE_MAX_BLOCKS 2
+
 // globals
 unsigned int step=0;
 int command=0;
@@ -42,6 +49,14 @@ tActionRequest  action;
 // position offsets
 static int ofsx=0, ofsy=0, ofsz=0;
 
+// Segment coalescing: the last line is held back, so the next one can be
+// merged with it
+tMergeStats merge_stats;
+static tActionRequest pending;
+static bool has_pending = false;
+static float pending_x, pending_y; // start of the pending line [mm]
+static float pending_dev;          // deviation of the merged points [mm]
+
 // Command interpreter
 int param=0, val=0;
 
@@ -52,6 +67,19 @@ unsigned long bitmap[BITMAP_SIZE];
 unsigned long bitmap_width=0; // nr of pixels
 unsigned long bitmap_size=0; // nr of bytes
 unsigned char bitmap_bpp=1, bitmap_enable=0;
+static bool wait_empty = false; // a bitmap line is queued: wait for it before the next command
+
+// Set the target of an action [micron]: in um for plan_buffer_line_um(), and
+// in mm for the segment merging and the planner position
+static void set_target(tActionRequest *a, int x, int y, int z)
+{
+  a->um[0] = x;
+  a->um[1] = y;
+  a->um[2] = z;
+  a->target.x = x * 0.001f;
+  a->target.y = y * 0.001f;
+  a->target.z = z * 0.001f;
+}
 
 /**
 *** LaosMotion() Constructor
@@ -82,7 +110,8 @@ LaosMotion::LaosMotion()
   mark_speed = cfg->speed;
   bitmap_speed = cfg->xspeed;
   action.param = 0;
-  action.target.x = action.target.y = action.target.z = action.target.e =0;
+  set_target(&action, 0, 0, 0);
+  action.target.e = 0;
   action.target.feed_rate = 60*mark_speed;
 
 #if DO_MOTION_TEST
@@ -128,6 +157,7 @@ LaosMotion::~LaosMotion()
 void LaosMotion::reset()
 {
   extern GlobalConfig *cfg;
+  int z;
   #ifdef READ_FILE_DEBUG
     printf("LaosMotion::reset()\n");
   #endif
@@ -138,17 +168,113 @@ void LaosMotion::reset()
   *laser = LASEROFF;
   enable = cfg->enable;
   cover.mode(PullUp);
+  m_Curve.Stop();
+  m_Curve.SetTolerance(cfg->curvetolerance);
+  has_pending = false;
+  bitmap_enable = 0; // a cancelled bitmap line
+  wait_empty = false;
+  memset(&merge_stats, 0, sizeof(merge_stats));
+  getCurrentPositionRelativeToOrigin(&m_LastX, &m_LastY, &z);
 }
 
 
 
 /**
 *** ready()
-*** ready to receive new commands
+*** ready to receive new commands: write() will not have to wait for the
+*** stepper. A curve that is being queued is continued first
 **/
 int LaosMotion::ready()
 {
-  return !plan_queue_full();
+  if ( has_pending && !plan_queue_items() ) // do not let the stepper wait for a merge
+    Flush();
+  if ( m_Curve.Busy() )
+    PumpCurve();
+  if ( m_Curve.Busy() || plan_queue_room() < WRITE_MAX_BLOCKS )
+    return 0;
+  // bitmap lines start on an empty queue, and the next command waits for them
+  bool bitmap_wait = wait_empty || ( step == 2 && (command == 9 || (command == 1 && bitmap_enable)) );
+  return !bitmap_wait || !plan_queue_items();
+}
+
+/**
+*** PumpCurve()
+*** queue the segments of the current curve, as long as the planner has room
+**/
+void LaosMotion::PumpCurve()
+{
+  int x, y;
+  while ( !plan_queue_full() && m_Curve.Next(x, y) )
+  {
+    set_target(&action, x-ofsx, y-ofsy, 0);
+    action.param = power;
+    action.ActionType = AT_LASER;
+    action.target.feed_rate = 60 * mark_speed;
+    QueueLine(&action);
+    UpdatePlannedCoordinates(&action);
+  }
+}
+
+/**
+*** QueueLine()
+*** Queue a line (AT_MOVE or AT_LASER). It is held back, and merged with the
+*** next line if that has the same type, power and speed, and the points in
+*** between stay within motion.mergetolerance of the merged line. Lines
+*** shorter than a step with another type, power or speed are dropped;
+*** they are measured from the end of the held line, so they cannot add up.
+**/
+void LaosMotion::QueueLine(const tActionRequest *a)
+{
+  extern GlobalConfig *cfg;
+  merge_stats.segments++;
+  if ( has_pending )
+  {
+    float ex = pending.target.x, ey = pending.target.y;
+    float dx = a->target.x - ex, dy = a->target.y - ey;
+    bool substep = fabs(dx * cfg->xscale) < 500 && fabs(dy * cfg->yscale) < 500; // half a step [mm * steps/m]
+    bool same = (a->ActionType == pending.ActionType) && (a->param == pending.param) &&
+      (a->target.feed_rate == pending.target.feed_rate) && (a->target.z == pending.target.z);
+    if ( substep && !same )
+    {
+      merge_stats.dropped++;
+      return;
+    }
+    if ( same )
+    {
+      // distance of the pending end point to the merged line
+      float cx = a->target.x - pending_x, cy = a->target.y - pending_y;
+      float len = sqrt(cx*cx + cy*cy);
+      float forward = (ex - pending_x) * dx + (ey - pending_y) * dy;
+      float dev = len > 0 ? fabs(cx * (ey - pending_y) - cy * (ex - pending_x)) / len : 0;
+      // short lines too: the end of the held line moves with every merge
+      if ( (forward > 0 || (dx == 0 && dy == 0)) && pending_dev + dev <= cfg->mergetolerance / 1000.0 )
+      {
+        pending_dev += dev;
+        pending = *a; // same type, power and speed: only the target changes
+        merge_stats.merged++;
+        return;
+      }
+    }
+    Flush();
+  }
+  pending_x = startpoint.x;
+  pending_y = startpoint.y;
+  pending_dev = 0;
+  pending = *a;
+  has_pending = true;
+}
+
+/**
+*** Flush()
+*** queue the line that is held for merging
+**/
+void LaosMotion::Flush()
+{
+  if ( has_pending )
+  {
+    has_pending = false;
+    plan_buffer_line_um(&pending);
+  }
 }
 
 
@@ -158,6 +284,7 @@ int LaosMotion::ready()
 **/
 int LaosMotion::queue()
 {
+  Flush();
   return plan_queue_items();
 }
 
@@ -194,22 +321,22 @@ void LaosMotion::moveToAbsoluteWithAbsoluteFeedrate(int x, int y, int z, int fee
   if(y > cfg->ymax) y=cfg->ymax;
   if(z > cfg->zmax) z=cfg->zmax;
   tActionRequest action;
-  action.target.x = x/1000.0;
-  action.target.y = y/1000.0;
-  action.target.z = z/1000.0;
+  Flush();
+  set_target(&action, x, y, z);
+  action.target.e = 0;
   action.ActionType = actiontype;
   action.target.feed_rate =  feedrate;
   action.param = power;
-  plan_buffer_line(&action);
+  plan_buffer_line_um(&action);
   UpdatePlannedCoordinates(&action);
    //printf("To buffer: %d, %d, %d, %d\n", x, y,z,speed);
 }
 
 void LaosMotion::UpdatePlannedCoordinates(const tActionRequest *action)
 {
-  m_PlannedXAbsolute = action->target.x * 1000.0;
-  m_PlannedYAbsolute = action->target.y * 1000.0;
-  m_PlannedZAbsolute = action->target.z * 1000.0;
+  m_PlannedXAbsolute = action->um[0];
+  m_PlannedYAbsolute = action->um[1];
+  m_PlannedZAbsolute = action->um[2];
 }
 
 /**
@@ -221,6 +348,7 @@ void LaosMotion::write(int i)
 {
   extern GlobalConfig *cfg;
   static int x=0,y=0,z=0;
+  static int args[6]; // curve parameters
   //if (  plan_queue_empty() )
   //printf("Empty\n");
   
@@ -229,6 +357,14 @@ void LaosMotion::write(int i)
     printf(">%i (command: %i, step: %i)\n",i,command,step);
   #endif 
   
+  while ( m_Curve.Busy() ) // the caller did not wait for ready()
+    PumpCurve();
+  if ( wait_empty )
+  {
+    while ( queue() ); // wait for the bitmap line to finish
+    wait_empty = false;
+  }
+
   if ( step == 0 )
   {
     command = i;
@@ -243,12 +379,13 @@ void LaosMotion::write(int i)
             switch ( step )
             {
               case 1:
-                action.target.x = (i-ofsx)/1000.0;
+                x = i;
                 break;
               case 2:
-                action.target.y = (i-ofsy)/1000.0;;
+                set_target(&action, x-ofsx, i-ofsy, 0);
+                m_LastX = x;
+                m_LastY = i;
                 step=0;
-                action.target.z = 0;
                 action.param = power;
                 action.ActionType =  (command ? AT_LASER : AT_MOVE);
                 if ( bitmap_enable && (action.ActionType == AT_LASER))
@@ -268,15 +405,15 @@ void LaosMotion::write(int i)
                 if ( action.ActionType == AT_BITMAP )
                 {
                   while ( queue() );// printf("-"); // wait for queue to empty
-                  plan_set_accel(cfg->xaccel);
-                  plan_buffer_line(&action);
+                  plan_buffer_line_um(&action);
                   UpdatePlannedCoordinates(&action);
-                  while ( queue() ); // printf("*"); // wait for queue to empty
-                  plan_set_accel(cfg->accel);
+                  wait_empty = true; // the next command waits for it, see ready()
                 }
                 else
-                  plan_buffer_line(&action);
+                {
+                  QueueLine(&action);
                   UpdatePlannedCoordinates(&action);
+                }
                 break;
             }
             break;
@@ -289,6 +426,7 @@ void LaosMotion::write(int i)
                 action.param = power;
                 action.ActionType =  AT_MOVE;
                 action.target.feed_rate =  60.0 * cfg->speed;
+                Flush();
                 plan_buffer_line(&action);
                 UpdatePlannedCoordinates(&action);
                 break;
@@ -306,6 +444,8 @@ void LaosMotion::write(int i)
               case 3:
                 z = i;
                 setPositionRelativeToOrigin(x,y,z);
+                m_LastX = x;
+                m_LastY = y;
                 step=0;
                 break;
             }
@@ -372,6 +512,53 @@ void LaosMotion::write(int i)
               }
             }
             break;
+         case 10: // clockwise arc: 10 <x> <y> <cx> <cy> (laser on)
+         case 11: // counter clockwise arc: 11 <x> <y> <cx> <cy>
+            args[step-1] = i;
+            if ( step == 4 )
+            {
+              step = 0;
+              m_Curve.Arc(m_LastX, m_LastY, args[0], args[1], args[2], args[3], command == 11);
+              m_LastX = args[0];
+              m_LastY = args[1];
+              PumpCurve();
+            }
+            break;
+         case 13: // cubic Bezier: 13 <x1> <y1> <x2> <y2> <x> <y> (laser on)
+            args[step-1] = i;
+            if ( step == 6 )
+            {
+              step = 0;
+              m_Curve.Bezier(m_LastX, m_LastY, args[0], args[1], args[2], args[3], args[4], args[5]);
+              m_LastX = args[4];
+              m_LastY = args[5];
+              PumpCurve();
+            }
+            break;
+         case 14: // polyline: 14 <n> <dx-1> <dy-1> ... <dx-n> <dy-n> (relative, laser on)
+            if ( step == 1 )
+            {
+              args[0] = i;
+              if ( i < 1 ) step = 0;
+            }
+            else if ( step % 2 == 0 )
+            {
+              args[1] = i;
+            }
+            else
+            {
+              m_LastX += args[1];
+              m_LastY += i;
+              set_target(&action, m_LastX-ofsx, m_LastY-ofsy, 0);
+              action.param = power;
+              action.ActionType = AT_LASER;
+              action.target.feed_rate = 60 * mark_speed;
+              QueueLine(&action);
+              UpdatePlannedCoordinates(&action);
+              if ( (int)((step-1)/2) == args[0] ) // last vertex
+                step = 0;
+            }
+            break;
          default: // I do not understand: stop motion
             step = 0;
             break;
@@ -406,6 +593,7 @@ void LaosMotion::setPositionRelativeToOrigin(int x, int y, int z)
 **/
 void LaosMotion::setPositionAbsolute(int x, int y, int z)
 {
+  Flush();
   m_PlannedXAbsolute = x;
   m_PlannedYAbsolute = y;
   m_PlannedZAbsolute = z;
@@ -474,6 +662,46 @@ void LaosMotion::setOriginAbsolute(int x, int y, int z)
   ofsz = -z;
 }
 
+void LaosMotion::getOriginAbsolute(int *x, int *y, int *z)
+{
+  *x = -ofsx;
+  *y = -ofsy;
+  *z = -ofsz;
+}
+
+/**
+*** getState()
+*** The parser state, if it is at a command boundary. The line that is held
+*** for merging is queued, so the state covers all queued moves.
+**/
+bool LaosMotion::getState(tMotionState *s)
+{
+  if ( step || bitmap_enable || m_Curve.Busy() )
+    return false;
+  Flush();
+  s->x = m_LastX;
+  s->y = m_LastY;
+  s->z = m_PlannedZAbsolute + ofsz;
+  s->mark_speed = mark_speed;
+  s->bitmap_speed = bitmap_speed;
+  s->power = power;
+  return true;
+}
+
+/**
+*** setState()
+*** Restore a parser state from getState(), and travel to its position
+**/
+void LaosMotion::setState(const tMotionState *s)
+{
+  moveToRelativeToOrigin(s->x, s->y, s->z);
+  m_LastX = s->x;
+  m_LastY = s->y;
+  mark_speed = s->mark_speed;
+  bitmap_speed = s->bitmap_speed;
+  power = s->power;
+}
+
 /* 
   Make current position the origin. 'origin' is defined here as the top left corner (0,0) in Visicut
   Since LAOS has the y coordinate 0 at the bottom of the bed, we need to offset by the bed height.
@@ -489,52 +717,108 @@ void LaosMotion::MakeCurrentPositionOrigin()
 
 
 
+// Direction of the home switch [-1/1]: the move for which the direction
+// output equals homedir (see set_direction_pins())
+static int home_sign(int homedir, int scale)
+{
+  return ((!homedir) ^ (scale < 0)) ? -1 : 1;
+}
+
+// Feedrate [mm/min] for a delay of us [usec] per half step
+static float home_feed(int us, int scale)
+{
+  if (us < 1) us = 1;
+  return 60.0 * 1E6 / (2.0 * us * fabs(scale / 1000.0));
+}
+
+// Queue one homing move, relative to the current position [mm], and wait
+// until it is done. An AT_MOVE_ENDSTOP move stops short on the switches,
+// so the actual position becomes the planner position.
+static void home_move(eActionType type, float dx, float dy, float dz, float feedrate)
+{
+  float x, y, z;
+  tActionRequest a;
+  plan_get_current_position_xyz(&x, &y, &z);
+  a.ActionType = type;
+  a.target = startpoint;
+  a.target.x = x + dx;
+  a.target.y = y + dy;
+  a.target.z = z + dz;
+  a.target.feed_rate = feedrate;
+  a.param = 0;
+  plan_buffer_line(&a);
+  st_synchronize();
+  plan_get_current_position_xyz(&x, &y, &z);
+  plan_set_current_position_xyz(x, y, z);
+}
+
 /**
 *** Home the axis, stop when both home switches are pressed
+*** Each homing cycle runs through the planner: an accelerated seek to the
+*** switches, back off, and a slow second approach that sets the position.
+*** A switch that is still pressed after the back off is stuck (or the back
+*** off is too short): homing fails, as it does when a switch is not found.
 **/
 void LaosMotion::home(int x, int y, int z)
 {
   extern GlobalConfig *cfg;
-  int i=0;
-  printf("Homing %d,%d, with speed %d\n", x, y, cfg->homespeed);
-  xdir = cfg->xhomedir;
-  ydir = cfg->yhomedir;
-  zdir = cfg->zhomedir;
+  printf("Homing %d,%d, with speed %d\n", x, y, cfg->homefast);
   led1 = 0;
   isHome = false;
+  if (cfg->dryrun) // no switches on the bench
+  {
+    setOriginAbsolute(0, 0, 0);
+    setPositionAbsolute(x,y,z);
+    isHome = true;
+    return;
+  }
+  float backoff = cfg->homebackoff / 1000.0;
   printf("Home Z...\n\r");
   if (cfg->autozhome) {
+    float sz = home_sign(cfg->zhomedir, cfg->zscale);
+    float slow = home_feed(cfg->zhomespeed, cfg->zscale);
     printf("Homing %d with speed %d\n", z, cfg->zhomespeed);
-    while ((zmin ^ cfg->zpol) && (zmax ^ cfg->zpol)) {
-        zstep = 0;
-        wait(cfg->zhomespeed/1E6);
-        zstep = 1;
-        wait(cfg->zhomespeed/1E6);
+    if ( cfg->zhomefast > 0 )
+    {
+      home_move(AT_MOVE_ENDSTOP, 0, 0, sz * HOME_SEEK, 60.0 * cfg->zhomefast);
+      home_move(AT_MOVE, 0, 0, -sz * backoff, 60.0 * cfg->zhomefast);
+      if ( backoff > 0 && hit_home_stop_z(0) )
+      {
+        printf("Home failed: Z switch still pressed after back off.\n\r");
+        return;
+      }
+      home_move(AT_MOVE_ENDSTOP, 0, 0, sz * 2 * backoff, slow);
     }
+    else
+      home_move(AT_MOVE_ENDSTOP, 0, 0, sz * HOME_SEEK, slow);
   }
   printf("Home XY...\n\r");
-  while ( 1 )
+  float sx = home_sign(cfg->xhomedir, cfg->xscale);
+  float sy = home_sign(cfg->yhomedir, cfg->yscale);
+  float slow = fmin(home_feed(cfg->homespeed, cfg->xscale), home_feed(cfg->homespeed, cfg->yscale));
+  home_move(AT_MOVE_ENDSTOP, sx * HOME_SEEK, sy * HOME_SEEK, 0, 60.0 * cfg->homefast);
+  home_move(AT_MOVE, -sx * backoff, -sy * backoff, 0, 60.0 * cfg->homefast);
+  if ( backoff > 0 && (hit_home_stop_x(0) || hit_home_stop_y(0)) )
   {
-    xstep = ystep = 0;
-    wait(cfg->homespeed/1E6);
-    xstep = xhome ^ cfg->xpol;
-    ystep = yhome ^ cfg->ypol;
-    wait(cfg->homespeed/1E6);
-
     led2 = !xhome;
     led3 = !yhome;
-    led4 = ((i++) & 0x10000);
-    if ( !(xhome ^ cfg->xpol) && !(yhome ^ cfg->ypol) )
-    {
-      setOriginAbsolute(0, 0, 0); // reset origin
-      setPositionAbsolute(x,y,z);
-      moveToAbsolute(x,y,z);
-      isHome = true;
-      printf("Home done.\n\r");
-      return;
-    }
+    printf("Home failed: switches still pressed after back off.\n\r");
+    return;
   }
+  home_move(AT_MOVE_ENDSTOP, sx * 2 * backoff, sy * 2 * backoff, 0, slow);
 
+  led2 = !xhome;
+  led3 = !yhome;
+  if ( !hit_home_stop_x(0) || !hit_home_stop_y(0) )
+  {
+    printf("Home failed: switches not found.\n\r");
+    return;
+  }
+  setOriginAbsolute(0, 0, 0); // reset origin
+  setPositionAbsolute(x,y,z);
+  moveToAbsolute(x,y,z);
+  isHome = true;
+  printf("Home done.\n\r");
 }
 
 
@@ -27,6 +27,24 @@
 #include "global.h"
 #include "pins.h"
 #include  "planner.h"
+#include "LaosCurve.h"
+
+// Segment coalescing statistics of the current job
+typedef struct {
+  uint32_t segments;  // lines offered to the coalescer
+  uint32_t merged;    // lines merged into the previous one
+  uint32_t dropped;   // lines shorter than a step that could not be merged
+} tMergeStats;
+extern tMergeStats merge_stats;
+
+// Parser state at a simplecode command boundary: enough to continue a job there
+typedef struct {
+  int x, y;           // end of the last move, relative to the origin [micron]
+  int z;              // planned z, relative to the origin [micron]
+  int mark_speed;     // [mm/sec]
+  int bitmap_speed;   // [mm/sec]
+  int power;          // [0..10000]
+} tMotionState;
 
     /** Motion Controll system
       *
@@ -54,6 +72,7 @@ public:
   void getPlannedPositionRelativeToOrigin(int *x, int *y, int *z);
   void getPlannedPositionAbsolute(int *x, int *y, int *z);
   void setOriginAbsolute(int x, int y, int z); // set the origin to this absolute position [micron]
+  void getOriginAbsolute(int *x, int *y, int *z);
   void MakeCurrentPositionOrigin(); // set the current position to be the origin
   void moveToRelativeToOrigin(int x, int y, int z, int speed=100, int power=100);
   void moveToAbsolute(int x, int y, int z, int speed=100, int power=100);
@@ -62,9 +81,18 @@ public:
   int queue(); // queued items
   void getLimitsRelative(int *minx, int *miny, int *minz, int *maxx, int *maxy, int *maxz);
   void UpdatePlannedCoordinates(const tActionRequest *action);
+  bool getState(tMotionState *state); // false if a command, bitmap line or curve is unfinished
+  void setState(const tMotionState *state); // continue from a saved state: move there, laser off
+
+private:
+  void PumpCurve(); // queue curve segments while the planner has room
+  void QueueLine(const tActionRequest *action); // queue a line, merge it with the previous one if possible
+  void Flush(); // queue the line that is held for merging
 
 private:
   int m_PlannedXAbsolute, m_PlannedYAbsolute, m_PlannedZAbsolute; // in absolute coordinates
+  LaosCurve m_Curve; // arc or Bezier being queued
+  int m_LastX, m_LastY; // end of the last simplecode move, relative to the origin: start of a curve
 
 };
 
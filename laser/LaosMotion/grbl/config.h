@@ -36,7 +36,11 @@ typedef struct config_s
   int32_t maximum_feedrate_y;
   int32_t maximum_feedrate_z;
   int32_t maximum_feedrate_e;
-  float  acceleration;
+  float  acceleration_x; // per axis acceleration limits [mm/sec2]
+  float  acceleration_y;
+  float  acceleration_z;
+  float  acceleration_e;
+  float  acceleration_raster; // X limit of bitmap lines [mm/sec2]
   float  junction_deviation; 
 } config_t;
 
@@ -26,6 +26,7 @@
 #include <math.h>       
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
 
 
 #include "global.h"
@@ -41,6 +42,7 @@ config_t config;
 // The number of linear motions that can be in the plan at any give time
 #define BLOCK_BUFFER_SIZE 16
 tTarget startpoint;
+tPlannerStats plan_stats;
 
 static block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
 static volatile uint8_t block_buffer_head;       // Index of the next block to be pushed
@@ -53,6 +55,9 @@ static float previous_nominal_speed;   // Nominal speed of previous path line se
 static uint8_t acceleration_manager_enabled;   // Acceleration management active?
 
 static float rounde[NUM_AXES]; // Rounding errors.
+static int64_t steps_per_um[3]; // x, y, z [steps/micron], 32.32 fixed point, see plan_buffer_line_um()
+static float mm_per_step[NUM_AXES]; // 1/steps_per_mm, so a block needs no divisions for its path vector
+static int feed_override = 100; // [%]
 
 
 // initial entry point of the planner
@@ -67,6 +72,9 @@ void plan_init() {
   previous_nominal_speed = 0.0;
   
   memset (&startpoint, 0, sizeof(startpoint));
+  memset (&plan_stats, 0, sizeof(plan_stats));
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // cycle counter for plan_stats
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
   
  // default config:
   config.steps_per_mm_x = fabs((float)cfg->xscale/1000.0); // convert xscale from [steps/meter] to [steps/mm]
@@ -77,14 +85,23 @@ void plan_init() {
   config.maximum_feedrate_y = 60 * cfg->yspeed;
   config.maximum_feedrate_z = 60 * cfg->zspeed;
   config.maximum_feedrate_e = 60 * cfg->espeed;
-  config.acceleration = cfg->accel; // [mm/sec2]
+  config.acceleration_x = plan_accel(cfg->xaccel > 0 ? cfg->xaccel : cfg->accel); // [mm/sec2]
+  config.acceleration_y = plan_accel(cfg->yaccel > 0 ? cfg->yaccel : cfg->accel);
+  config.acceleration_z = plan_accel(cfg->zaccel > 0 ? cfg->zaccel : cfg->accel);
+  config.acceleration_e = plan_accel(cfg->eaccel > 0 ? cfg->eaccel : cfg->accel);
+  config.acceleration_raster = plan_accel(cfg->rasteraccel);
   config.junction_deviation = cfg->tolerance/1000.0; //  convert tolerance from [micron] to [mm]
   rounde[X_AXIS]=0;
   rounde[Y_AXIS]=0;
   rounde[Z_AXIS]=0;
+  const int scale[3] = { cfg->xscale, cfg->yscale, cfg->zscale }; // [steps/meter]
+  for (int i = 0; i < 3; i++)
+    steps_per_um[i] = (int64_t)floor(fabs((double)scale[i]) * (4294967296.0 / 1000000.0) + 0.5);
+  const float steps_per_mm[NUM_AXES] = { config.steps_per_mm_x, config.steps_per_mm_y,
+    config.steps_per_mm_z, config.steps_per_mm_e };
+  for (int i = 0; i < NUM_AXES; i++)
+    mm_per_step[i] = steps_per_mm[i] > 0 ? 1.0 / steps_per_mm[i] : 0;
 
-  
-  config.junction_deviation = 0.05;
  //  config.steps_per_mm_x =  config.steps_per_mm_y =  config.steps_per_mm_z =  config.steps_per_mm_e = 200;
   // config.acceleration = 200;
   //config.maximum_feedrate_x =  config.maximum_feedrate_y =  config.maximum_feedrate_z =  config.maximum_feedrate_e = 60000;
@@ -92,15 +109,15 @@ void plan_init() {
   printf("steps_per_mm_y %f...\n", (float)config.steps_per_mm_y);
   printf("steps_per_mm_z %f...\n", (float)config.steps_per_mm_z);
   printf("steps_per_mm_e %f...\n", (float)config.steps_per_mm_e);
-  printf("accel %f...\n", (float)config.acceleration);
-  printf("Motion: double=%d, float=%d, block=%d\n", sizeof(double), sizeof(float), sizeof(block_t));
+  printf("accel x %f, y %f...\n", (float)config.acceleration_x, (float)config.acceleration_y);
+  printf("Motion: double=%d, float=%d, block=%d\n", (int)sizeof(double), (int)sizeof(float), (int)sizeof(block_t));
 
 }
 
-void plan_set_accel(float a)
+float plan_accel(float a)
 {
-  printf("accel=%d\n", (int) a);
-  config.acceleration = a;
+  extern GlobalConfig *cfg;
+  return cfg->scurve ? a / SCURVE_PEAK : a;
 }
 
 
@@ -170,7 +187,7 @@ static void planner_reverse_pass_kernel(block_t *previous, block_t *current, blo
       // for max allowable speed if block is decelerating and nominal length is false.
       if ((!current->nominal_length_flag) && (current->max_entry_speed > next->entry_speed)) {
         current->entry_speed = min( current->max_entry_speed,
-          max_allowable_speed(-config.acceleration,next->entry_speed,current->millimeters));
+          max_allowable_speed(-current->acceleration,next->entry_speed,current->millimeters));
       } else {
         current->entry_speed = current->max_entry_speed;
       } 
@@ -208,7 +225,7 @@ static void planner_forward_pass_kernel(block_t *previous, block_t *current, blo
   if (!previous->nominal_length_flag) {
     if (previous->entry_speed < current->entry_speed) {
       float entry_speed = min( current->entry_speed,
-        max_allowable_speed(-config.acceleration,previous->entry_speed,previous->millimeters) );
+        max_allowable_speed(-previous->acceleration,previous->entry_speed,previous->millimeters) );
 
       // Check for junction speed change
       if (current->entry_speed != entry_speed) {
@@ -269,7 +286,7 @@ static void calculate_trapezoid_for_block(block_t *block, float entry_factor, fl
     accelerate_steps = ceil(
       intersection_distance(block->initial_rate, block->final_rate, acceleration_per_minute, block->step_event_count));
     accelerate_steps = max(accelerate_steps,0); // Check limits due to numerical round-off
-    accelerate_steps = min(accelerate_steps,block->step_event_count);
+    accelerate_steps = min(accelerate_steps,(int32_t)block->step_event_count);
     plateau_steps = 0;
   }  
   
@@ -353,6 +370,76 @@ int plan_is_acceleration_manager_enabled() {
   return(acceleration_manager_enabled);
 }
 
+int plan_get_feed_override()
+{
+  return feed_override;
+}
+
+// Set the feed override and replan the queue with it. The running block and the next one
+// keep their plan: the stepper may start the next block at any moment. The entry speed of
+// the block after them is their exit speed, so it stays as well. From there on each block
+// gets its new nominal speed, but no block may have to brake harder than its acceleration:
+// vmin is the lowest speed reachable from the fixed entry speed, and the nominal and entry
+// speeds are kept at or above it. The old plan was at or above it too, so the reverse and
+// forward passes always find a plan within the acceleration limits.
+void plan_set_feed_override(int percent)
+{
+  percent = max(OVERRIDE_MIN, min(OVERRIDE_MAX, percent));
+  if (percent == feed_override)
+    return;
+  feed_override = percent;
+  if (!acceleration_manager_enabled)
+    return;
+
+  int8_t first = block_buffer_tail;
+  for (int i = 0; i < 2 && first != block_buffer_head; i++)
+    first = next_block_index(first);
+  if (first == block_buffer_head)
+    return; // nothing left to replan
+
+  block_t *previous = &block_buffer[prev_block_index(first)];
+  block_t *fixed = &block_buffer[first];
+  float vmin = fixed->entry_speed;
+  float fixed_max_entry = 0;
+  float next_max_entry = previous->max_entry_speed;
+  previous->max_entry_speed = previous->entry_speed; // pin the next block during the passes
+  for (int8_t index = first; index != block_buffer_head; index = next_block_index(index))
+  {
+    block_t *block = &block_buffer[index];
+    if (block->requested_speed > 0)
+      block->nominal_speed = min(block->requested_speed * feed_override / 100, block->max_nominal_speed);
+    block->nominal_speed = max(block->nominal_speed, vmin);
+    block->nominal_rate = ceil(block->step_event_count * block->nominal_speed / block->millimeters);
+
+    float max_entry = min(block->max_junction_speed, min(previous->nominal_speed, block->nominal_speed));
+    block->max_entry_speed = max(max_entry, vmin);
+    float v_allowable = max_allowable_speed(-block->acceleration, MINIMUM_PLANNER_SPEED, block->millimeters);
+    block->nominal_length_flag = (block->nominal_speed <= v_allowable);
+    // the newest block is not checked by the reverse pass: it starts from its limit
+    if (next_block_index(index) == block_buffer_head)
+      block->entry_speed = max(min(block->max_entry_speed, v_allowable), vmin);
+    else
+      block->entry_speed = vmin;
+    block->recalculate_flag = true;
+
+    if (block == fixed)
+    {
+      // pin the entry speed during the passes
+      fixed_max_entry = block->max_entry_speed;
+      block->entry_speed = block->max_entry_speed = vmin;
+    }
+    float v2 = vmin*vmin - 2*block->acceleration*60*60*block->millimeters;
+    vmin = (v2 > 0) ? sqrt(v2) : 0;
+    previous = block;
+  }
+  if (previous_nominal_speed > 0.0)
+    previous_nominal_speed = previous->nominal_speed;
+
+  planner_recalculate();
+  fixed->max_entry_speed = fixed_max_entry;
+  block_buffer[prev_block_index(first)].max_entry_speed = next_max_entry;
+}
+
 void plan_discard_current_block() {
   if (block_buffer_head != block_buffer_tail) {
     block_buffer_tail = next_block_index( block_buffer_tail );
@@ -364,6 +451,8 @@ block_t *plan_get_current_block() {
   return(&block_buffer[block_buffer_tail]);
 }
 
+static void plan_buffer_block(tActionRequest *pAction, const int32_t *target);
+
 // Add a new Action movement to the buffer. x, y and z is the signed, absolute target position in 
 // millimeters. Feed rate specifies the speed of the motion. 
 void plan_buffer_line (tActionRequest *pAction)
@@ -371,17 +460,13 @@ void plan_buffer_line (tActionRequest *pAction)
   float x;
   float y;
   float z;
-  float feed_rate;
-  bool e_only = false;
-  float speed_x, speed_y, speed_z, speed_e; // Nominal mm/minute for each axis  
     
   x = pAction->target.x;
   y = pAction->target.y;
   z = pAction->target.z;
-  feed_rate = pAction->target.feed_rate;
   
   #ifdef READ_FILE_DEBUG
-		printf("> ACTION type: %i target: (x:%f y:%f f:%f) power: %" SCNd16 "\n",pAction->ActionType,x,y,(float)feed_rate,pAction->param);
+		printf("> ACTION type: %i target: (x:%f y:%f f:%f) power: %" SCNd16 "\n",pAction->ActionType,x,y,(float)pAction->target.feed_rate,pAction->param);
 	#endif
 	
   // hard clipping. Might implement correct clipping some day...
@@ -403,6 +488,35 @@ void plan_buffer_line (tActionRequest *pAction)
   rounde[X_AXIS]=(x*(float)config.steps_per_mm_x+rounde[X_AXIS])-(float)target[X_AXIS];
   rounde[Y_AXIS]=(y*(float)config.steps_per_mm_y+rounde[Y_AXIS])-(float)target[Y_AXIS];
   rounde[Z_AXIS]=(z*(float)config.steps_per_mm_z+rounde[Z_AXIS])-(float)target[Z_AXIS];
+  plan_buffer_block(pAction, target);
+}
+
+// Steps for um micron, rounded, with k [steps/micron] in 32.32 fixed point
+static inline int32_t um_to_steps(int32_t um, int64_t k)
+{
+  return (int32_t)(((int64_t)um * k + 0x80000000LL) >> 32);
+}
+
+// As plan_buffer_line(), with the x, y and z target in pAction->um [micron]. On a core
+// without FPU this saves the float scaling and rounding of the target. The target is
+// rounded to the nearest step, without the error feedback of the float version, so the
+// two can differ by a step.
+void plan_buffer_line_um (tActionRequest *pAction)
+{
+  int32_t target[NUM_AXES];
+  target[X_AXIS] = um_to_steps(pAction->um[X_AXIS], steps_per_um[X_AXIS]);
+  target[Y_AXIS] = um_to_steps(pAction->um[Y_AXIS], steps_per_um[Y_AXIS]);
+  target[Z_AXIS] = um_to_steps(pAction->um[Z_AXIS], steps_per_um[Z_AXIS]);
+  target[E_AXIS] = lround(pAction->target.e*(float)config.steps_per_mm_e);
+  rounde[X_AXIS] = rounde[Y_AXIS] = rounde[Z_AXIS] = 0;
+  plan_buffer_block(pAction, target);
+}
+
+// Queue a block to the target [steps]
+static void plan_buffer_block(tActionRequest *pAction, const int32_t *target)
+{
+  float feed_rate = pAction->target.feed_rate;
+  float speed_x, speed_y, speed_z, speed_e; // Nominal mm/minute for each axis  
 
   // Calculate the buffer head after we push this byte
   int next_buffer_head = next_block_index( block_buffer_head );    
@@ -410,6 +524,7 @@ void plan_buffer_line (tActionRequest *pAction)
   // If the buffer is full: good! That means we are well ahead of the robot. 
   // Rest here until there is room in the buffer.
   while(block_buffer_tail == next_buffer_head) { sleep_mode(); }
+  uint32_t start_cycles = DWT->CYCCNT;
   
   // Prepare to set up new block
   block_t *block = &block_buffer[block_buffer_head];
@@ -437,22 +552,25 @@ void plan_buffer_line (tActionRequest *pAction)
   
   // Compute path vector in terms of absolute step target and current positions
   float delta_mm[NUM_AXES];
-  delta_mm[X_AXIS] = (target[X_AXIS]-position[X_AXIS])/(float)config.steps_per_mm_x;
-  delta_mm[Y_AXIS] = (target[Y_AXIS]-position[Y_AXIS])/(float)config.steps_per_mm_y;
-  delta_mm[Z_AXIS] = (target[Z_AXIS]-position[Z_AXIS])/(float)config.steps_per_mm_z;
-  delta_mm[E_AXIS] = (target[E_AXIS]-position[E_AXIS])/(float)config.steps_per_mm_e;
+  for (int i = 0; i < NUM_AXES; i++)
+    delta_mm[i] = (target[i]-position[i])*mm_per_step[i];
   block->millimeters = sqrt(square(delta_mm[X_AXIS]) + square(delta_mm[Y_AXIS]) + 
                             square(delta_mm[Z_AXIS]));
-  if (block->millimeters == 0)
-  {
-    e_only = true;
+  if (block->millimeters == 0) // e only
     block->millimeters = fabs(delta_mm[E_AXIS]);
-  }
   float inverse_millimeters = 1.0/block->millimeters;  // Inverse millimeters to remove multiple divides    
   
 //
 // Speed limit code from Marlin firmware
 //
+  // feed override, except for homing moves
+  block->requested_speed = 0;
+  if (pAction->ActionType != AT_MOVE_ENDSTOP)
+  {
+    block->requested_speed = feed_rate;
+    feed_rate = feed_rate * feed_override / 100;
+  }
+
   float microseconds;
   //if(feedrate<minimumfeedrate)
   //  feedrate=minimumfeedrate;
@@ -496,6 +614,28 @@ void plan_buffer_line (tActionRequest *pAction)
   block->nominal_rate = ceil(block->step_event_count * multiplier);   // steps per minute
 
   
+  // The acceleration along the path is limited by each moving axis: the path acceleration a gives
+  // axis i an acceleration of a*|delta_i|/millimeters, which may not exceed its limit. So X
+  // dominated moves can use the (higher) X limit, and a diagonal is limited by the slower axis.
+  // The same goes for the speed; the feed override uses that limit when it replans the block.
+  // Raster lines have their own X limit.
+  const float axis_accel[NUM_AXES] = {
+    pAction->ActionType == AT_BITMAP ? config.acceleration_raster : config.acceleration_x, config.acceleration_y,
+    config.acceleration_z, config.acceleration_e };
+  const float axis_speed[NUM_AXES] = { (float)config.maximum_feedrate_x, (float)config.maximum_feedrate_y,
+    (float)config.maximum_feedrate_z, (float)config.maximum_feedrate_e };
+  block->acceleration = 0;
+  block->max_nominal_speed = FLT_MAX;
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    if (delta_mm[i] == 0) continue;
+    float u = fabs(delta_mm[i]) * inverse_millimeters;
+    float a = axis_accel[i] / u;
+    if (block->acceleration == 0 || a < block->acceleration)
+      block->acceleration = a;
+    block->max_nominal_speed = min(block->max_nominal_speed, axis_speed[i] / u);
+  }
+
   // Compute the acceleration rate for the trapezoid generator. Depending on the slope of the line
   // average travel per step event changes. For a line along one axis the travel per step event
   // is equal to the travel/step in the particular axis. For a 45 degree line the steppers of both
@@ -504,7 +644,7 @@ void plan_buffer_line (tActionRequest *pAction)
   // specifically for each line to compensate for this phenomenon:
   // Convert universal acceleration for direction-dependent stepper rate change parameter
   block->rate_delta = ceil( block->step_event_count*inverse_millimeters *  
-        config.acceleration*60.0 / ACCELERATION_TICKS_PER_SECOND ); // (step/min/acceleration_tick)
+        block->acceleration*60.0 / ACCELERATION_TICKS_PER_SECOND ); // (step/min/acceleration_tick)
 
   // Perform planner-enabled calculations
   if (acceleration_manager_enabled  ) 
@@ -526,6 +666,7 @@ void plan_buffer_line (tActionRequest *pAction)
     // from path, but used as a robust way to compute cornering speeds, as it takes into account the
     // nonlinearities of both the junction angle and junction velocity.
     float vmax_junction = MINIMUM_PLANNER_SPEED; // Set default max junction speed
+    block->max_junction_speed = MINIMUM_PLANNER_SPEED;
 
     // Skip first block or when previous_nominal_speed is used as a flag for homing and offset cycles.
     if ((block_buffer_head != block_buffer_tail) && (previous_nominal_speed > 0.0)) {
@@ -537,20 +678,22 @@ void plan_buffer_line (tActionRequest *pAction)
                            
       // Skip and use default max junction speed for 0 degree acute junction.
       if (cos_theta < 0.95) {
+        block->max_junction_speed = FLT_MAX;
         vmax_junction = min(previous_nominal_speed,block->nominal_speed);
         // Skip and avoid divide by zero for straight junctions at 180 degrees. Limit to min() of nominal speeds.
         if (cos_theta > -0.95) {
           // Compute maximum junction velocity based on maximum acceleration and junction deviation
           float sin_theta_d2 = sqrt(0.5*(1.0-cos_theta)); // Trig half angle identity. Always positive.
-          vmax_junction = min(vmax_junction,
-            sqrt(config.acceleration*60*60 * config.junction_deviation * sin_theta_d2/(1.0-sin_theta_d2)) );
+          block->max_junction_speed =
+            sqrt(block->acceleration*60*60 * config.junction_deviation * sin_theta_d2/(1.0-sin_theta_d2));
+          vmax_junction = min(vmax_junction, block->max_junction_speed);
         }
       }
     }
     block->max_entry_speed = vmax_junction;
     
     // Initialize block entry speed. Compute based on deceleration to user-defined MINIMUM_PLANNER_SPEED.
-    float v_allowable = max_allowable_speed(-config.acceleration,MINIMUM_PLANNER_SPEED,block->millimeters);
+    float v_allowable = max_allowable_speed(-block->acceleration,MINIMUM_PLANNER_SPEED,block->millimeters);
     block->entry_speed = min(vmax_junction, v_allowable);
 
     // Initialize planner efficiency flags
@@ -592,14 +735,17 @@ void plan_buffer_line (tActionRequest *pAction)
   pAction->ActionType = AT_MOVE;
   
   // Update position
-  memcpy(position, target, sizeof(target)); // position[] = target[]
+  memcpy(position, target, sizeof(position)); // position[] = target[]
 
   // Move buffer head
   block_buffer_head = next_buffer_head;     
+  plan_stats.queued++;
 
   startpoint = pAction->target;
   
   if (acceleration_manager_enabled) { planner_recalculate(); }  
+  plan_stats.cycles += DWT->CYCCNT - start_cycles;
+  plan_stats.blocks++;
   st_wake_up();
 }
 
@@ -623,6 +769,7 @@ void plan_buffer_wait (tActionRequest *pAction)
   block->action_type = pAction->ActionType;
   // every 50ms
   block->millimeters = 10;
+  block->acceleration = 0; // no speed change
   block->nominal_speed = 600;
   block->nominal_rate = 20*60;
   
@@ -639,6 +786,7 @@ void plan_buffer_wait (tActionRequest *pAction)
     
   // Move buffer head
   block_buffer_head = next_buffer_head;     
+  plan_stats.queued++;
 
   if (acceleration_manager_enabled) { planner_recalculate(); }  
   st_wake_up();    
@@ -738,3 +886,16 @@ uint8_t plan_queue_items(void)
   return len;
 }
 
+// Return nr of blocks that can be queued before plan_buffer_line() waits
+uint8_t plan_queue_room(void)
+{
+  return BLOCK_BUFFER_SIZE - 1 - plan_queue_items();
+}
+
+// Return true if the stepper is past the blocks queued before plan_stats.queued
+// was 'queued': the next block has started, or the queue ran empty
+uint8_t plan_blocks_done(uint32_t queued)
+{
+  return (int32_t)(st_stats.started - queued) > 0 || plan_queue_empty();
+}
+
@@ -68,6 +68,10 @@ typedef struct
   float entry_speed;                 // Entry speed at previous-current junction in mm/min
   float max_entry_speed;             // Maximum allowable junction entry speed in mm/min
   float millimeters;                 // The total travel of this block in mm
+  float acceleration;                // Acceleration along the path, from the axis limits in mm/sec2
+  float requested_speed;             // Feed rate before the override in mm/min, 0: no override
+  float max_nominal_speed;           // Highest speed the axis limits allow in mm/min
+  float max_junction_speed;          // Junction speed limit of the corner alone in mm/min
   uint8_t recalculate_flag;           // Planner flag to recalculate trapezoids on entry junction
   uint8_t nominal_length_flag;        // Planner flag for nominal speed always reached
 
@@ -88,21 +92,45 @@ typedef struct
 typedef struct {
   eActionType ActionType;
   tTarget     target;  
+  int32_t     um[3]; // x, y, z target [micron], for plan_buffer_line_um()
   uint16_t    param; // argument for the action
 } tActionRequest;
 
 
 
 extern tTarget startpoint;
+
+// Planner statistics: blocks planned and the (DWT) cycles spent on them
+typedef struct {
+  uint32_t blocks;
+  uint64_t cycles;
+  uint32_t queued; // all blocks queued since plan_init(), not reset per job; see st_stats.started
+} tPlannerStats;
+extern tPlannerStats plan_stats;
       
 // Initialize the motion plan subsystem      
 void plan_init();
-void plan_set_accel(float a);
+
+// The acceleration [mm/sec2] to plan with for a limit of a [mm/sec2]: lower
+// with S-curve ramps, as their peak is SCURVE_PEAK times the average
+#define SCURVE_PEAK 1.5
+float plan_accel(float a);
+
+// Feed rate override [%]. New blocks are planned with it, and the queued blocks
+// the stepper has not started yet are replanned.
+#define OVERRIDE_MIN 10
+#define OVERRIDE_MAX 200
+void plan_set_feed_override(int percent);
+int plan_get_feed_override();
 
 // Add a new linear movement to the buffer. x, y and z is the signed, absolute target position in 
 // millimeters. Feed rate specifies the speed of the motion. (in mm/min) 
 void plan_buffer_line (tActionRequest *pAction);
 
+// The same, to the x, y and z target in pAction->um [micron], converted to steps in fixed
+// point. target.x, y, z must be the same position in mm: it becomes the current position.
+void plan_buffer_line_um (tActionRequest *pAction);
+
 void plan_buffer_action(tActionRequest *pAction);
 
 // Called when the current block is no longer needed. Discards the block and makes the memory
@@ -132,4 +160,11 @@ uint8_t plan_queue_empty(void);
 
 uint8_t plan_queue_items(void) ;
 
+// Nr of blocks that can be queued without waiting
+uint8_t plan_queue_room(void);
+
+// The stepper is past the blocks queued before plan_stats.queued was 'queued'.
+// Both count since boot, so this holds across st_job_start()
+uint8_t plan_blocks_done(uint32_t queued);
+
 #endif
@@ -0,0 +1,94 @@
+/**
+ * profile.cpp
+ * Cycle counter profiling of the stepper interrupt
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "profile.h"
+
+#ifdef ST_PROFILE
+#include <stdio.h>
+#include <string.h>
+
+tProfHist prof_isr;
+tProfHist prof_block;
+volatile uint32_t prof_drops;
+volatile uint32_t prof_late;
+
+// Enable the cycle counter and clear all statistics
+void prof_init()
+{
+#ifdef DWT_CTRL_CYCCNTENA_Msk
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  prof_reset();
+}
+
+// Clear all statistics
+void prof_reset()
+{
+  memset(&prof_isr, 0, sizeof(prof_isr));
+  memset(&prof_block, 0, sizeof(prof_block));
+  prof_isr.min = prof_block.min = 0xffffffff;
+  prof_drops = prof_late = 0;
+}
+
+// Add one measurement (in cycles) to a histogram. Called from the stepper
+// interrupt, so keep it short: no division, one count-leading-zeros.
+void prof_add(tProfHist *h, uint32_t cycles)
+{
+  int b = cycles ? 31 - __builtin_clz(cycles) : 0;
+  if (b >= PROF_BUCKETS) b = PROF_BUCKETS - 1;
+  h->bucket[b]++;
+  h->count++;
+  h->sum += cycles;
+  if (cycles < h->min) h->min = cycles;
+  if (cycles > h->max) h->max = cycles;
+}
+
+// Average of a histogram, in cycles
+uint32_t prof_avg(const tProfHist *h)
+{
+  return h->count ? (uint32_t)(h->sum / h->count) : 0;
+}
+
+// print one histogram
+static void prof_print_hist(const char *name, const tProfHist *h)
+{
+  printf("%s: n=%lu min=%lu avg=%lu max=%lu [cycles]\n\r", name,
+    (unsigned long)h->count, (unsigned long)(h->count ? h->min : 0),
+    (unsigned long)prof_avg(h), (unsigned long)h->max);
+  for (int b = 0; b < PROF_BUCKETS; b++)
+  {
+    if (h->bucket[b])
+      printf("  %6lu%s: %lu\n\r", 1UL << b, (b == PROF_BUCKETS-1 ? "+" : " "),
+        (unsigned long)h->bucket[b]);
+  }
+}
+
+// Print all histograms on the serial port
+void prof_print()
+{
+  prof_print_hist("st_interrupt", &prof_isr);
+  prof_print_hist("block start", &prof_block);
+  printf("dropped ticks: %lu, late: %lu\n\r",
+    (unsigned long)prof_drops, (unsigned long)prof_late);
+}
+
+#endif
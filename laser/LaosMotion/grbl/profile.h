@@ -0,0 +1,93 @@
+/**
+ * profile.h
+ * Cycle counter profiling of the stepper interrupt
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Times st_interrupt() and trapezoid_generator_reset() with the DWT cycle
+ * counter and counts ticks dropped by the busy flag. Durations go into
+ * log2 histograms (bucket k holds 2^k .. 2^(k+1)-1 cycles). The results
+ * are shown on the "ISR PROFILE" menu screen and printed to the serial
+ * port with prof_print().
+ *
+ * Disabled by default: define ST_PROFILE (here or with -D) to build it in.
+ * When disabled, the PROF_ macros compile to nothing.
+ *
+ * PROF_CYCCNT() reads the cycle counter; define it before including this
+ * file to use another time source (e.g. a fake counter on the host).
+ */
+#ifndef profile_h
+#define profile_h
+#include "stdint.h"
+
+// #define ST_PROFILE
+
+#ifdef ST_PROFILE
+
+#define PROF_BUCKETS 16     // last bucket also holds everything longer
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t min, max;
+  uint64_t sum;
+  uint32_t bucket[PROF_BUCKETS];
+} tProfHist;
+
+extern tProfHist prof_isr;          // st_interrupt(), whole handler
+extern tProfHist prof_block;        // trapezoid_generator_reset()
+extern volatile uint32_t prof_drops; // ticks dropped by the busy flag
+extern volatile uint32_t prof_late; // handler took longer than the step period
+
+#ifndef PROF_CYCCNT
+#include "mbed.h"
+#define PROF_CYCCNT() (DWT->CYCCNT)
+#define PROF_CYCLES_PER_US (SystemCoreClock / 1000000)
+#endif
+
+// Enable the cycle counter and clear all statistics
+void prof_init();
+
+// Clear all statistics
+void prof_reset();
+
+// Add one measurement (in cycles) to a histogram
+void prof_add(tProfHist *h, uint32_t cycles);
+
+// Average of a histogram, in cycles
+uint32_t prof_avg(const tProfHist *h);
+
+// Print all histograms on the serial port
+void prof_print();
+
+#define PROF_START(t) uint32_t t = PROF_CYCCNT()
+#define PROF_END(h, t) prof_add(&(h), PROF_CYCCNT() - (t))
+#define PROF_DROP() prof_drops++
+// end of the interrupt handler, period: the step timer period [usec]
+#define PROF_ISR_END(t, period) \
+  do { uint32_t d = PROF_CYCCNT() - (t); prof_add(&prof_isr, d); \
+       if (d > (period) * PROF_CYCLES_PER_US) prof_late++; } while (0)
+
+#else
+
+#define PROF_START(t)
+#define PROF_END(h, t)
+#define PROF_DROP()
+#define PROF_ISR_END(t, period)
+
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+/*
+  ramp.h - trapezoid generator: the step period of each step event of a block
+  Part of Grbl, split from stepper.c for Laos
+
+  Copyright (c) 2009-2011 Simen Svale Skogsrud
+  Modifications Copyright (c) 2011 Sungeun K. Jeon
+  Modifications Copyright (c) 2011 Peter Brier
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The step interrupt (stepper.cpp) calls ramp_reset() when it takes a block and
+   ramp_step() after each step event. The host tests run the same code to
+   simulate the step timing of a job. Everything here is inline: ramp_step()
+   runs in the step interrupt, on a core without an FPU, so it uses integer
+   math only. */
+
+#ifndef ramp_h
+#define ramp_h
+
+#include <math.h>
+#include "fixedpt.h"
+#include "planner.h"
+#include "stepper.h"
+
+#define STEP_TIMER_FREQ 1000000 // 1 MHz
+
+// types: ramp state
+typedef enum {RAMP_UP, RAMP_MAX, RAMP_DOWN} tRamp;
+
+// S-curve ramps (cfg->scurve): the speed follows a smoothstep in time over each
+// ramp instead of growing linearly. The ramp runs from the planned entry to the
+// planned exit speed over the same distance, so the junction speeds chain as
+// before, but the acceleration starts and ends at zero (peak: SCURVE_PEAK) and
+// the ramp takes SCURVE_PEAK times as long as a linear one at the peak
+// acceleration. The speed is kept as w = sqrt(n), in units of sqrt(2*accel);
+// u runs from the low speed end, so the period near standstill is exact.
+typedef struct {
+  uint32_t t;          // time since the start of the ramp [usec]
+  uint32_t len;        // duration of the ramp [usec]
+  int      down;       // a ramp down: u counts back from the end
+  uint32_t w0, dw;     // w at u = 0, change of w up to u = 1, 16.16 fixed point
+  uint32_t inv_len;    // 2^shift / len, 0.32 fixed point: 32 significant bits
+  int      shift;
+} tSRamp;
+
+// State of the trapezoid generator of the current block
+typedef struct {
+  tFixedPt  c;         // current clock cycle count [1/speed]
+  int32_t   c_min;     // minimal clock cycle count [at vnominal for this block]
+  int32_t   n;
+  int32_t   decel_n;
+  tRamp     ramp;      // state of state machine for ramping up/down
+  int       scurve;    // S-curve ramps
+  uint32_t  c0_half;   // S-curve: c0 / 2 [tFixedPt]
+  tSRamp    s_ramp[2]; // S-curve: [0] up, [1] down
+} tRampGen;
+
+// return number of steps to perform:  n = (v^2) / (2*a)
+// alpha is a adjustment factor for ?? (alsways 1! in this source)
+static inline int32_t calc_n (float speed, float alpha, float accel)
+{
+  return speed * speed / (2.0 * alpha * accel);
+}
+
+// 1/sqrt(m) at the middle of [1+i/16, 1+(i+1)/16), 1.15 fixed point
+static const uint16_t rsqrt_tab[48] = {
+  32268, 31332, 30474, 29682, 28949, 28268, 27632, 27038, 26481, 25956, 25462, 24994,
+  24552, 24132, 23733, 23354, 22992, 22646, 22315, 21999, 21695, 21404, 21124, 20855,
+  20596, 20346, 20106, 19873, 19649, 19431, 19221, 19018, 18821, 18630, 18444, 18264,
+  18090, 17920, 17755, 17594, 17438, 17285, 17137, 16992, 16851, 16714, 16579, 16448,
+};
+
+// Clock cycle count of an S-curve ramp, dt [usec] after the previous step event:
+// c = c0 / (2*sqrt(n+1/2)) with n = w^2. n+1/2 is split in m * 4^e with m in [1,4);
+// the table gives 1/sqrt(m) within 1.5% and two Newton steps make that exact to
+// 1e-7, so the error of c is that of n (1/4096 step). All products are 32x32 bit.
+static inline tFixedPt scurve_c (const tRampGen *g, tSRamp *r, uint32_t dt)
+{
+  if (r->t < r->len) r->t += dt;
+  uint32_t k = r->t < r->len ? (r->down ? r->len - r->t : r->t) : (r->down ? 0 : r->len);
+  uint64_t uk = ((uint64_t)k * r->inv_len) >> r->shift;
+  uint32_t u = uk >= 1UL << 30 ? 1UL << 30 : (uint32_t)uk; // 2.30
+  uint32_t u2 = ((uint64_t)u * u) >> 30;
+  uint32_t u3 = ((uint64_t)u2 * u) >> 30;
+  uint32_t s = 3 * u2 - 2 * u3; // smoothstep, 2.30
+  uint32_t w = r->w0 + (uint32_t)(((uint64_t)r->dw * s) >> 30);
+  uint64_t x = (((uint64_t)w * w) >> 20) + 2048; // n+1/2, 20.12
+  if (x > 0x7fffffff) x = 0x7fffffff;
+
+  int e = (31 - __builtin_clz((uint32_t)x) - 12) >> 1; // -1..9
+  int sh = 16 - 2 * e;
+  uint32_t m = sh >= 0 ? (uint32_t)x << sh : (uint32_t)x >> -sh; // 4.28
+  uint32_t y = (uint32_t)rsqrt_tab[(m >> 24) - 16] << 15; // 2.30
+  for (int j = 0; j < 2; j++)
+  {
+    uint32_t t = ((uint64_t)m * (uint32_t)(((uint64_t)y * y) >> 30)) >> 28;
+    y = ((uint64_t)y * ((3UL << 30) - t)) >> 31;
+  }
+  return (tFixedPt)(((uint64_t)g->c0_half * y) >> (30 + e));
+}
+
+// Set up an S-curve ramp from w0 to w1: it takes (v1 - v0) / accel = (w1 - w0) * c0 [usec]
+static inline void scurve_setup (tSRamp *r, float w0, float w1, float c0)
+{
+  r->t = 0;
+  r->down = w1 < w0;
+  float lo = r->down ? w1 : w0, hi = r->down ? w0 : w1;
+  r->w0 = lo * 65536;
+  r->dw = (hi - lo) * 65536;
+  r->len = (hi - lo) * c0;
+  int q = r->len > 1 ? 31 - __builtin_clz(r->len) : 0;
+  r->inv_len = (((uint64_t)1 << (32 + q)) - 1) / (r->len > 1 ? r->len : 1);
+  r->shift = q + 2;
+}
+
+// Initializes the trapezoid generator from a block. Called whenever a new
+// block begins. Calculates the length ofc the block (in events), step rate, slopes and trigger positions (when to accel, decel, etc.)
+static inline void ramp_reset (tRampGen *g, block_t *b, int scurve)
+{
+  tFixedPt  c0;
+#define alpha (1.0)
+
+//  float    alpha = 1.0;
+  float    accel;
+  int32_t   accel_until;
+  int32_t   decel_after;
+
+  accel = b->rate_delta*ACCELERATION_TICKS_PER_SECOND / 60.0;
+
+  c0 = (float)STEP_TIMER_FREQ * sqrt (2.0*alpha/accel);
+  g->n = calc_n (b->initial_rate/60.0, alpha, accel);
+  if (g->n==0)
+  {
+    g->n = 1;
+    g->c = c0*0.676;
+  }
+  else
+  {
+    g->c = c0 * (sqrt(g->n+1.0)-sqrt((float)g->n));
+    g->n++; // c is the period of step n, ramp_step() makes the one of step n+1
+  }
+
+  g->ramp = RAMP_UP;
+
+  accel_until = calc_n (b->nominal_rate/60.0, alpha, accel);
+  g->c_min = c0 * (sqrt(accel_until+1.0)-sqrt((float)accel_until));
+  accel_until = accel_until - g->n;
+
+  g->decel_n = - calc_n (b->nominal_rate/60.0, alpha, accel);
+  decel_after = b->step_event_count + g->decel_n + calc_n (b->final_rate/60.0, alpha, accel);
+
+  if (decel_after < accel_until)
+  {
+    decel_after = (decel_after + accel_until) / 2;
+    g->decel_n  = decel_after - b->step_event_count - calc_n (b->final_rate/60.0, alpha, accel);
+  }
+  b->decelerate_after = decel_after;
+
+  g->c = to_fixed(g->c);
+  g->c_min = to_fixed (g->c_min);
+
+  g->scurve = scurve;
+  if (scurve)
+  {
+    // up to and down from the speed at decel_after, where n is -decel_n
+    float w_entry = b->initial_rate/60.0 / sqrt(2.0*alpha*accel);
+    float w_exit = b->final_rate/60.0 / sqrt(2.0*alpha*accel);
+    float w_top = g->decel_n < 0 ? sqrt((float)-g->decel_n) : 0;
+    g->c0_half = to_fixed((uint32_t)c0) / 2;
+    scurve_setup (&g->s_ramp[0], w_entry, w_top, c0);
+    scurve_setup (&g->s_ramp[1], w_top, w_exit, c0);
+    g->c = scurve_c (g, &g->s_ramp[0], 0);
+  }
+#undef alpha
+}
+
+// Update the acceleration profile after step event i (1..step_event_count-1) of
+// block b: returns 1 if the step period changed to g->c
+static inline int ramp_step (tRampGen *g, const block_t *b, uint32_t i)
+{
+  tFixedPt new_c;
+  int changed = 0;
+
+  switch (g->ramp)
+  {
+    case RAMP_UP:
+    {
+      new_c = g->scurve ? scurve_c(g, &g->s_ramp[0], to_int(g->c)) : g->c - (g->c<<1) / (4*g->n+1);
+      if (i >= b->decelerate_after)
+      {
+        g->ramp = RAMP_DOWN;
+        g->n = g->decel_n;
+      }
+      else if (new_c <= g->c_min)
+      {
+        new_c = g->c_min;
+        g->ramp = RAMP_MAX;
+      }
+
+      g->c = new_c;
+      changed = 1;
+    }
+    break;
+
+    case RAMP_MAX:
+      if (i >= b->decelerate_after)
+      {
+        g->ramp = RAMP_DOWN;
+        g->n = g->decel_n;
+      }
+    break;
+
+    case RAMP_DOWN:
+      new_c = g->scurve ? scurve_c(g, &g->s_ramp[1], to_int(g->c)) : g->c - (g->c<<1) / (4*g->n+1);
+      g->c = new_c;
+      changed = 1;
+    break;
+  }
+
+  g->n++;
+  return changed;
+}
+
+#endif
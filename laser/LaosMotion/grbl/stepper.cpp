@@ -40,13 +40,11 @@
 #include "stepper.h"
 #include "config.h"
 #include "planner.h"
+#include "profile.h"
+#include "ramp.h"
 
 #define TICKS_PER_MICROSECOND (1) // Ticker uses 1usec units
 // #define CYCLES_PER_ACCELERATION_TICK ((TICKS_PER_MICROSECOND*1000000)/ACCELERATION_TICKS_PER_SECOND)
-#define STEP_TIMER_FREQ 1000000 // 1 MHz
-
-// types: ramp state
-typedef enum {RAMP_UP, RAMP_MAX, RAMP_DOWN} tRamp;
 
 // Prototypes
 static void st_interrupt ();
@@ -56,6 +54,7 @@ static void st_go_idle();
 // Globals
 volatile unsigned char busy = 0;
 volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e; // actual position
+volatile tStepperStats st_stats; // queue statistics of the current job
 
 // Locals
 static block_t *current_block;  // A pointer to the block currently being traced
@@ -63,12 +62,19 @@ static Ticker timer; // the periodic timer used to step
 static Timeout exhaust_timer; // air assist/exhaust turn off delay
 static tFixedPt pwmofs; // the offset of the PWM value
 static tFixedPt pwmscale; // the scaling of the PWM value
+static volatile int power_override = 100; // [%]
+static volatile int pwm_dirty = 1; // the block or the power override changed: update the PWM
 static volatile int running = 0;  // stepper irq is running
 static uint32_t s_CurrentTimerPeriod = 2000;
+static volatile int job_active = 0; // a job is being fed: an empty queue is an underrun
+static uint32_t step_mask = 0xffffffff; // step bits that are output (none in a dry run)
+static int laser_dry = 0;       // LASEROFF in a dry run: or-ed into the laser output
 
 static uint32_t direction_inv;    // invert mask for direction bits
 static uint32_t direction_bits;   // all axes direction (different ports)
 static uint32_t step_bits;        // all axis step bits
+static uint32_t endstop_bits;     // homing block: step bits of the axes that reached their switch
+static uint32_t endstop_mask;     // homing block: step bits of the axes that move
 static uint32_t step_inv;      // invert mask for the stepper bits
 static int32_t counter_x,       // Counter variables for the bresenham line tracer
                counter_y,
@@ -82,11 +88,7 @@ static uint32_t trapezoid_tick_cycle_counter; // The cycles since last trapezoid
                                               // pace without allocating a separate timer
 static uint32_t trapezoid_adjusted_rate;      // The current rate of step_events according to the trapezoid generator
 
-static tFixedPt  c;          // current clock cycle count [1/speed]
-static int32_t   c_min;      // minimal clock cycle count [at vnominal for this block]
-static int32_t   n;
-static int32_t   decel_n;
-static tRamp     ramp;        // state of state machine for ramping up/down
+static tRampGen  ramp_gen;   // the trapezoid generator of the current block (ramp.h)
 
 extern unsigned char bitmap_bpp;
 extern unsigned long bitmap[], bitmap_width, bitmap_size;
@@ -126,6 +128,12 @@ void st_init(void)
    (cfg->zinv ? (1<<Z_STEP_BIT) : 0) |
    (cfg->einv ? (1<<E_STEP_BIT) : 0);
 
+  if (cfg->dryrun)
+  {
+    step_mask = 0;
+    laser_dry = LASEROFF;
+  }
+
   printf("Direction: %lu\n", direction_inv);
   pwmofs = to_fixed(cfg->pwmmin) / 100; // offset (0 .. 1.0)
   if ( cfg->pwmmin == cfg->pwmmax )
@@ -134,6 +142,9 @@ void st_init(void)
     pwmscale = div_f(to_fixed(cfg->pwmmax - cfg->pwmmin), to_fixed(100) );
   printf("ofs: %lu, scale: %lu\n", pwmofs, pwmscale);
   actpos_x = actpos_y = actpos_z = actpos_e = 0;
+#ifdef ST_PROFILE
+  prof_init();
+#endif
   st_wake_up();
   trapezoid_tick_cycle_counter = 0;
   st_go_idle();  // Start in the idle state
@@ -171,20 +182,23 @@ static inline void  clear_all_step_pins (void)
 }
 
 
-// check home sensor
+// check home sensor (active when the input differs from the polarity setting)
 int hit_home_stop_x(int axis)
 {
-  return 1;
+  extern GlobalConfig *cfg;
+  return !(xhome ^ cfg->xpol);
 }
 // check home sensor
 int hit_home_stop_y(int axis)
 {
-  return 1;
+  extern GlobalConfig *cfg;
+  return !(yhome ^ cfg->ypol);
 }
-// check home sensor
+// check home sensor: z stops on either end switch
 int hit_home_stop_z(int axis)
 {
-  return 1;
+  extern GlobalConfig *cfg;
+  return !(zmin ^ cfg->zpol) || !(zmax ^ cfg->zpol);
 }
 
 // Start stepper again from idle state, starts the step timer at a default rate
@@ -196,7 +210,7 @@ void st_wake_up()
     running = 1;
     s_CurrentTimerPeriod = 0; // force an update in set_step_timer
     set_step_timer(2000);
-    laser_enable = cfg->lenable;
+    laser_enable = cfg->dryrun ? !cfg->lenable : cfg->lenable;
     exhaust = 1; // turn air assist/exhaust on
     exhaust_timer.detach(); // cancel any pending timer
   //  printf("wake_up()..\n");
@@ -219,58 +233,12 @@ static void st_go_idle()
 //  printf("idle()..\n");
 }
 
-// return number of steps to perform:  n = (v^2) / (2*a)
-// alpha is a adjustment factor for ?? (alsways 1! in this source)
-static inline int32_t calc_n (float speed, float alpha, float accel)
-{
-  return speed * speed / (2.0 * alpha * accel);
-}
-
 // Initializes the trapezoid generator from the current block. Called whenever a new
-// block begins. Calculates the length ofc the block (in events), step rate, slopes and trigger positions (when to accel, decel, etc.)
+// block begins.
 static inline void trapezoid_generator_reset()
 {
-  tFixedPt  c0;
-#define alpha (1.0)
-
-//  float    alpha = 1.0;
-  float    accel;
-  int32_t   accel_until;
-  int32_t   decel_after;
-
-  accel = current_block->rate_delta*ACCELERATION_TICKS_PER_SECOND / 60.0;
-
-  c0 = (float)STEP_TIMER_FREQ * sqrt (2.0*alpha/accel);
-  n = calc_n (current_block->initial_rate/60.0, alpha, accel);
-  if (n==0)
-  {
-    n = 1;
-    c = c0*0.676;
-  }
-  else
-  {
-    c = c0 * (sqrt(n+1.0)-sqrt((float)n));
-  }
-
-  ramp = RAMP_UP;
-
-  accel_until = calc_n (current_block->nominal_rate/60.0, alpha, accel);
-  c_min = c0 * (sqrt(accel_until+1.0)-sqrt((float)accel_until));
-  accel_until = accel_until - n;
-
-  decel_n = - calc_n (current_block->nominal_rate/60.0, alpha, accel);
-  decel_after = current_block->step_event_count + decel_n + calc_n (current_block->final_rate/60.0, alpha, accel);
-
-  if (decel_after < accel_until)
-  {
-    decel_after = (decel_after + accel_until) / 2;
-    decel_n  = decel_after - current_block->step_event_count - calc_n (current_block->final_rate/60.0, alpha, accel);
-  }
-  current_block->decelerate_after = decel_after;
-
-  c = to_fixed(c);
-  c_min = to_fixed (c_min);
-#undef alpha
+  extern GlobalConfig *cfg;
+  ramp_reset (&ramp_gen, current_block, cfg->scurve);
 }
 
 
@@ -283,20 +251,26 @@ static inline void trapezoid_generator_reset()
 // Set the step timer. Note: this starts the ticker at an interval of "cycles"
 static inline void set_step_timer (uint32_t cycles)
 {
-   extern GlobalConfig *cfg;
-   volatile static double p;
    if(s_CurrentTimerPeriod != cycles)
    {
      s_CurrentTimerPeriod = cycles;
      timer.attach_us(&st_interrupt,cycles);
+   }
+}
+
+// Set the PWM from the power of the current block and the power override. Not
+// tied to the step period: the power is constant over a block.
+static inline void set_pwm ()
+{
+   extern GlobalConfig *cfg;
+   volatile static double p;
    // p = to_double(pwmofs + mul_f( pwmscale, ((power>>6) * c_min) / ((10000>>6)*cycles) ) );
    // p = ( to_double(c_min) * current_block->power) / ( 10000.0 * (double)cycles);
   // p = (60E6/nominal_rate) / cycles; // nom_rate is steps/minute,
-   //printf("%f,%f,%f\n\r", (float)(60E6/nominal_rate), (float)cycles, (float)p);
-  // printf("%d: %f %f\n\r", (int)current_block->power, (float)p, (float)c_min/(float(c) ));
-     p = (double)(cfg->pwmmin/100.0 + ((current_block->power/10000.0)*((cfg->pwmmax - cfg->pwmmin)/100.0)));
-     pwm = p;
-   }
+   int power = current_block->power * power_override / 100;
+   if (power > 10000) power = 10000;
+   p = (double)(cfg->pwmmin/100.0 + ((power/10000.0)*((cfg->pwmmax - cfg->pwmmin)/100.0)));
+   pwm = p;
 }
 
 // "The Stepper Driver Interrupt" - This timer interrupt is the workhorse of Grbl. It is  executed at the rate set with
@@ -308,8 +282,9 @@ static  void st_interrupt (void)
   extern GlobalConfig *cfg;
   // TODO: Check if the busy-flag can be eliminated by just disabeling this interrupt while we are in it
 
-  if(busy){ /*printf("busy!\n"); */ return; } // The busy-flag is used to avoid reentering this interrupt
+  if(busy){ PROF_DROP(); return; } // The busy-flag is used to avoid reentering this interrupt
   busy = 1;
+  PROF_START(t_isr);
 
   // Set the direction pins a cuple of nanoseconds before we step the steppers
   //STEPPING_PORT = (STEPPING_PORT & ~DIRECTION_MASK) | (out_bits & DIRECTION_MASK);
@@ -318,7 +293,7 @@ static  void st_interrupt (void)
   // Then pulse the stepping pins
   //STEPPING_PORT = (STEPPING_PORT & ~STEP_MASK) | out_bits;
   // led2 = 1;
-  set_step_pins (step_bits ^ step_inv);
+  set_step_pins ((step_bits & step_mask) ^ step_inv);
 
   // If there is no current block, attempt to pop one from the buffer
   if (current_block == NULL)
@@ -326,7 +301,18 @@ static  void st_interrupt (void)
     // Anything in the buffer?
     current_block = plan_get_current_block();
     if (current_block != NULL) {
+      st_stats.started++;
+      if (job_active)
+      {
+        uint32_t depth = plan_queue_items(); // including this block
+        st_stats.blocks++;
+        st_stats.depth_sum += depth;
+        if (depth < st_stats.depth_min) st_stats.depth_min = depth;
+      }
+      PROF_START(t_block);
       trapezoid_generator_reset();
+      PROF_END(prof_block, t_block);
+      pwm_dirty = 1;
       counter_x = -(current_block->step_event_count >> 1);
       counter_y = counter_x;
       counter_z = counter_x;
@@ -337,9 +323,15 @@ static  void st_interrupt (void)
       direction_bits = current_block->direction_bits ^ direction_inv;
       set_direction_pins ();
       step_bits = 0;
+      endstop_bits = 0;
+      endstop_mask =
+        (current_block->steps_x ? (1<<X_STEP_BIT) : 0) |
+        (current_block->steps_y ? (1<<Y_STEP_BIT) : 0) |
+        (current_block->steps_z ? (1<<Z_STEP_BIT) : 0);
     }
     else
     {
+      if (job_active) st_stats.underruns++;
       st_go_idle();
     }
   }
@@ -347,11 +339,16 @@ static  void st_interrupt (void)
   // process the current block
   if (current_block != NULL)
   {
+   if (pwm_dirty)
+   {
+     pwm_dirty = 0;
+     set_pwm();
+   }
 
    // this block is a bitmap engraving line, read laser on/off status from buffer
    if ( current_block->options & OPT_BITMAP )
    {
-      *laser =  ! (bitmap[pos_l / 32] & (1 << (pos_l % 32)));
+      *laser =  (! (bitmap[pos_l / 32] & (1 << (pos_l % 32)))) | laser_dry;
       counter_l += bitmap_width;
      //  printf("%d %d %d: %d %d %c\n\r", bitmap_width, pos_l, counter_l,  pos_l / 32, pos_l % 32, (*laser ?  '1' : '0' ));
       if (counter_l > 0)
@@ -363,29 +360,46 @@ static  void st_interrupt (void)
    }
    else
    {
-     *laser = ( current_block->options & OPT_LASER_ON ? LASERON : LASEROFF);
+     *laser = ( current_block->options & OPT_LASER_ON ? LASERON : LASEROFF) | laser_dry;
    }
 
     if (current_block->action_type == AT_MOVE)
     {
+      // This is a homing block: an axis stops as soon as its end-stop is triggered
+      if (current_block->check_endstops)
+      {
+        if ( (endstop_mask & (1<<X_STEP_BIT)) && hit_home_stop_x (direction_bits & (1<<X_DIRECTION_BIT)) )
+          endstop_bits |= (1<<X_STEP_BIT);
+        if ( (endstop_mask & (1<<Y_STEP_BIT)) && hit_home_stop_y (direction_bits & (1<<Y_DIRECTION_BIT)) )
+          endstop_bits |= (1<<Y_STEP_BIT);
+        if ( (endstop_mask & (1<<Z_STEP_BIT)) && hit_home_stop_z (direction_bits & (1<<Z_DIRECTION_BIT)) )
+          endstop_bits |= (1<<Z_STEP_BIT);
+      }
+
       // Execute step displacement profile by bresenham line algorithm
       step_bits = 0;
       counter_x += current_block->steps_x;
       if (counter_x > 0) {
-        actpos_x +=  ( (current_block->direction_bits & (1<<X_DIRECTION_BIT))? -1 : 1 );
-        step_bits |= (1<<X_STEP_BIT);
+        if ( !(endstop_bits & (1<<X_STEP_BIT)) ) {
+          actpos_x +=  ( (current_block->direction_bits & (1<<X_DIRECTION_BIT))? -1 : 1 );
+          step_bits |= (1<<X_STEP_BIT);
+        }
         counter_x -= current_block->step_event_count;
       }
       counter_y += current_block->steps_y;
       if (counter_y > 0) {
-        actpos_y +=  ( (current_block->direction_bits & (1<<Y_DIRECTION_BIT))? -1 : 1 );
-        step_bits |= (1<<Y_STEP_BIT);
+        if ( !(endstop_bits & (1<<Y_STEP_BIT)) ) {
+          actpos_y +=  ( (current_block->direction_bits & (1<<Y_DIRECTION_BIT))? -1 : 1 );
+          step_bits |= (1<<Y_STEP_BIT);
+        }
         counter_y -= current_block->step_event_count;
       }
       counter_z += current_block->steps_z;
       if (counter_z > 0) {
-        actpos_z +=  ( (current_block->direction_bits & (1<<Z_DIRECTION_BIT))? -1 : 1 );
+        if ( !(endstop_bits & (1<<Z_STEP_BIT)) ) {
+          actpos_z +=  ( (current_block->direction_bits & (1<<Z_DIRECTION_BIT))? -1 : 1 );
           step_bits |= (1<<Z_STEP_BIT);
+        }
         counter_z -= current_block->step_event_count;
       }
 
@@ -402,63 +416,21 @@ static  void st_interrupt (void)
       step_events_completed++; // Iterate step events
 
       // This is a homing block, keep moving until all end-stops are triggered
-      if (current_block->check_endstops)
+      if (current_block->check_endstops && endstop_bits == endstop_mask)
       {
-        if ( (current_block->steps_x && hit_home_stop_x (direction_bits & (1<<X_DIRECTION_BIT)) ) ||
-             (current_block->steps_y && hit_home_stop_y (direction_bits & (1<<Y_DIRECTION_BIT)) ) ||
-             (current_block->steps_z && hit_home_stop_z (direction_bits & (1<<Z_DIRECTION_BIT)) )
-           )
-        {
-          step_events_completed = current_block->step_event_count;
-          step_bits = 0;
-        }
+        step_events_completed = current_block->step_event_count;
+        step_bits = 0;
       }
 
 
       // While in block steps, update acceleration profile
       if (step_events_completed < current_block->step_event_count)
       {
-        tFixedPt new_c;
-
-        switch (ramp)
-        {
-          case RAMP_UP:
-          {
-            new_c = c - (c<<1) / (4*n+1);
-            if (step_events_completed >= current_block->decelerate_after)
-            {
-              ramp = RAMP_DOWN;
-              n = decel_n;
-            }
-            else if (new_c <= c_min)
-            {
-              new_c = c_min;
-              ramp = RAMP_MAX;
-            }
-
-            set_step_timer (to_int(new_c));
-            c = new_c;
-          }
-          break;
-
-          case RAMP_MAX:
-            if (step_events_completed >= current_block->decelerate_after)
-            {
-              ramp = RAMP_DOWN;
-              n = decel_n;
-            }
-          break;
-
-          case RAMP_DOWN:
-            new_c = c - (c<<1) / (4*n+1);
-            set_step_timer (to_int(new_c));
-            c = new_c;
-          break;
-        }
-
-        n++;
+        if (ramp_step (&ramp_gen, current_block, step_events_completed))
+          set_step_timer (to_int(ramp_gen.c));
       } else {
         // If current block is finished, reset pointer
+        if (job_active) st_stats.steps += current_block->step_event_count;
         current_block = NULL;
         plan_discard_current_block();
       }
@@ -472,11 +444,41 @@ static  void st_interrupt (void)
   }
 
   clear_all_step_pins (); // clear the pins, assume that we spend enough CPU cycles in the previous statements for the steppers to react (>1usec)
+  PROF_ISR_END(t_isr, s_CurrentTimerPeriod);
   busy=0;
 
 }
 
 
+// Start collecting queue statistics for a job
+void st_job_start()
+{
+  job_active = 0;
+  st_stats.underruns = 0;
+  st_stats.blocks = 0;
+  st_stats.steps = 0;
+  st_stats.depth_sum = 0;
+  st_stats.depth_min = 0xffffffff;
+  job_active = 1;
+}
+
+// The last block of the job is queued: the queue may run empty now
+void st_job_end()
+{
+  job_active = 0;
+}
+
+void st_set_power_override(int percent)
+{
+  power_override = max(OVERRIDE_MIN, min(OVERRIDE_MAX, percent));
+  pwm_dirty = 1; // applied by the next step interrupt, also in the middle of a block
+}
+
+int st_get_power_override()
+{
+  return power_override;
+}
+
 // Block until all buffered steps are executed
 void st_synchronize()
 {
@@ -503,7 +505,7 @@ void st_debug_block(const block_t *block)
 void st_debug()
 {
   printf("running: %d, step_events_completed: %lu, c: %f, c_min: %f, n: %ld, decel_n: %ld, ramp: %d\n",
-    running, step_events_completed, to_double(c), to_double(c_min), n, decel_n, (int)ramp);
+    running, step_events_completed, to_double(ramp_gen.c), to_double(ramp_gen.c_min), ramp_gen.n, ramp_gen.decel_n, (int)ramp_gen.ramp);
   const block_t *blk=current_block;
   if(blk)
   {
@@ -24,6 +24,17 @@
 // Globals: The actual position
 extern volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e;
 
+// Queue statistics, collected between st_job_start() and st_job_end()
+typedef struct {
+  uint32_t underruns;   // times the queue ran empty (the machine stopped mid-job)
+  uint32_t blocks;      // blocks started
+  uint32_t steps;       // step events of the completed blocks
+  uint32_t depth_sum;   // sum of the queue depth at each block start
+  uint32_t depth_min;   // minimum queue depth at a block start
+  uint32_t started;     // all blocks started since boot, not reset by st_job_start()
+} tStepperStats;
+extern volatile tStepperStats st_stats;
+
 // from nuts_bolts.h:
 #define square(x) ((x)*(x))
 #define sleep_mode(x) do {} while (0)
@@ -106,11 +117,27 @@ void st_synchronize();
 
 // Execute the homing cycle
 void st_go_home();
+
+// Home switch state (1: triggered), the argument is ignored
+int hit_home_stop_x(int axis);
+int hit_home_stop_y(int axis);
+int hit_home_stop_z(int axis);
              
 // The stepper subsystem goes to sleep when it runs out of things to execute. Call this
 // to notify the subsystem that it is time to go to work.
 void st_wake_up();
 
+// Start collecting queue statistics for a job
+void st_job_start();
+
+// The last block of the job is queued: stop counting underruns
+void st_job_end();
+
+// Laser power override [%, OVERRIDE_MIN..OVERRIDE_MAX], applied to the block power as it is
+// output, so it also changes the blocks that are already planned
+void st_set_power_override(int percent);
+int st_get_power_override();
+
 // leave exhaust running after job completes.
 void exhaust_off();
 
@@ -0,0 +1,476 @@
+/**
+ * LaosOptimize.cpp
+ * Reorder the paths of a job to shorten the travel moves
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <math.h>
+#include <stdlib.h>
+#include "LaosOptimize.h"
+
+LaosOptimize::LaosOptimize()
+{
+  m_Count = 0;
+  m_Before = m_After = 0;
+}
+
+void LaosOptimize::Start(FILE *in, FILE *copy, FILE *out)
+{
+  m_In = in;
+  m_Copy = copy;
+  m_Out = out;
+  m_Offset = 0;
+  m_Count = 0;
+  m_Open = m_Move = m_Bitmap = false;
+  m_PosX = m_PosY = m_OutX = m_OutY = 0;
+  m_Before = m_After = 0;
+}
+
+bool LaosOptimize::Step(int n)
+{
+  int cmd;
+  while ( n-- > 0 )
+  {
+    if ( Failed() || !Token(cmd) || !Command(cmd) )
+      return false;
+  }
+  return true;
+}
+
+bool LaosOptimize::Finish()
+{
+  m_Open = false;
+  Flush();
+  if ( m_Move )
+    Restore();
+  return !Failed() && m_After < m_Before;
+}
+
+bool LaosOptimize::Run(FILE *in, FILE *copy, FILE *out)
+{
+  Start(in, copy, out);
+  while ( Step(LAOSOPTIMIZE_STEP) )
+    ;
+  return Finish();
+}
+
+bool LaosOptimize::Failed() const
+{
+  return ferror(m_In) || ferror(m_Copy) || ferror(m_Out);
+}
+
+// One command of the original job: a path is collected, a barrier is copied;
+// false at the end of the file
+bool LaosOptimize::Command(int cmd)
+{
+  int a[6];
+  long start = m_TokenStart;
+  bool mark = (cmd == 1 || cmd == 10 || cmd == 11 || cmd == 13 || cmd == 14);
+  if ( mark && !m_Bitmap )
+  {
+    // extend the open path, or start a new one here
+    if ( !m_Open )
+    {
+      if ( m_Count == LAOSOPTIMIZE_PATHS )
+        Flush();
+      TPath &p = m_Path[m_Count++];
+      p.start = start;
+      p.sx = p.minx = p.maxx = m_PosX;
+      p.sy = p.miny = p.maxy = m_PosY;
+      End(p, m_PosX, m_PosY);
+      m_Open = true;
+      m_Move = false;
+    }
+    TPath &p = m_Path[m_Count-1];
+    switch ( cmd )
+    {
+      case 1:
+        if ( Args(2, a) )
+          End(p, a[0], a[1]);
+        break;
+      case 10: // arc: the whole circle as bounds
+      case 11:
+        if ( Args(4, a) )
+        {
+          int r = (int)ceil(sqrt((double)(p.ex-a[2])*(p.ex-a[2]) + (double)(p.ey-a[3])*(p.ey-a[3])));
+          Bound(p, a[2]-r, a[3]-r);
+          Bound(p, a[2]+r, a[3]+r);
+          End(p, a[0], a[1]);
+        }
+        break;
+      case 13: // Bezier: within its control points
+        if ( Args(6, a) )
+        {
+          Bound(p, a[0], a[1]);
+          Bound(p, a[2], a[3]);
+          End(p, a[4], a[5]);
+        }
+        break;
+      case 14: // polyline
+        if ( Token(a[0]) )
+        {
+          for ( int n = a[0]; n > 0 && Args(2, a+1); n-- )
+            End(p, p.ex + a[1], p.ey + a[2]);
+        }
+        break;
+    }
+    p.end = m_TokenEnd;
+    p.closed = (abs(p.ex - p.sx) <= LAOSOPTIMIZE_CLOSED) && (abs(p.ey - p.sy) <= LAOSOPTIMIZE_CLOSED);
+    m_PosX = p.ex;
+    m_PosY = p.ey;
+    return true;
+  }
+  if ( cmd == 0 && !m_Bitmap )
+  {
+    if ( !Args(2, a) )
+      return false;
+    m_Before += sqrt((double)(a[0]-m_PosX)*(a[0]-m_PosX) + (double)(a[1]-m_PosY)*(a[1]-m_PosY));
+    m_Open = false;
+    m_Move = true;
+    m_PosX = a[0];
+    m_PosY = a[1];
+    return true;
+  }
+
+  // barrier: copy the command as it is, in its place
+  m_Open = false;
+  Flush();
+  bool position = true; // the command depends on the position
+  int x = m_PosX, y = m_PosY;
+  switch ( cmd )
+  {
+    case 0: // a move or line before a bitmap line
+    case 1:
+      if ( Args(2, a) )
+      {
+        if ( cmd == 0 )
+          m_Before += sqrt((double)(a[0]-x)*(a[0]-x) + (double)(a[1]-y)*(a[1]-y));
+        x = a[0];
+        y = a[1];
+      }
+      break;
+    case 2: // z
+    case 5: // nop
+      position = false;
+      Token(a[0]);
+      break;
+    case 4: // set position
+      if ( Args(3, a) )
+      {
+        x = a[0];
+        y = a[1];
+      }
+      break;
+    case 7: // speed, power
+      position = false;
+      Args(2, a);
+      break;
+    case 9: // bitmap: 9 <bpp> <width> <data-0> ... <data-n>
+      if ( Args(2, a) )
+      {
+        int n = (a[0] * a[1] + 31) / 32;
+        while ( n-- > 0 && Token(a[2]) )
+          ;
+        m_Bitmap = true;
+      }
+      break;
+    case 10: // curves before a bitmap line
+    case 11:
+      if ( Args(4, a) )
+      {
+        x = a[0];
+        y = a[1];
+      }
+      break;
+    case 13:
+      if ( Args(6, a) )
+      {
+        x = a[4];
+        y = a[5];
+      }
+      break;
+    case 14:
+      if ( Token(a[0]) )
+      {
+        for ( int n = a[0]; n > 0 && Args(2, a+1); n-- )
+        {
+          x += a[1];
+          y += a[2];
+        }
+      }
+      break;
+  }
+  if ( position )
+    Restore();
+  Copy(start, m_TokenEnd);
+  fputs("\n", m_Out);
+  if ( position )
+  {
+    if ( cmd == 0 )
+      m_After += sqrt((double)(x-m_OutX)*(x-m_OutX) + (double)(y-m_OutY)*(y-m_OutY));
+    m_PosX = m_OutX = x;
+    m_PosY = m_OutY = y;
+  }
+  if ( cmd == 1 )
+    m_Bitmap = false; // the bitmap line
+  return true;
+}
+
+// Next value, with the same rules as readint(): a value ends at white
+// space, a '-' anywhere makes it negative, a comment does not end it
+bool LaosOptimize::Token(int &v)
+{
+  int c, value = 0, sign = 1;
+  bool digits = false, started = false, comment = false;
+  while ( (c = getc(m_In)) != EOF )
+  {
+    m_Offset++;
+    if ( comment )
+    {
+      if ( c == '\n' ) comment = false;
+      continue;
+    }
+    switch ( c )
+    {
+      case '0': case '1': case '2': case '3': case '4':
+      case '5': case '6': case '7': case '8': case '9':
+        value = value * 10 + (c - '0');
+        digits = true;
+        break;
+      case '-':
+        sign = -1;
+        break;
+      case ';':
+        comment = true;
+        continue;
+      case ' ': case '\t': case '\r': case '\n':
+        if ( digits )
+        {
+          v = value * sign;
+          m_TokenEnd = m_Offset - 1;
+          return true;
+        }
+        continue;
+      default:
+        continue;
+    }
+    if ( !started )
+    {
+      m_TokenStart = m_Offset - 1;
+      started = true;
+    }
+  }
+  return false;
+}
+
+// Read n values into a; false at the end of the file
+bool LaosOptimize::Args(int n, int *a)
+{
+  for ( int i = 0; i < n; i++ )
+  {
+    if ( !Token(a[i]) )
+      return false;
+  }
+  return true;
+}
+
+void LaosOptimize::Bound(TPath &p, int x, int y)
+{
+  if ( x < p.minx ) p.minx = x;
+  if ( x > p.maxx ) p.maxx = x;
+  if ( y < p.miny ) p.miny = y;
+  if ( y > p.maxy ) p.maxy = y;
+}
+
+void LaosOptimize::End(TPath &p, int x, int y)
+{
+  p.ex = x;
+  p.ey = y;
+  Bound(p, x, y);
+}
+
+// Copy bytes [start, end) of the file to the output
+void LaosOptimize::Copy(long start, long end)
+{
+  char buf[64];
+  fseek(m_Copy, start, SEEK_SET);
+  while ( start < end )
+  {
+    long n = end - start;
+    if ( n > (long)sizeof(buf) ) n = sizeof(buf);
+    n = fread(buf, 1, n, m_Copy);
+    if ( n <= 0 )
+      break;
+    fwrite(buf, 1, n, m_Out);
+    start += n;
+  }
+}
+
+// Write a move, if the output is not there yet
+void LaosOptimize::Move(int x, int y)
+{
+  if ( x == m_OutX && y == m_OutY )
+    return;
+  fprintf(m_Out, "0 %d %d\n", x, y);
+  m_After += sqrt((double)(x-m_OutX)*(x-m_OutX) + (double)(y-m_OutY)*(y-m_OutY));
+  m_OutX = x;
+  m_OutY = y;
+}
+
+// Go to where the original job is, before a command that depends on it
+void LaosOptimize::Restore()
+{
+  Move(m_PosX, m_PosY);
+  m_Move = false;
+}
+
+// Reorder the collected paths and write them
+void LaosOptimize::Flush()
+{
+  if ( m_Count == 0 )
+    return;
+  float before = 0, x = m_OutX, y = m_OutY;
+  for ( int i = 0; i < m_Count; i++ )
+  {
+    before += Travel(x, y, m_Path[i]);
+    x = m_Path[i].ex;
+    y = m_Path[i].ey;
+  }
+  Order();
+  float after = Travel(m_OutX, m_OutY, m_Path[m_Order[0]]);
+  for ( int i = 1; i < m_Count; i++ )
+    after += Travel(m_Path[m_Order[i-1]], m_Path[m_Order[i]]);
+  for ( int i = 0; i < m_Count; i++ )
+  {
+    const TPath &p = m_Path[after < before ? m_Order[i] : i];
+    Move(p.sx, p.sy);
+    Copy(p.start, p.end);
+    fputs("\n", m_Out);
+    m_OutX = p.ex;
+    m_OutY = p.ey;
+  }
+  m_Count = 0;
+}
+
+// a is a closed path inside closed path b: mark a first
+bool LaosOptimize::Inside(const TPath &a, const TPath &b) const
+{
+  return a.closed && b.closed && (&a != &b) &&
+    (a.minx >= b.minx) && (a.maxx <= b.maxx) && (a.miny >= b.miny) && (a.maxy <= b.maxy) &&
+    ((a.minx != b.minx) || (a.maxx != b.maxx) || (a.miny != b.miny) || (a.maxy != b.maxy));
+}
+
+// Path i can be marked: the closed paths inside it are done
+bool LaosOptimize::Allowed(int i) const
+{
+  for ( int j = 0; j < m_Count; j++ )
+  {
+    if ( !m_Done[j] && Inside(m_Path[j], m_Path[i]) )
+      return false;
+  }
+  return true;
+}
+
+float LaosOptimize::Travel(int x, int y, const TPath &p) const
+{
+  float dx = p.sx - x, dy = p.sy - y;
+  return sqrt(dx*dx + dy*dy);
+}
+
+// Nearest neighbour from the current position, then 2-opt: reverse the
+// order of paths i..j if that shortens the travel, and does not put a
+// path before a closed path inside it
+void LaosOptimize::Order()
+{
+  int x = m_OutX, y = m_OutY;
+  for ( int i = 0; i < m_Count; i++ )
+    m_Done[i] = false;
+  for ( int k = 0; k < m_Count; k++ )
+  {
+    int best = -1;
+    float dist = 0;
+    for ( int i = 0; i < m_Count; i++ )
+    {
+      if ( m_Done[i] || !Allowed(i) )
+        continue;
+      float d = Travel(x, y, m_Path[i]);
+      if ( best < 0 || d < dist )
+      {
+        best = i;
+        dist = d;
+      }
+    }
+    m_Order[k] = best;
+    m_Done[best] = true;
+    x = m_Path[best].ex;
+    y = m_Path[best].ey;
+  }
+
+  for ( int pass = 0; pass < LAOSOPTIMIZE_PASSES; pass++ )
+  {
+    bool improved = false;
+    for ( int i = 0; i < m_Count - 1; i++ )
+    {
+      const TPath &first = m_Path[m_Order[i]];
+      float fwd = 0, rev = 0; // travel within i..j, in order and reversed
+      for ( int j = i + 1; j < m_Count; j++ )
+      {
+        const TPath &last = m_Path[m_Order[j]];
+        const TPath &prev = m_Path[m_Order[j-1]];
+        bool conflict = false;
+        for ( int k = i; k < j && !conflict; k++ )
+          conflict = Inside(m_Path[m_Order[k]], last);
+        if ( conflict )
+          break; // also for any larger j
+        fwd += Travel(prev, last);
+        rev += Travel(last, prev);
+        float in_old, in_new;
+        if ( i == 0 )
+        {
+          in_old = Travel(m_OutX, m_OutY, first);
+          in_new = Travel(m_OutX, m_OutY, last);
+        }
+        else
+        {
+          const TPath &before = m_Path[m_Order[i-1]];
+          in_old = Travel(before, first);
+          in_new = Travel(before, last);
+        }
+        float out_old = 0, out_new = 0;
+        if ( j + 1 < m_Count )
+        {
+          const TPath &after = m_Path[m_Order[j+1]];
+          out_old = Travel(last, after);
+          out_new = Travel(first, after);
+        }
+        if ( in_new + rev + out_new < in_old + fwd + out_old - 1 )
+        {
+          for ( int a = i, b = j; a < b; a++, b-- )
+          {
+            unsigned char t = m_Order[a];
+            m_Order[a] = m_Order[b];
+            m_Order[b] = t;
+          }
+          improved = true;
+          break; // the sums no longer match the order
+        }
+      }
+    }
+    if ( !improved )
+      break;
+  }
+}
@@ -0,0 +1,119 @@
+/**
+ * LaosOptimize.h
+ * Reorder the paths of a job to shorten the travel moves
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Splits a simplecode file into paths: a move, followed by the lines,
+ * arcs, Bezier curves and polylines that are marked from there. Between
+ * ordering barriers, the paths are put in a new order: nearest neighbour
+ * first, then improved with 2-opt (reversing the order of a run of paths,
+ * each path itself is still marked in the same direction). A closed path
+ * is only marked after the closed paths inside it, so holes are cut before
+ * the part they are in comes loose. The result is only used if it has
+ * less travel.
+ *
+ * Barriers: every command but move, line and curves (speed/power, z, set
+ * position, nop), and a bitmap up to and including its line, are copied
+ * as they are, in the same place. At most LAOSOPTIMIZE_PATHS paths are
+ * reordered together; longer runs are done in parts, which keep their
+ * original order (also for a hole and its part in different parts).
+ *
+ * Only stdio: this also builds on a PC. A read or write error of any of
+ * the files makes the result unusable (Run() and Finish() return false).
+ * The firmware runs it in steps of a few commands, see Start().
+ *
+ @code
+ LaosOptimize opt;
+ FILE *in = fopen(name, "rb"), *copy = fopen(name, "rb"), *out = fopen(tmp, "wb");
+ if (opt.Run(in, copy, out) && fclose(out) == 0) ... use tmp, opt.GetTravelAfter() ...
+ @endcode
+ */
+#ifndef LAOSOPTIMIZEH
+#define LAOSOPTIMIZEH
+
+#include <stdio.h>
+
+#define OPTIMIZE_FILE "optimize.sys" // the optimized job, before it replaces the original
+#define LAOSOPTIMIZE_PATHS 48 // paths reordered together
+#define LAOSOPTIMIZE_PASSES 4 // max 2-opt passes
+#define LAOSOPTIMIZE_CLOSED 10 // a path that ends this close to its start is closed [micron]
+#define LAOSOPTIMIZE_STEP 64 // commands per Step() in Run()
+
+class LaosOptimize {
+
+public:
+  LaosOptimize();
+
+  // Write the job in to out in the optimized order. copy is a second
+  // handle on the same file, to copy the paths from. Returns true if
+  // out has less travel than in, and no file had an error.
+  bool Run(FILE *in, FILE *copy, FILE *out);
+
+  // Run() in parts: Start(), then Step() until it returns false (the end
+  // of the file, or an error), then Finish(), which returns what Run() does.
+  // Each step reads at most n commands, and may write up to
+  // LAOSOPTIMIZE_PATHS paths.
+  void Start(FILE *in, FILE *copy, FILE *out);
+  bool Step(int n);
+  bool Finish();
+
+  float GetTravelBefore() const { return m_Before / 1000; } // [mm]
+  float GetTravelAfter() const { return m_After / 1000; }   // [mm]
+
+private:
+  typedef struct {
+    long start, end;            // the marking commands in the file [bytes]
+    int sx, sy, ex, ey;         // start and end [micron]
+    int minx, miny, maxx, maxy; // bounding box [micron]
+    bool closed;
+  } TPath;
+
+  bool Command(int cmd);
+  bool Failed() const;
+  bool Token(int &v);
+  bool Args(int n, int *a);
+  void Bound(TPath &p, int x, int y);
+  void End(TPath &p, int x, int y);
+  void Copy(long start, long end);
+  void Flush();
+  void Order();
+  bool Inside(const TPath &a, const TPath &b) const;
+  bool Allowed(int i) const;
+  float Travel(int x, int y, const TPath &p) const;
+  float Travel(const TPath &a, const TPath &b) const { return Travel(a.ex, a.ey, b); }
+  void Restore();
+  void Move(int x, int y);
+
+private:
+  FILE *m_In, *m_Copy, *m_Out;
+  long m_Offset;              // in the file
+  long m_TokenStart, m_TokenEnd; // of the last token
+
+  TPath m_Path[LAOSOPTIMIZE_PATHS];
+  unsigned char m_Order[LAOSOPTIMIZE_PATHS];
+  bool m_Done[LAOSOPTIMIZE_PATHS];
+  int m_Count;
+  bool m_Open;                // the last path can still be extended
+
+  int m_PosX, m_PosY;         // position in the original order [micron]
+  int m_OutX, m_OutY;         // position after what has been written
+  bool m_Move;                // a move is waiting for the next path
+  bool m_Bitmap;              // a bitmap is waiting for its line
+  float m_Before, m_After;    // travel [micron]
+};
+
+#endif
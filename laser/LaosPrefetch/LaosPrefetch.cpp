@@ -0,0 +1,191 @@
+/**
+ * LaosPrefetch.cpp
+ * Read ahead buffer for the running job
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "LaosPrefetch.h"
+
+// Kept in the USB AHB SRAM bank, next to the TFTP upload buffer
+static char ring[PREFETCH_SIZE] __attribute__((section("AHBSRAM0"), aligned(4)));
+
+tPrefetchStats prefetch_stats;
+static FILE *fp = NULL;         // NULL: the whole job is in the ring
+static bool opened = false;
+static char cached[MAXFILESIZE]; // job in the ring
+static long size;               // file size [bytes]
+static long start;              // file offset of the first byte read into the ring
+static long filled;             // file offset of the end of the data in the ring
+static long pos;                // file offset of the next byte for the parser
+
+// the ring holds the whole job from the start
+static bool complete()
+{
+  return (start == 0) && (filled == size) && (size <= PREFETCH_SIZE);
+}
+
+bool prefetch_open(char *name)
+{
+  extern LaosFileSystem sd;
+  prefetch_close();
+  memset(&prefetch_stats, 0, sizeof(prefetch_stats));
+  prefetch_stats.min_level = PREFETCH_SIZE;
+  pos = 0;
+  if (cached[0] && !strncmp(cached, name, MAXFILESIZE) && complete())
+  {
+    prefetch_stats.cached = true;
+    opened = true;
+    return true;
+  }
+  cached[0] = 0;
+  fp = sd.openfile(name, "rb");
+  if (fp == NULL)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  start = filled = 0;
+  strncpy(cached, name, MAXFILESIZE-1);
+  opened = true;
+  return true;
+}
+
+void prefetch_close()
+{
+  if (fp != NULL)
+    fclose(fp);
+  fp = NULL;
+  opened = false;
+}
+
+bool prefetch_isopen()
+{
+  return opened;
+}
+
+bool prefetch_room()
+{
+  return opened && (fp != NULL) && (filled < size) &&
+    (PREFETCH_SIZE - (filled - pos) >= PREFETCH_CHUNK);
+}
+
+// Read the next chunk: up to the next chunk boundary, so reads stay sector
+// aligned and never wrap around the end of the ring
+void prefetch_fill()
+{
+  if (!opened || fp == NULL || filled >= size)
+    return;
+  long n = PREFETCH_CHUNK - (filled % PREFETCH_CHUNK);
+  if (n > size - filled)
+    n = size - filled;
+  if (n > PREFETCH_SIZE - (filled - pos))
+    return; // no room
+  if (ftell(fp) != filled)
+    fseek(fp, filled, SEEK_SET);
+  long got = fread(&ring[filled % PREFETCH_SIZE], 1, n, fp);
+  prefetch_stats.sd_bytes += got;
+  filled += got;
+  if (got < n)
+    size = filled; // read error: end the job here
+}
+
+// next byte for the parser, EOF at the end
+static int prefetch_getc()
+{
+  if (pos >= size)
+    return EOF;
+  if (pos >= filled)
+  {
+    prefetch_stats.starved++;
+    prefetch_fill();
+    if (pos >= filled)
+      return EOF;
+  }
+  return (unsigned char)ring[pos++ % PREFETCH_SIZE];
+}
+
+// Read an integer, as readint()
+int prefetch_readint()
+{
+  unsigned short int i = 0;
+  int sign = 1, val = 0, c;
+
+  if (filled < size && (unsigned long)(filled - pos) < prefetch_stats.min_level)
+    prefetch_stats.min_level = filled - pos;
+  while ((c = prefetch_getc()) != EOF)
+  {
+    switch (c)
+    {
+      case '0': case '1': case '2': case '3': case '4':
+      case '5': case '6': case '7': case '8': case '9':
+        if (i < 16)
+        {
+          val = val * 10 + (c - '0');
+          i++;
+        }
+        break;
+      case '-': sign = -1; break;
+      case ';':
+        while ((c != '\n') && (c = prefetch_getc()) != EOF)
+          ;
+        break;
+      case ' ': case '\t': case '\r': case '\n':
+        if (i)
+          return val * sign;
+        break;
+    }
+  }
+  return 0;
+}
+
+bool prefetch_eof()
+{
+  return pos >= size;
+}
+
+long prefetch_tell()
+{
+  return pos;
+}
+
+long prefetch_size()
+{
+  return size;
+}
+
+// Within the data in the ring, only the offset changes. Otherwise start
+// filling again from the chunk that holds offset.
+void prefetch_seek(long offset)
+{
+  if (offset < 0) offset = 0;
+  if (offset > size) offset = size;
+  long base = filled - PREFETCH_SIZE;
+  if (base < start) base = start;
+  if (offset < base || offset > filled)
+  {
+    if (fp == NULL)
+      return; // cannot happen: the whole job is in the ring
+    start = filled = offset - (offset % PREFETCH_CHUNK);
+  }
+  pos = offset;
+}
+
+void prefetch_forget(const char *name)
+{
+  if (!strncmp(cached, name, MAXFILESIZE))
+    cached[0] = 0;
+}
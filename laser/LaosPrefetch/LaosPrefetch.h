@@ -0,0 +1,76 @@
+/**
+ * LaosPrefetch.h
+ * Read ahead buffer for the running job
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The running job is read into a ring of PREFETCH_SIZE bytes in the
+ * (USB) AHB SRAM bank, in sector aligned chunks of PREFETCH_CHUNK bytes.
+ * The main loop fills it with prefetch_fill() whenever there is room, so
+ * the job feeder parses from memory; only when the ring runs dry does the
+ * feeder read from the card itself (counted in prefetch_stats.starved).
+ *
+ * A job that fits in the ring stays there after it has run: running it
+ * again does not read the card. The cached copy is dropped when a file
+ * with that name is uploaded or removed.
+ *
+ * Offsets are file offsets, as with ftell()/fseek(), so checkpoints and
+ * the underrun offsets in jobstats.sys do not change.
+ *
+ @code
+ if (prefetch_open(name)) {
+   while (!prefetch_eof()) mot->write(prefetch_readint());
+   prefetch_close();
+ }
+ @endcode
+ */
+#ifndef LAOSPREFETCHH
+#define LAOSPREFETCHH
+
+#include "laosfilesystem.h"
+
+#define PREFETCH_SIZE 8192  // ring [bytes], a multiple of PREFETCH_CHUNK
+#define PREFETCH_CHUNK 1024 // bytes per card read, a multiple of 512
+
+// fill level telemetry, per job
+typedef struct {
+  unsigned long min_level;  // least data ahead of the parser [bytes]
+  unsigned long starved;    // reads the parser had to wait for
+  unsigned long sd_bytes;   // read from the card
+  bool cached;              // the whole job was still in the ring
+} tPrefetchStats;
+extern tPrefetchStats prefetch_stats;
+
+// Start reading a job (long file name); false if it cannot be opened
+bool prefetch_open(char *name);
+void prefetch_close();
+bool prefetch_isopen();
+
+// Parser side: same rules as readint()
+int prefetch_readint();
+bool prefetch_eof();
+long prefetch_tell();
+long prefetch_size();
+void prefetch_seek(long offset);
+
+// Fill side: prefetch_room() tells if prefetch_fill() has a chunk to read
+bool prefetch_room();
+void prefetch_fill();
+
+// The file has been changed or removed: drop its cached copy
+void prefetch_forget(const char *name);
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * LaosQueue.cpp
+ * Job queue on the SD card, for runs of many parts
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "LaosQueue.h"
+
+static char queue_path[MAXFILESIZE+SHORTFILESIZE+1] = "";
+
+void queue_init(const char *path)
+{
+  strncpy(queue_path, path, sizeof(queue_path)-1);
+  queue_path[sizeof(queue_path)-1] = 0;
+}
+
+// open the queue file; NULL before queue_init()
+static FILE *queue_open(const char *mode)
+{
+  if (queue_path[0] == 0)
+    return NULL;
+  return fopen(queue_path, mode);
+}
+
+// Read the queue into q, returns the number of jobs
+static int queue_load(tQueueEntry *q)
+{
+  int n = 0;
+  FILE *fp = queue_open("rb");
+  if (fp == NULL)
+    return 0;
+  while ((n < QUEUE_MAX) && (fread(&q[n], sizeof(tQueueEntry), 1, fp) == 1))
+    n++;
+  fclose(fp);
+  return n;
+}
+
+// Write the queue; the file is small, so just write it again
+static void queue_store(const tQueueEntry *q, int n)
+{
+  FILE *fp = queue_open("wb");
+  if (fp == NULL)
+    return;
+  fwrite(q, sizeof(tQueueEntry), n, fp);
+  fclose(fp);
+}
+
+// Index of a job in q, -1 if it is not there; names are stored cut to
+// MAXFILESIZE-1 characters, so only those are compared
+static int queue_find(const tQueueEntry *q, int n, const char *name)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (!strncmp(q[i].name, name, MAXFILESIZE-1))
+      return i;
+  }
+  return -1;
+}
+
+int queue_count()
+{
+  tQueueEntry q[QUEUE_MAX];
+  return queue_load(q);
+}
+
+bool queue_head(tQueueEntry *e)
+{
+  FILE *fp = queue_open("rb");
+  if (fp == NULL)
+    return false;
+  bool found = (fread(e, sizeof(tQueueEntry), 1, fp) == 1);
+  fclose(fp);
+  return found;
+}
+
+void queue_add(const char *name)
+{
+  tQueueEntry q[QUEUE_MAX];
+  int n = queue_load(q);
+  if (queue_find(q, n, name) >= 0 || n == QUEUE_MAX)
+    return;
+  memset(&q[n], 0, sizeof(tQueueEntry));
+  strncpy(q[n].name, name, MAXFILESIZE-1);
+  q[n].runs = 1;
+  queue_store(q, n+1);
+}
+
+void queue_set_runs(const char *name, int runs)
+{
+  tQueueEntry q[QUEUE_MAX];
+  int n = queue_load(q);
+  int i = queue_find(q, n, name);
+  if (i < 0)
+    return;
+  if (runs > 0)
+  {
+    q[i].runs = runs;
+  }
+  else
+  {
+    n--;
+    memmove(&q[i], &q[i+1], (n-i) * sizeof(tQueueEntry));
+  }
+  queue_store(q, n);
+}
+
+void queue_done(const char *name)
+{
+  tQueueEntry q[QUEUE_MAX];
+  int n = queue_load(q);
+  int i = queue_find(q, n, name);
+  if (i >= 0)
+    queue_set_runs(name, q[i].runs - 1);
+}
+
+void queue_remove(const char *name)
+{
+  queue_set_runs(name, 0);
+}
+
+void queue_rotate()
+{
+  tQueueEntry q[QUEUE_MAX], head;
+  int n = queue_load(q);
+  if (n < 2)
+    return;
+  head = q[0];
+  memmove(&q[0], &q[1], (n-1) * sizeof(tQueueEntry));
+  q[n-1] = head;
+  queue_store(q, n);
+}
@@ -0,0 +1,77 @@
+/**
+ * LaosQueue.h
+ * Job queue on the SD card, for runs of many parts
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * With sys.queue set, uploaded jobs are added to QUEUE_FILE instead of
+ * waiting in START JOB. The queue is kept in upload order; each entry has
+ * the number of runs still to do (1 when it is added, changed with
+ * UP/DOWN on the JOB QUEUE screen). Started from JOB QUEUE, the jobs run
+ * back to back: when a job has been read, the next one is analyzed
+ * (extents from the upload, see LaosJobMeta) and its first moves are
+ * queued while the last moves of the previous job are still running.
+ *
+ * sys.queue 2 waits for the start input (cover closed) before each job,
+ * and starts the queue by itself when it is closed.
+ *
+ * queue_init() sets the file; main.cpp puts it on the SD card.
+ *
+ @code
+ queue_init("/sd/" QUEUE_FILE);
+ tQueueEntry e;
+ if (queue_head(&e)) ... run e.name ...
+ queue_done(e.name);
+ @endcode
+ */
+#ifndef LAOSQUEUEH
+#define LAOSQUEUEH
+
+#include "laosfilesystem.h"
+
+#define QUEUE_FILE "queue.sys"
+#define QUEUE_MAX 16 // max number of queued jobs
+
+typedef struct {
+  char name[MAXFILESIZE];   // long file name
+  int runs;                 // runs still to do
+} tQueueEntry;
+
+// Keep the queue in this file (full path); the file is made by queue_add()
+void queue_init(const char *path);
+
+// Number of queued jobs
+int queue_count();
+
+// The next job; false if the queue is empty
+bool queue_head(tQueueEntry *e);
+
+// Add a job at the end, for one run; a job that is already queued keeps its place
+void queue_add(const char *name);
+
+// Set the runs still to do for a job; 0 removes it
+void queue_set_runs(const char *name, int runs);
+
+// A run of the job is done: remove it after its last run
+void queue_done(const char *name);
+
+// Remove a job from the queue
+void queue_remove(const char *name);
+
+// Move the first job to the end
+void queue_rotate();
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * LaosSched.cpp
+ * Cooperative scheduler for the main loop
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "LaosSched.h"
+
+static tSchedTask *tasks[SCHED_MAX_TASKS];
+static int ntasks = 0;
+static uint32_t turn = 0;
+static int (*clock_ms)() = NULL;
+static uint32_t (*clock_cycles)() = NULL;
+
+void sched_set_clock(int (*ms)(), uint32_t (*cycles)())
+{
+  clock_ms = ms;
+  clock_cycles = cycles;
+}
+
+static int sched_ms()
+{
+  return clock_ms ? clock_ms() : 0;
+}
+
+static uint32_t sched_cycles()
+{
+  return clock_cycles ? clock_cycles() : 0;
+}
+
+void sched_add(tSchedTask *task)
+{
+  if (ntasks >= SCHED_MAX_TASKS)
+    return;
+  task->last = sched_ms();
+  task->turn = 0;
+  tasks[ntasks++] = task;
+  sched_reset_stats();
+}
+
+// Is a more urgent than b: overdue first, then the priority, then the
+// task that had its turn longest ago
+static bool sched_before(const tSchedTask *a, bool a_late, const tSchedTask *b, bool b_late)
+{
+  if (a_late != b_late)
+    return a_late;
+  if (a->prio != b->prio)
+    return a->prio > b->prio;
+  return a->turn < b->turn;
+}
+
+tSchedTask *sched_next(int now)
+{
+  tSchedTask *best = NULL;
+  bool best_late = false;
+  for (int i = 0; i < ntasks; i++)
+  {
+    tSchedTask *t = tasks[i];
+    if (t->ready && !t->ready())
+      continue;
+    bool late = t->max_wait && (now - t->last >= t->max_wait);
+    if (best == NULL || sched_before(t, late, best, best_late))
+    {
+      best = t;
+      best_late = late;
+    }
+  }
+  return best;
+}
+
+bool sched_run()
+{
+  int now = sched_ms();
+  tSchedTask *t = sched_next(now);
+  if (t == NULL)
+    return false;
+  uint32_t start = sched_cycles();
+  t->run();
+  uint32_t cycles = sched_cycles() - start;
+  t->last = now;
+  t->turn = ++turn;
+  t->runs++;
+  t->cycles += cycles;
+  if (cycles > t->max_cycles)
+    t->max_cycles = cycles;
+  return true;
+}
+
+void sched_reset_stats()
+{
+  for (int i = 0; i < ntasks; i++)
+  {
+    tasks[i]->runs = 0;
+    tasks[i]->cycles = 0;
+    tasks[i]->max_cycles = 0;
+  }
+}
+
+void sched_fprint(FILE *fp)
+{
+  for (int i = 0; i < ntasks; i++)
+  {
+    tSchedTask *t = tasks[i];
+    fprintf(fp, " %s=%lu/%lu/%lu", t->name, (unsigned long)t->runs,
+      (unsigned long)(t->runs ? t->cycles / t->runs : 0), (unsigned long)t->max_cycles);
+  }
+}
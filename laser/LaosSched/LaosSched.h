@@ -0,0 +1,81 @@
+/**
+ * LaosSched.h
+ * Cooperative scheduler for the main loop
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The main loop runs one task per pass of sched_run(). The task that runs
+ * is the ready one with the highest priority; tasks with the same priority
+ * take turns. A task that has not run for max_wait [ms] goes first, so a
+ * busy job feeder does not starve the display and the network.
+ *
+ * Tasks must return quickly: they poll, and never wait for something
+ * another task (or the stepper) has to do. The cycles each task takes are
+ * counted; the menu resets the counts at the start of a job and writes
+ * them to jobstats.sys.
+ *
+ * The scheduler reads the time and the cycle counter with the functions
+ * given to sched_set_clock(); it does not depend on mbed and also builds
+ * on a PC (see test/test_sched.cpp).
+ *
+ @code
+ static tSchedTask ui = { "ui", 1, NULL, ui_run, 20 };
+ sched_set_clock(read_ms, read_cycles);
+ sched_add(&ui);
+ while (1) sched_run();
+ @endcode
+ */
+#ifndef LAOSSCHEDH
+#define LAOSSCHEDH
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 8
+
+typedef struct {
+  const char *name;
+  int prio;             // higher runs first
+  int (*ready)();       // has work to do; NULL: always
+  void (*run)();
+  int max_wait;         // [ms] run after this long, whatever the priority; 0: no limit
+  // filled in by the scheduler
+  int last;             // systime [ms] of the last run
+  uint32_t turn;        // pass of the last run: tasks of the same priority take turns
+  uint32_t runs;
+  uint64_t cycles;
+  uint32_t max_cycles;
+} tSchedTask;
+
+// The clocks: time [ms] and a cycle counter, for the statistics; NULL: 0
+void sched_set_clock(int (*ms)(), uint32_t (*cycles)());
+
+// Add a task; the task must stay valid
+void sched_add(tSchedTask *task);
+
+// The task to run at time now [ms], NULL if none is ready
+tSchedTask *sched_next(int now);
+
+// Run the next task; false if none was ready
+bool sched_run();
+
+// Clear the run counts and cycles of all tasks
+void sched_reset_stats();
+
+// Append " name=runs/avg/max" [cycles] for all tasks
+void sched_fprint(FILE *fp);
+
+#endif
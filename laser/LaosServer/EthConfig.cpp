@@ -50,31 +50,66 @@ bool EthLink(void)
 }
 
 /**
-*** EthConfig
+*** EthStart: copy the settings from cfg, create the interface
 **/
-EthernetInterface * EthConfig()
- {
+void EthStart(tEthConnect *c)
+{
     extern GlobalConfig *cfg;
-    EthernetInterface *eth;
-    eth = new EthernetInterface();
-    if ( cfg->dhcp )
-    {
+    c->eth = new EthernetInterface();
+    c->dhcp = cfg->dhcp;
+    strcpy(c->ip, cfg->ip);
+    strcpy(c->nm, cfg->nm);
+    strcpy(c->gw, cfg->gw);
+    c->result = -1;
+    if ( c->dhcp )
         printf("DHCP...\n\r");
-        eth->init();
-    }
     else
     {
         printf("FIXED IP...\n\r");
-        printf("IP: %s\n\r", cfg->ip);
-        eth->init(cfg->ip, cfg->nm, cfg->gw);
+        printf("IP: %s\n\r", c->ip);
+    }
+}
+
+/**
+*** EthConnect: bring the interface up. No console or cfg access
+**/
+void EthConnect(tEthConnect *c)
+{
+    if ( c->dhcp )
+        c->eth->init();
+    else
+        c->eth->init(c->ip, c->nm, c->gw);
+    c->result = c->eth->connect(ETH_CONNECT_TIMEOUT);
+}
+
+/**
+*** EthDone: tell global about the current IP
+**/
+EthernetInterface * EthDone(tEthConnect *c)
+{
+    extern GlobalConfig *cfg;
+    EthernetInterface *eth = c->eth;
+    if ( c->result != 0 )
+    {
+        printf("NO NETWORK (%d)\n\r", c->result);
+        return eth;
     }
-    eth->connect();
-    // tell global about current IP
     strcpy(cfg->ip, eth->getIPAddress());
     strcpy(cfg->nm, eth->getNetworkMask());
     strcpy(cfg->gw, eth->getGateway());
-    
+
     printf("IP Address is: %c[8;34;2m%s%c[0m  \n\r", ESC, eth->getIPAddress(), ESC);
     return eth;
 }
 
+/**
+*** EthConfig
+**/
+EthernetInterface * EthConfig()
+{
+    tEthConnect c;
+    EthStart(&c);
+    EthConnect(&c);
+    return EthDone(&c);
+}
+
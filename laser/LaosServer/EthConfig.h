@@ -27,6 +27,24 @@
 #include "global.h"
 #include "EthernetInterface.h"
 
+#define ETH_CONNECT_TIMEOUT 15000 // [ms], to get the link and a DHCP lease
+
+// Bringing up the network, in three steps: EthStart() and EthDone() run on
+// the main thread, which owns the console, the SD card and cfg. Only
+// EthConnect() may run in a thread of its own (while the machine homes): it
+// works on the copy of the settings and prints nothing.
+typedef struct {
+  EthernetInterface *eth;
+  int dhcp;
+  IPAddress ip, nm, gw;
+  int result;            // of connect(): 0 if the network is up
+} tEthConnect;
+
+void EthStart(tEthConnect *c);
+void EthConnect(tEthConnect *c);
+EthernetInterface * EthDone(tEthConnect *c);
+
+// All three in a row
 EthernetInterface * EthConfig();
 bool EthSpeed(void);
 bool EthLink(void);
@@ -21,6 +21,13 @@
  *
  */
 #include "TFTPServer.h"
+#include "LaosLog.h"
+#include "LaosPrefetch.h"
+
+// Upload buffer. Kept in the (otherwise unused) USB AHB SRAM bank, so
+// uploads can be flushed to the card in large, sector aligned writes
+// without taking main RAM away from the network stack.
+static char wbuf[TFTP_WRITEBUF_SIZE] __attribute__((section("AHBSRAM0"), aligned(4)));
 
 // create a new tftp server, with file directory dir and
 // listening on port
@@ -34,6 +41,12 @@ TFTPServer::TFTPServer(int myport) {
         state = tftperror;
     ListenSock->set_blocking(false, 1);
     filecnt = 0;
+    wfh = NULL;
+    wbuflen = 0;
+    tsize = -1;
+    analyze = false;
+    netascii = false;
+    cr = false;
 }
 
 // destroy this instance of the tftp server
@@ -117,27 +130,36 @@ void TFTPServer::ConnectRead(char* buff) {
 }
 
 // create a new connection writing a file to the server
-void TFTPServer::ConnectWrite(char* buff) {
+void TFTPServer::ConnectWrite(char* buff, int len) {
     extern LaosFileSystem sd;
     remote_ip = client.get_address();
     remote_port = client.get_port();
-    Ack(0);
     blockcnt = 0;
     dupcnt = 0;
+    wbuflen = 0;
+    cr = false;
 
     sprintf(filename, "%s", &buff[2]);
     sd.shorten(filename, MAXFILESIZE);
-    if (modeOctet(buff))
-        fp = sd.openfile(filename, "wb");
-    else
-        fp = sd.openfile(filename, "w");
-    if (fp == NULL) {
+    netascii = !modeOctet(buff);
+    tsize = getOption(buff, len, "tsize");
+    wfh = sd.openhandle(filename, O_WRONLY|O_CREAT|O_TRUNC);
+    if (wfh == NULL) {
         Err("Could not open file to write");
         state  = listen;
         strcpy(remote_ip,"");
+    } else if ((tsize > 0) && (wfh->preallocate(tsize) < 0)) {
+        abortWrite("Disk full");
     } else {
         // file ready for writing
-        blockcnt = 0;
+        prefetch_forget(filename);
+        analyze = !isFirmware(filename) && strcmp(filename, "config.txt");
+        if (analyze)
+            meta.Start(filename);
+        if (tsize >= 0)
+            OAck();
+        else
+            Ack(0);
         state = writing;
         #ifdef TFTP_DEBUG 
             char debugmsg[256];
@@ -148,6 +170,84 @@ void TFTPServer::ConnectWrite(char* buff) {
     }
 }
 
+// buffer received data, write to disk in whole sectors. Netascii (RFC 764)
+// is converted in place: CR LF becomes LF and CR NUL becomes CR; a CR at
+// the end of a packet waits for the next one.
+bool TFTPServer::bufferWrite(char* data, int len) {
+    if (netascii) {
+        if (cr && (len > 0) && (data[0] != '\n') && (data[0] != 0)) {
+            cr = false;
+            if (!writeData("\r", 1))   // a bare CR
+                return false;
+        }
+        int n = 0;
+        for (int i = 0; i < len; i++) {
+            char c = data[i];
+            if (cr) {
+                cr = false;
+                if ((c == '\n') || (c == 0)) {
+                    data[n++] = c ? '\n' : '\r';
+                    continue;
+                }
+                data[n++] = '\r';
+            }
+            if (c == '\r')
+                cr = true;
+            else
+                data[n++] = c;
+        }
+        len = n;
+    }
+    return writeData(data, len);
+}
+
+bool TFTPServer::writeData(const char* data, int len) {
+    while (len > 0) {
+        int n = TFTP_WRITEBUF_SIZE - wbuflen;
+        if (n > len)
+            n = len;
+        memcpy(&wbuf[wbuflen], data, n);
+        if (analyze)
+            meta.Put(data, n);
+        wbuflen += n;
+        data += n;
+        len -= n;
+        if (wbuflen == TFTP_WRITEBUF_SIZE) {
+            if (wfh->write(wbuf, wbuflen) != wbuflen)
+                return false;
+            wbuflen = 0;
+        }
+    }
+    return true;
+}
+
+// write out remaining buffer and close the uploaded file
+bool TFTPServer::closeWrite() {
+    if (wfh == NULL)
+        return false;
+    bool ok = true;
+    if (netascii && cr)
+        ok = writeData("\r", 1);
+    cr = false;
+    if (ok && wbuflen)
+        ok = (wfh->write(wbuf, wbuflen) == wbuflen);
+    wbuflen = 0;
+    if (wfh->close() != 0)
+        ok = false;
+    wfh = NULL;
+    return ok;
+}
+
+// a failed upload: send ERR, close and remove the partial file
+void TFTPServer::abortWrite(const std::string& msg) {
+    Err(msg);
+    closeWrite();
+    removefile(filename);
+    state = listen;
+    strcpy(remote_ip,"");
+    LOGSTR2(LOG_LEVEL_WARN, LOG_NET, "Receive %s failed: %s\n", filename, msg.c_str());
+}
+
 // get DATA block from file on disk into memory
 void TFTPServer::getBlock() {
     blockcnt++;
@@ -186,17 +286,45 @@ void TFTPServer::Ack(int val) {
     ListenSock->sendTo(client, ack, 4);
 }
 
+// send OACK with the accepted tsize option to remote
+void TFTPServer::OAck() {
+    char oack[32];
+    oack[0] = 0x00;
+    oack[1] = 0x06;
+    int len = 2;
+    len += sprintf(&oack[len], "tsize") + 1;
+    len += sprintf(&oack[len], "%d", tsize) + 1;
+    ListenSock->sendTo(client, oack, len);
+}
+
+// find a numeric option (RFC 2347) in a request packet, -1 if absent
+int TFTPServer::getOption(char* buff, int len, const char* name) {
+    int x = 2;
+    while ((x < len) && (buff[x++] != 0));  // skip filename
+    while ((x < len) && (buff[x++] != 0));  // skip mode
+    while (x < len) {
+        char *opt = &buff[x];
+        while ((x < len) && (buff[x++] != 0));
+        char *val = &buff[x];
+        while ((x < len) && (buff[x++] != 0));
+        if ((buff[x-1] == 0) && (strcasecmp(opt, name) == 0))
+            return atoi(val);
+    }
+    return -1;
+}
+
 // send ERR message to named client
 void TFTPServer::Err(const std::string& msg) {
     char message[32];
-    strncpy(message, msg.c_str(), 32);
+    strncpy(message, msg.c_str(), sizeof(message)-1);
+    message[sizeof(message)-1] = 0;
     char err[37];
     sprintf(err, "0000%s0", message);
+    int len = strlen(err); // before the opcode puts a 0 in front
     err[0] = 0x00;
     err[1] = 0x05;
     err[2]=0x00;
     err[3]=0x00;
-    int len = strlen(err);
     err[len-1] = 0x00;
     ListenSock->sendTo(client, err, len);
     #ifdef TFTP_DEBUG
@@ -230,7 +358,7 @@ void TFTPServer::poll() {
     if (len == 0) {
         return;
     }
-    printf("Got block with size %d\n\r", len);
+    LOG_DEBUG(LOG_NET, "Got block with size %d\n\r", len);
     switch (state) {
         case listen: {
             switch (buff[1]) {
@@ -238,7 +366,7 @@ void TFTPServer::poll() {
                     ConnectRead(buff);
                     break;
                 case 0x02: // WRQ
-                    ConnectWrite(buff);
+                    ConnectWrite(buff, len);
                     break;
                 case 0x03: // DATA before connection established
                     Err("No data expected");
@@ -307,7 +435,7 @@ void TFTPServer::poll() {
 	                    break;
 	            } // switch (buff[1])
             else 
-                printf("Ignoring package from other host during RRQ");
+                LOG_WARN(LOG_NET, "Ignoring package from other host during RRQ\n\r");
             break; // reading
         }
         case writing: {
@@ -315,48 +443,54 @@ void TFTPServer::poll() {
 	            switch (buff[1]) {
 	                case 0x02: {
 	                    // if this is a returning host, send ack again
-	                    Ack(0);
+	                    if (tsize >= 0)
+	                        OAck();
+	                    else
+	                        Ack(0);
 	                    #ifdef TFTP_DEBUG
 	                        TFTP_DEBUG("Resending Ack on WRQ");
 	                    #endif
 	                    break; // case 0x02
                     }
 	                case 0x03: {
-	                    int block = (buff[2] << 8) + buff[3];
+	                    int block = ((unsigned char)buff[2] << 8) + (unsigned char)buff[3];
 	                    if ((blockcnt+1) == block) {
-	                        Ack(block);
 	                        // new packet
 	                        char *data = &buff[4];
-	                        fwrite(data, 1,len-4, fp);
+	                        if (!bufferWrite(data, len-4)) {
+	                            abortWrite("Write error");
+	                            break;
+	                        }
 	                        blockcnt++;
 	                        dupcnt = 0;
+	                        if (len < 516) {
+	                            // the last one: only ACK it once the file is complete
+	                            if (!closeWrite()) {
+	                                abortWrite("Write error");
+	                                break;
+	                            }
+	                            Ack(blockcnt);
+	                            if (analyze)
+	                                meta.Save(); // cache extent and estimate for the menu
+	                            state = listen;
+	                            strcpy(remote_ip,"");
+	                            filecnt++;
+	                            LOG_INFO(LOG_NET, "File receive finished\n");
+	                        } else {
+	                            Ack(block);
+	                        }
 	                    } else { // mismatch in block nr
 	                        if ((blockcnt+1) < block) { // too high
-                                Err("Packet count mismatch");
-	                            fclose(fp);
-	                            state = listen;
-	                            remove(filename);
-                                strcpy(remote_ip,"");
+	                            abortWrite("Packet count mismatch");
 	                         } else { // duplicate packet, send ACK again
 	                            if (dupcnt > 10) {
-	                                Err("Too many dups");
-	                                fclose(fp);
-	                                remove(filename);
-	                                state = listen;
+	                                abortWrite("Too many dups");
 	                            } else {
 	                                Ack(blockcnt);
-                                    dupcnt++;
+	                                dupcnt++;
 	                            }
 	                        }
 	                    }
-                        if (len<516) {
-                            Ack(blockcnt);
-                            fclose(fp);
-                            state = listen;
-                            strcpy(remote_ip,"");
-                            filecnt++;
-                            printf("File receive finished\n");
-                        }
 	                    break; // case 0x03
                     }
 	                default: {
@@ -365,7 +499,7 @@ void TFTPServer::poll() {
                     }
 	            } // switch (buff[1])
             else {
-                printf("Ignoring packege from other host during WRQ");
+                LOG_WARN(LOG_NET, "Ignoring packege from other host during WRQ\n\r");
             }
             break; // writing
         }
@@ -24,8 +24,11 @@
  *      * Server handles only one transfer at a time
  *      * Supports only binary mode transfers, no (net)ascii
  *      * fixed block size: 512 bytes
+ *      * tsize option on upload, used to preallocate the file
+ *      * uploads are written to SD in whole sectors (TFTP_WRITEBUF_SIZE)
  *
  * http://spectral.mscs.mu.edu/RFC/rfc1350.html
+ * http://spectral.mscs.mu.edu/RFC/rfc2349.html
  *
  * Example:
  * @code 
@@ -46,8 +49,10 @@
 #include "laosfilesystem.h"
 #include "EthernetInterface.h"
 #include "global.h"
+#include "LaosJobMeta.h"
 
 #define TFTP_PORT 69
+#define TFTP_WRITEBUF_SIZE 4096 // upload buffer, multiple of the 512 byte sector
 //#define TFTP_DEBUG(x) printf("%s\n\r", x);
 
 enum TFTPServerState { listen, reading, writing, tftperror, suspended, deleted }; 
@@ -79,7 +84,7 @@ private:
     // create a new connection reading a file from server
     void ConnectRead(char* buff);
     // create a new connection writing a file to the server
-    void ConnectWrite(char* buff);
+    void ConnectWrite(char* buff, int len);
     // get DATA block from file on disk into memory
     void getBlock();
     // send DATA block to the client
@@ -91,6 +96,19 @@ private:
     int cmpHost();
     // send ACK to remote
     void Ack(int val);
+    // send OACK with the accepted tsize option to remote
+    void OAck();
+    // find a numeric option (RFC 2347) in a request packet, -1 if absent
+    int getOption(char* buff, int len, const char* name);
+    // buffer received data (netascii: converted in place), write to disk
+    // in whole sectors; false if a write failed
+    bool bufferWrite(char* data, int len);
+    bool writeData(const char* data, int len);
+    // write out remaining buffer and close the uploaded file; false if a
+    // write failed
+    bool closeWrite();
+    // a failed upload: send ERR, close and remove the partial file
+    void abortWrite(const std::string& msg);
     // send ERR message to named client
     void Err(const std::string& msg);
     // check if connection mode of client is octet/binary
@@ -105,7 +123,14 @@ private:
     char* remote_ip;         // connected remote Host IP
     int remote_port;            // connected remote Host Port
     int blockcnt, dupcnt;       // block counter, and DUP counter
-    FILE* fp;                   // current file to read or write
+    FILE* fp;                   // current file to read
+    FATFileHandle* wfh;         // current file to write
+    int wbuflen;                // bytes waiting in the write buffer
+    int tsize;                  // announced upload size, -1 if unknown
+    LaosJobMeta meta;           // analysis of the uploaded job
+    bool analyze;               // upload is a job: analyze and cache it
+    bool netascii;              // upload in netascii mode: CR LF is stored as LF
+    bool cr;                    // netascii: the last byte was a CR
     char sendbuff[516];         // current DATA block;
     int blocksize;              // last DATA block size while sending
     char filename[256];         // current (or most recent) filename
@@ -213,6 +213,7 @@ FRESULT f_stat (const TCHAR*, FILINFO*);            /* Get file status */
 FRESULT f_write (FIL*, const void*, UINT, UINT*);   /* Write data to a file */
 FRESULT f_getfree (const TCHAR*, DWORD*, FATFS**);  /* Get number of free clusters on the drive */
 FRESULT f_truncate (FIL*);                          /* Truncate file */
+FRESULT f_expand (FIL*, DWORD, BYTE);               /* Allocate a contiguous block to the file */
 FRESULT f_sync (FIL*);                              /* Flush cached data of a writing file */
 FRESULT f_unlink (const TCHAR*);                    /* Delete an existing file or directory */
 FRESULT f_mkdir (const TCHAR*);                     /* Create a new directory */
@@ -49,10 +49,15 @@
 /* To enable f_forward function, set _USE_FORWARD to 1 and set _FS_TINY to 1. */
 
 
-#define _USE_FASTSEEK   0   /* 0:Disable or 1:Enable */
+#define _USE_FASTSEEK   1   /* 0:Disable or 1:Enable */
 /* To enable fast seek feature, set _USE_FASTSEEK to 1. */
 
 
+#define _USE_EXPAND     1   /* 0:Disable or 1:Enable */
+/* To enable f_expand function, set _USE_EXPAND to 1 and set _FS_READONLY to 0.
+/  (backported from FatFs R0.12) */
+
+
 
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
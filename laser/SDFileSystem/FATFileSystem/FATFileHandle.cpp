@@ -27,9 +27,28 @@
 
 FATFileHandle::FATFileHandle(FIL fh) {
     _fh = fh;
+    _prealloc = 0;
+#if _USE_FASTSEEK
+    // map the cluster chain of files that are only read, so seeks
+    // (and reads across cluster boundaries) do not walk the FAT
+    if (!(_fh.flag & FA_WRITE) && _fh.fsize) {
+        _cltbl[0] = FFS_CLMT_SIZE;
+        _fh.cltbl = _cltbl;
+        if (f_lseek(&_fh, CREATE_LINKMAP) != FR_OK) {
+            debug_if(FFS_DBG, "fast seek map not created\n");
+            _fh.cltbl = NULL;
+        }
+    }
+#endif
 }
 
 int FATFileHandle::close() {
+    if (_prealloc && (_fh.fptr < _fh.fsize)) {
+        FRESULT res = f_truncate(&_fh);
+        if (res) {
+            debug_if(FFS_DBG, "f_truncate() failed: %d\n", res);
+        }
+    }
     int retval = f_close(&_fh);
     delete this;
     return retval;
@@ -88,3 +107,37 @@ int FATFileHandle::fsync() {
 off_t FATFileHandle::flen() {
     return _fh.fsize;
 }
+
+int FATFileHandle::preallocate(DWORD size) {
+    if (!(_fh.flag & FA_WRITE) || _fh.fsize != 0) {
+        return -1;
+    }
+    FRESULT res;
+#if _USE_EXPAND
+    res = f_expand(&_fh, size, 1);
+    if (res == FR_OK) {
+        _prealloc = 1;
+        return 0;
+    }
+    debug_if(FFS_DBG, "f_expand(%d) failed: %d\n", size, res);
+    if (res != FR_DENIED) {
+        return -1;
+    }
+#endif
+    // no contiguous block free: seeking beyond the end of a file opened for
+    // writing stretches the cluster chain; rewind afterwards so the data is
+    // written in place
+    res = f_lseek(&_fh, size);
+    if ((res == FR_OK) && (_fh.fptr != size)) {
+        res = FR_DENIED;    // disk full
+    }
+    if (res == FR_OK) {
+        _prealloc = 1;
+        res = f_lseek(&_fh, 0);
+    }
+    if (res) {
+        debug_if(FFS_DBG, "preallocate(%d) failed: %d\n", size, res);
+        return -1;
+    }
+    return 0;
+}
@@ -26,6 +26,11 @@
 
 using namespace mbed;
 
+// Size (in DWORDs) of the fast seek cluster map kept for files opened
+// read-only; holds (FFS_CLMT_SIZE-2)/2 fragments, more fragmented files
+// fall back to following the FAT chain.
+#define FFS_CLMT_SIZE 32
+
 class FATFileHandle : public FileHandle {
 public:
 
@@ -38,9 +43,17 @@ public:
     virtual int fsync();
     virtual off_t flen();
 
+    // Allocate the cluster chain for a file of size bytes up front, so
+    // later writes do not have to extend the FAT. A contiguous extent is
+    // used when the card has one. Only valid on an empty file opened for
+    // writing; close() truncates any unused tail.
+    int preallocate(DWORD size);
+
 protected:
 
     FIL _fh;
+    int _prealloc;
+    DWORD _cltbl[FFS_CLMT_SIZE];
 
 };
 
@@ -53,10 +53,8 @@ void IpParse(char *a, int i[])
 **/
 GlobalConfig::GlobalConfig(const std::string& filename)
 {
-   char *file = new char[filename.size()+1];
-   strcpy(file, filename.c_str());
-   printf("\r\nOpen config file: '%s'\r\n", file);
-   ConfigFile cfg(file);
+   printf("\r\nOpen config file: '%s'\r\n", filename.c_str());
+   ConfigFile cfg(filename.c_str());
     if ( !cfg.IsOpen() ) 
     {
       printf("File does not exists. Using defaults\r\n");
@@ -77,6 +75,10 @@ GlobalConfig::GlobalConfig(const std::string& filename)
     cfg.Value("sys.i2cbaud", &i2cbaud, 9600);
     cfg.Value("sys.cleandir", &cleandir, 1);
     cfg.Value("sys.disablecancelcheck", &disablecancelcheck, 0);
+    cfg.Value("sys.dryrun", &dryrun, 0);
+    cfg.Value("sys.checkpoint", &checkpoint, 10); // job checkpoint interval [sec], 0: off
+    cfg.Value("sys.queue", &queue, 0); // job queue [0/1/2]
+    cfg.Value("sys.optimize", &optimize, 0); // reorder received jobs for less travel [0/1]
     
     // Laser
     cfg.Value("laser.enable", &lenable, 1); // laser enable polarity [0/1]
@@ -122,11 +124,11 @@ GlobalConfig::GlobalConfig(const std::string& filename)
     cfg.Value("z.speed", &zspeed, 100);
     cfg.Value("e.speed", &espeed, 100);
    
-    // max axis acceleration [mm/sec2]
-    cfg.Value("x.accel", &xaccel, 2000);
-    cfg.Value("y.accel", &yaccel, 2000);
-    cfg.Value("z.accel", &zaccel, 2000);
-    cfg.Value("e.accel", &eaccel, 2000);
+    // max axis acceleration [mm/sec2], 0: motion.accel
+    cfg.Value("x.accel", &xaccel, 0);
+    cfg.Value("y.accel", &yaccel, 0);
+    cfg.Value("z.accel", &zaccel, 0);
+    cfg.Value("e.accel", &eaccel, 0);
    
     // max axis speed [mm/sec]
     // home positions [um]
@@ -148,10 +150,17 @@ GlobalConfig::GlobalConfig(const std::string& filename)
     // motion settings: enable output state    
     cfg.Value("motion.homespeed", &homespeed, 10); // speed during homing [usec/step]
     cfg.Value("motion.zhomespeed", &zhomespeed, 10); // z-axis speed during homing [usec/step]
+    cfg.Value("motion.homefast", &homefast, 50); // fast seek speed during homing [mm/sec]
+    cfg.Value("motion.zhomefast", &zhomefast, 0); // z-axis fast seek speed [mm/sec], 0: zhomespeed only
+    cfg.Value("motion.homebackoff", &homebackoff, 2000); // back off after the fast seek [micrometer]
     cfg.Value("motion.speed", &speed, 100);   // max speed [mm/sec]
-    cfg.Value("motion.accel", &accel, 100); // accelleration [mm/sec2]
+    cfg.Value("motion.accel", &accel, 100); // accelleration of axes without [axis].accel [mm/sec2]
+    cfg.Value("motion.rasteraccel", &rasteraccel, 2000); // acceleration of raster lines [mm/sec2]
     cfg.Value("motion.enable", &enable, 0); // enable output polarity [0/1]
     cfg.Value("motion.tolerance", &tolerance, 50); // cornering tolerance [1/1000 units]
+    cfg.Value("motion.curvetolerance", &curvetolerance, 10); // arc/Bezier segment tolerance [micrometer]
+    cfg.Value("motion.mergetolerance", &mergetolerance, 5); // merge collinear lines [micrometer]
+    cfg.Value("motion.scurve", &scurve, 0); // S-curve acceleration ramps [0/1]
 
  	cfg.Value("dir_us", &dir_us, 0);
 	cfg.Value("pulse_us", &pulse_us, 0);
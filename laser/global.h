@@ -47,6 +47,10 @@ public:
   int cleandir; // remove files from SD at startup
   int i2cbaud; // i2cBaudrate
   int disablecancelcheck; // if the check for cancel button should be disabled while a job is running
+  int dryrun; // benchmark: run jobs without step pulses or laser, skip homing
+  int checkpoint; // seconds between job checkpoints for RESUME JOB, 0: off
+  int queue; // job queue: 0=off, 1=jobs run back to back, 2=each job starts when the cover closes
+  int optimize; // reorder the paths of received jobs for less travel
   int xmax, ymax, zmax, emax; // max values
   int xmin, ymin, zmin, emin; // min values
   int xpol, ypol, zpol, epol; // polarity for the home switches
@@ -54,11 +58,17 @@ public:
   int xhome, yhome, zhome, ehome; // home position
   int xrest, yrest, zrest, erest; // rest positon (moveto after job)
   int xhomedir, yhomedir, zhomedir, ehomedir;
-  int homespeed, zhomespeed; // speed used for homing [usec/step]
+  int homespeed, zhomespeed; // speed of the (second, slow) approach of the home switches [usec/step]
+  int homefast, zhomefast; // speed of the first approach of the home switches [mm/sec]
+  int homebackoff; // distance to move off the switches before the slow approach [micrometer]
   int speed, xspeed, yspeed, zspeed, espeed; // Maximum linear speed and max speed per axis [mm/sec]
   int accel; // defaul accelletaion [mm/sec2]
-  int xaccel, yaccel, zaccel, eaccel; // axis max acceleration [mm/sec2]
+  int xaccel, yaccel, zaccel, eaccel; // axis max acceleration [mm/sec2], 0: accel
+  int rasteraccel; // acceleration of raster (bitmap) lines [mm/sec2]
   int tolerance; // corner tolerance [micrometer]
+  int curvetolerance; // max distance between arc/Bezier segments and the curve [micrometer]
+  int mergetolerance; // max deviation when merging (nearly) collinear lines [micrometer]
+  int scurve; // jerk limited (S-curve) acceleration ramps: 0=off, 1=on
   int xscale; // steps per meter
   int yscale; // steps per meter
   int zscale; // steps per meter
@@ -54,6 +54,14 @@
 #include "LaosMotion.h"
 #include "SDFileSystem.h"
 #include "laosfilesystem.h"
+#include "LaosLog.h"
+#include "LaosBoot.h"
+#include "LaosCheckpoint.h"
+#include "LaosSched.h"
+#include "LaosPrefetch.h"
+#include "LaosQueue.h"
+#include "LaosOptimize.h"
+#include "rtos.h"
 
 // Status and communication
 EthernetInterface *eth; // Ethernet, tcp/ip
@@ -75,6 +83,15 @@ GlobalConfig *cfg;
 // Protos
 void main_nodisplay();
 void main_menu();
+static void eth_thread(void const *arg);
+static void nodisplay_job(char *name, bool remove);
+
+// Boot phases
+#define BOOT_BEGIN(name) boot_begin(name, systime.read_ms())
+#define BOOT_END(p) boot_end(p, systime.read_ms())
+#define ETH_STACK_SIZE 2048
+static int boot_eth;
+static tEthConnect eth_connect;
 
 // for debugging:
 extern void plan_get_current_position_xyz(float *x, float *y, float *z);
@@ -90,12 +107,15 @@ int main()
   //float x, y, z;
   eth_speed = 1;
   
+  int boot = BOOT_BEGIN("display");
   dsp = new LaosDisplay();
   printf( VERSION_STRING "...\nBOOT...\n" ); 
   mnu = new LaosMenu(dsp);
   eth_speed=0;
+  BOOT_END(boot);
 
- printf("TEST SD...\n"); 
+  printf("TEST SD...\n"); 
+  boot = BOOT_BEGIN("sd");
   char testfile[] = "test.txt";
   FILE *fp = sd.openfile(testfile, "wb");
   if ( fp == NULL )
@@ -110,31 +130,34 @@ int main()
     fclose(fp);
     removefile(testfile);
   }
+  char queuefile[MAXFILESIZE+SHORTFILESIZE+1];
+  sprintf(queuefile, "%s%s", sd.pathname, QUEUE_FILE);
+  queue_init(queuefile);
   
   // See if there's a .bin file on the SD
   // if so, put it on the MBED and reboot
   if (SDcheckFirmware()) mbed_reset();
+  BOOT_END(boot);
   
   mnu->SetScreen(VERSION_STRING);
   printf("START...\n");
+  boot = BOOT_BEGIN("config");
   cfg =  new GlobalConfig("config.txt");
   mnu->SetScreen("CONFIG OK...."); 
   printf("CONFIG OK...\n");
   if (!cfg->nodisplay)
     dsp->testI2C();
+  BOOT_END(boot);
+
+  // The network comes up (and may wait for DHCP) while we home
+  boot_eth = BOOT_BEGIN("network");
+  EthStart(&eth_connect);
+  Thread eth_init(eth_thread, &eth_connect, osPriorityNormal, ETH_STACK_SIZE);
   
   printf("MOTION...\n"); 
+  boot = BOOT_BEGIN("motion");
   mot = new LaosMotion();
-    
-  eth = EthConfig();
-  eth_speed=1;
-      
-  printf("SERVER...\n");
-  srv = new TFTPServer(cfg->port);
-  mnu->SetScreen("SERVER OK...."); 
-  wait(0.5);
-  mnu->SetScreen(10); // IP
-  wait(1.0);
+  BOOT_END(boot);
   
   printf("RUN...\n");
   
@@ -143,8 +166,6 @@ int main()
   if ( cfg->autohome )
   {
     printf("WAIT FOR COVER...\n");
-    wait(1);
-  
   
   // Start homing
     mnu->SetScreen("WAIT FOR COVER....");
@@ -153,16 +174,42 @@ int main()
     mnu->SetScreen("HOME....");
     printf("HOME...\n");
 
+    boot = BOOT_BEGIN("home");
     mot->home(cfg->xhome,cfg->yhome, cfg->zhome);
+    BOOT_END(boot);
     // if ( !mot->isHome ) exit(1);
     printf("HOME DONE. (%d,%d, %d)\n",cfg->xhome,cfg->yhome,cfg->zhome);
   }
   else
     printf("Homing skipped: %d\n", cfg->autohome);
 
-  // clean sd card?
-  if (cfg->cleandir) cleandir();
+  // clean sd card? Not while there is a job to resume, or jobs are queued
+  tCheckpoint cp;
+  if (cfg->cleandir && !checkpoint_load(&cp) && !queue_count())
+  {
+    boot = BOOT_BEGIN("cleandir");
+    cleandir();
+    BOOT_END(boot);
+  }
+
+  if (!boot_done(boot_eth))
+  {
+    mnu->SetScreen("NETWORK....");
+    while (!boot_done(boot_eth))
+      Thread::wait(10);
+  }
+  eth = EthDone(&eth_connect);
+  if (eth_connect.result != 0)
+  {
+    mnu->SetScreen("NO NETWORK....");
+    wait(2.0);
+  }
+  eth_speed=1;
+      
+  printf("SERVER...\n");
+  srv = new TFTPServer(cfg->port);
   mnu->SetScreen("");  
+  boot_print();
 
   if (cfg->nodisplay) {
     printf("No display set\n\r");
@@ -173,8 +220,19 @@ int main()
   }
 }
 
+// Connect the network, then mark the boot phase as done. Only the network:
+// main() prints the result and stores the address in cfg (EthDone)
+static void eth_thread(void const *arg)
+{
+  EthConnect((tEthConnect *)arg);
+  BOOT_END(boot_eth);
+}
+
+// Without a display: run each received job once and delete it. With
+// sys.queue, received jobs are queued and run in order, with their repeat
+// counts; sys.queue 2 waits for the cover to be opened and closed before
+// each job. A job is deleted after its last run.
 void main_nodisplay() {
-  float x, y, z = 0;
   led1=led2=led3=led4=0;
   
   // main loop  
@@ -182,67 +240,231 @@ void main_nodisplay() {
   {  
     int filecnt = srv->fileCnt();
     mnu->SetScreen("Wait for file ...");
-    while (srv->State() == listen)
+    do {
         srv->poll();
+        log_flush();
+    } while (srv->State() == listen && !(cfg->queue && queue_count()));
     if (srv->State() != listen) {
       mnu->SetScreen("Receive file");
       while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
     }
     if (filecnt < srv->fileCnt()) {
-      mot->reset();
-      plan_get_current_position_xyz(&x, &y, &z);
-       printf("%f %f\n", x,y); 
-       mnu->SetScreen("Laser BUSY..."); 
-    
        char name[32];
        srv->getFilename(name);
-       printf("Now processing file: '%s'\n\r", name);
-       FILE *in = sd.openfile(name, "r");
-       while (!feof(in))
-       { 
-         while (!mot->ready() );
-         mot->write(readint(in));
-       }
-       fclose(in);
-       removefile(name);
-       // done
-       printf("DONE!...\n");
-	   while (!mot->ready() );
-       mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
+       if (cfg->queue && isLaosFile(name))
+         queue_add(name);
+       else
+         nodisplay_job(name, true);
+    }
+    tQueueEntry e;
+    if (cfg->queue && srv->State() == listen && queue_head(&e)) {
+      if (cfg->queue == 2) {
+        mnu->SetScreen("WAIT FOR COVER....");
+        while ( mot->isStart() );
+        while ( !mot->isStart() );
+      }
+      nodisplay_job(e.name, e.runs == 1);
+      queue_done(e.name);
     }
   }
 }
 
-void main_menu() {
-  // main loop  
-  led1=led2=led3=led4=0;
-                
-  mnu->SetScreen(1);
-  while (1) {
-    int filecnt = srv->fileCnt();
-    mnu->Handle();
-    srv->poll();
-    if (srv->State() != listen) {
-      mnu->SetScreen("Receive file");
-	  while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
-    }
-    if (filecnt < srv->fileCnt()) {
-      char myname[32];
-      srv->getFilename(myname);
-      if (isFirmware(myname)) {
-        installFirmware(myname);
+// Run a job without a display, and delete it if 'remove'
+static void nodisplay_job(char *name, bool remove) {
+  float x, y, z = 0;
+  mot->reset();
+  plan_get_current_position_xyz(&x, &y, &z);
+  printf("%f %f\n", x,y); 
+  mnu->SetScreen("Laser BUSY..."); 
+
+  printf("Now processing file: '%s'\n\r", name);
+  FILE *in = sd.openfile(name, "r");
+  if (in == NULL)
+    return;
+  while (!feof(in))
+  { 
+    while (!mot->ready() )
+      log_flush(1);
+    mot->write(readint(in));
+  }
+  fclose(in);
+  if (remove)
+    removefile(name);
+  // done
+  printf("DONE!...\n");
+  while (!mot->ready() );
+  mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
+}
+
+// Main loop tasks, see LaosSched.h
+static int feed_ready() { return mnu->Feeding(); }
+static void feed_run() { mnu->Feed(); }
+static void ui_run() { dsp->PollKeys(); mnu->Handle(); } // keys are sampled here, also while the feeder waits
+static int prefetch_ready() { return prefetch_room(); }
+static void prefetch_run() { prefetch_fill(); }
+static int log_ready() { return log_pending(); }
+static void log_run() { log_flush(plan_queue_empty() ? 4 : 1); } // one message at a time while a job runs
+
+// Reorder the paths of a received job for less travel (sys.optimize). The
+// optimize task does a few commands per run, so the keys and the network
+// keep working. The result goes to OPTIMIZE_FILE and only replaces the job,
+// by a rename, if it is shorter and every write succeeded; a job that starts
+// in the meantime, or a new upload of the same file, cancels it and the
+// original stays.
+static LaosOptimize *opt = NULL;
+static FILE *opt_in, *opt_copy, *opt_out;
+static char opt_name[32];
+
+static void file_received(char *name, bool running);
+
+// The metadata of the optimized job, from OPTIMIZE_FILE; saved only if it
+// replaced the job
+static void optimize_replace(char *name) {
+  char tmpname[MAXFILESIZE+SHORTFILESIZE+1];
+  sprintf(tmpname, "%s%s", sd.pathname, OPTIMIZE_FILE);
+  LaosJobMeta *meta = new LaosJobMeta();
+  FILE *in = fopen(tmpname, "rb");
+  bool ok = (meta != NULL && in != NULL);
+  if (ok) {
+    char buf[256];
+    int n;
+    meta->Start(name);
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+      meta->Put(buf, n);
+    ok = !ferror(in);
+  }
+  if (in != NULL) fclose(in);
+  if (ok && sd.replacefile(name, OPTIMIZE_FILE) == 0) {
+    meta->Save();
+    prefetch_forget(name);
+    LOGSTR(LOG_LEVEL_INFO, LOG_FILE, "Optimized %s: travel %d mm, was %d mm\n", name,
+      (int)opt->GetTravelAfter(), (int)opt->GetTravelBefore());
+  } else {
+    LOGSTR(LOG_LEVEL_WARN, LOG_FILE, "Optimize %s: could not replace the job\n", name);
+  }
+  delete meta;
+}
+
+// Close the files, replace the job if 'finish' and the result is better,
+// and clean up
+static void optimize_stop(bool finish) {
+  bool better = finish && opt != NULL && opt->Finish();
+  if (opt_in != NULL) fclose(opt_in);
+  if (opt_copy != NULL) fclose(opt_copy);
+  if (opt_out != NULL && fclose(opt_out) != 0) better = false;
+  opt_in = opt_copy = opt_out = NULL;
+  if (better)
+    optimize_replace(opt_name);
+  char tmpname[MAXFILESIZE+SHORTFILESIZE+1];
+  sprintf(tmpname, "%s%s", sd.pathname, OPTIMIZE_FILE);
+  remove(tmpname);
+  delete opt;
+  opt = NULL;
+}
+
+// Start the optimize task on a job; false if it cannot
+static bool optimize_start(char *name) {
+  char tmpname[MAXFILESIZE+SHORTFILESIZE+1];
+  sprintf(tmpname, "%s%s", sd.pathname, OPTIMIZE_FILE);
+  strcpy(opt_name, name);
+  opt_in = sd.openfile(name, "rb");
+  opt_copy = sd.openfile(name, "rb");
+  opt_out = fopen(tmpname, "wb");
+  opt = new LaosOptimize();
+  if (opt == NULL || opt_in == NULL || opt_copy == NULL || opt_out == NULL) {
+    optimize_stop(false);
+    return false;
+  }
+  opt->Start(opt_in, opt_copy, opt_out);
+  return true;
+}
+
+static int optimize_ready() { return opt != NULL; }
+
+static void optimize_run() {
+  bool running = mnu->JobRunning();
+  if (!running && opt->Step(LAOSOPTIMIZE_STEP))
+    return;
+  if (running)
+    LOGSTR(LOG_LEVEL_INFO, LOG_FILE, "Optimize %s: cancelled, a job runs\n", opt_name);
+  optimize_stop(!running);
+  file_received(opt_name, mnu->JobRunning());
+}
+
+// A file has been received (and optimized): queue or show a job, install
+// firmware; while a job runs, a job can only be queued
+static void file_received(char *name, bool running) {
+  if (cfg->queue && isLaosFile(name)) {
+    queue_add(name);
+    if (!running)
+      mnu->ShowQueue();
+  } else if (!running) {
+    if (isFirmware(name)) {
+      installFirmware(name);
+      mnu->SetScreen(1);
+    } else {
+      if (strcmp("config.txt", name) == 0) {
+        // it's a config file!
         mnu->SetScreen(1);
       } else {
-        if (strcmp("config.txt", myname) == 0) {
-          // it's a config file!
-          mnu->SetScreen(1);
-        } else {
-          if (isLaosFile(myname)) {
-            mnu->SetFileName(myname);
-            mnu->SetScreen(2);
-          }
+        if (isLaosFile(name)) {
+          mnu->SetFileName(name);
+          mnu->SetScreen(2);
         }
       }
-    }           
+    }
+  }
+}
+
+// TFTP server; a received job is optimized first, if it is not queued
+// behind a running one
+static void net_run() {
+  int filecnt = srv->fileCnt();
+  srv->poll();
+  bool running = mnu->JobRunning();
+  if (!running && srv->State() != listen) {
+    mnu->SetScreen("Receive file");
+    while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
   }
+  if (filecnt < srv->fileCnt()) {
+    char myname[32];
+    srv->getFilename(myname);
+    if (opt != NULL && strcmp(opt_name, myname) == 0)
+      optimize_stop(false); // it was read from the old file
+    if (cfg->optimize && !running && opt == NULL && isLaosFile(myname) && optimize_start(myname))
+      mnu->SetScreen("Optimizing...");
+    else
+      file_received(myname, running);
+  }
+}
+
+static tSchedTask task_feed = { "feed", 2, feed_ready, feed_run, 0 };
+static tSchedTask task_prefetch = { "prefetch", 2, prefetch_ready, prefetch_run, 0 };
+static tSchedTask task_net = { "net", 1, NULL, net_run, 10 };
+static tSchedTask task_ui = { "ui", 1, NULL, ui_run, 20 };
+static tSchedTask task_log = { "log", 1, log_ready, log_run, 50 };
+static tSchedTask task_optimize = { "optimize", 1, optimize_ready, optimize_run, 0 };
+
+static int sched_clock_ms() {
+  return systime.read_ms();
+}
+
+static uint32_t sched_clock_cycles() {
+  return DWT->CYCCNT;
+}
+
+void main_menu() {
+  // main loop  
+  led1=led2=led3=led4=0;
+                
+  mnu->SetScreen(1);
+  sched_set_clock(sched_clock_ms, sched_clock_cycles);
+  sched_add(&task_feed);
+  sched_add(&task_prefetch);
+  sched_add(&task_net);
+  sched_add(&task_ui);
+  sched_add(&task_log);
+  sched_add(&task_optimize);
+  while (1)
+    sched_run();
 }
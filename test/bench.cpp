@@ -0,0 +1,298 @@
+/**
+ * bench.cpp
+ * Motion benchmark: run simplecode jobs through LaosMotion, the planner and
+ * the host stepper in simulated time, and print one line per job:
+ *
+ *   job=<name> values=<n> blocks=<n> time=<sec> steps=<n> sps=<steps/sec>
+ *     plan=<ns/block> underruns=<n> qmin=<n> qavg=<n>
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * time is the simulated job time: the trapezoids of the blocks, plus the
+ * time the stepper waits for the feeder. The feeder costs a fixed time per
+ * value read and per block planned on the controller (-v and -b, in usec),
+ * so the result does not depend on the host. An underrun is the stepper
+ * finishing a block with an empty queue before the job is fed completely.
+ * plan is the host CPU time of plan_buffer_line() per block [nsec]: only
+ * comparable between runs on the same host.
+ *
+ *   bench [-c config.txt] [-v usec_per_value] [-b usec_per_block] [-e] [-o results] job.lgc ...
+ *
+ * The jobs start at 0,0, which is put at x.min, y.min of the config.
+ *
+ * The lines are appended to the results file (-o), like jobstats.sys on the
+ * SD card, or printed between the output of the firmware code.
+ *
+ * With -e each job runs again with the float plan_buffer_line() for the
+ * lines LaosMotion queues in fixed point (plan_buffer_line_um()), and the
+ * line gets float_blocks=<n> float_diff=<steps>: the blocks of the float
+ * run and the largest difference of a block end point between the two.
+ * They may differ by a step (the float version feeds its rounding error
+ * into the next block); bench fails if they differ by more.
+ */
+#include <string>
+#include "motion_host.h"
+
+static double value_cost = 20e-6; // [sec]
+static double block_cost = 200e-6;
+static FILE *out = stdout;
+static bool equivalence = false;
+
+// LaosMotion is built with -Dplan_buffer_line_um=bench_buffer_line: its
+// lines go through here, to the fixed point or the float version
+static bool float_lines = false;
+void bench_buffer_line(tActionRequest *a)
+{
+  if (float_lines)
+    plan_buffer_line(a);
+  else
+    plan_buffer_line_um(a);
+}
+
+// Read the next integer as prefetch_readint() does; false at the end
+static bool read_int(FILE *fp, int *value)
+{
+  int digits = 0, sign = 1, val = 0, c;
+  while ((c = getc(fp)) != EOF)
+  {
+    if (c >= '0' && c <= '9')
+    {
+      if (digits < 16)
+      {
+        val = val * 10 + (c - '0');
+        digits++;
+      }
+    }
+    else if (c == '-')
+      sign = -1;
+    else if (c == ';')
+    {
+      while (c != '\n' && (c = getc(fp)) != EOF)
+        ;
+    }
+    if ((c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == EOF) && digits)
+    {
+      *value = val * sign;
+      return true;
+    }
+  }
+  if (digits)
+    *value = val * sign;
+  return digits > 0;
+}
+
+static bool read_job(const char *name, std::vector<int> &job)
+{
+  FILE *fp = fopen(name, "r");
+  if (fp == NULL)
+    return false;
+  int value;
+  while (read_int(fp, &value))
+    job.push_back(value);
+  fclose(fp);
+  return true;
+}
+
+// Simulated time: the feeder and the stepper run side by side
+static double feed_time;    // the feeder is busy until then [sec]
+static double stepper_time; // the running block ends then [sec]
+static bool running;        // the stepper runs a block
+static bool idle;           // the stepper found the queue empty
+
+// Run the stepper up to 'until'. The newest 'hidden' blocks are still
+// being planned: the stepper does not see them yet.
+static void run_stepper(double until, int hidden)
+{
+  for (;;)
+  {
+    if (running)
+    {
+      if (stepper_time > until)
+        return;
+      st_host_finish();
+      running = false;
+    }
+    if (plan_queue_items() <= hidden)
+    {
+      if (!idle)
+        st_host_idle(); // counted while a job is fed
+      idle = true;
+      return;
+    }
+    if (idle) // the block was queued while the feeder ran
+      stepper_time = max(stepper_time, feed_time);
+    idle = false;
+    stepper_time += st_host_start();
+    running = true;
+  }
+}
+
+// One step of the feeder: a value if LaosMotion is ready for it (ready()
+// may queue blocks itself), or wait for the running block to end
+static void feed(const std::vector<int> &job, size_t *i)
+{
+  uint32_t queued = plan_stats.queued;
+  bool ready = mot->ready();
+  double cost = 0;
+  if (ready && *i < job.size())
+  {
+    mot->write(job[(*i)++]);
+    cost += value_cost;
+  }
+  int added = plan_stats.queued - queued;
+  cost += added * block_cost;
+  run_stepper(feed_time + cost, added);
+  feed_time += cost;
+  if (!ready)
+  {
+    if (!running)
+    {
+      printf("bench: not ready, with an idle stepper\n");
+      exit(1);
+    }
+    feed_time = max(feed_time, stepper_time);
+    run_stepper(feed_time, 0);
+  }
+}
+
+// Run a job in simulated time; st_trace has its blocks
+static void run_job(const std::vector<int> &job)
+{
+  host_power_cycle();
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  mot->setOriginAbsolute(cfg->xmin == (int)GlobalConfig::MINUSVERYLARGE ? 0 : cfg->xmin,
+    cfg->ymin == (int)GlobalConfig::MINUSVERYLARGE ? 0 : cfg->ymin, 0);
+  mot->reset();
+  st_job_start();
+  plan_stats.blocks = 0;
+  plan_stats.cycles = 0;
+  feed_time = stepper_time = 0;
+  running = false;
+  idle = true;
+  size_t i = 0;
+  while (i < job.size())
+    feed(job, &i);
+  while (!mot->ready()) // a curve is queued
+    feed(job, &i);
+  uint32_t queued = plan_stats.queued;
+  mot->queue(); // the line held for merging
+  feed_time += (plan_stats.queued - queued) * block_cost;
+  st_job_end();
+  run_stepper(1e30, 0);
+}
+
+// Largest difference [steps] of the block end points of two runs of a job.
+// Where one run has a block the other does not (a block of a step, or of
+// none), that block is skipped.
+static int32_t trace_diff(const std::vector<tStepTrace> &a, const std::vector<tStepTrace> &b)
+{
+  int32_t worst = 0;
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size())
+  {
+    int32_t d = max(labs(a[i].x - b[j].x), max(labs(a[i].y - b[j].y), labs(a[i].z - b[j].z)));
+    if (d > 1 && i + 1 < a.size() && a[i].steps <= 1)
+      i++;
+    else if (d > 1 && j + 1 < b.size() && b[j].steps <= 1)
+      j++;
+    else
+    {
+      worst = max(worst, d);
+      i++;
+      j++;
+    }
+  }
+  if (i < a.size() || j < b.size()) // the ends must match
+    worst = max(worst, max(labs(a.back().x - b.back().x), labs(a.back().y - b.back().y)));
+  return worst;
+}
+
+// Run a job and print its line; false if the float run differs
+static bool bench(const char *name, const std::vector<int> &job)
+{
+  run_job(job);
+
+  std::string job_name = name;
+  job_name = job_name.substr(job_name.find_last_of('/') + 1);
+  job_name = job_name.substr(0, job_name.find_last_of('.'));
+  uint32_t blocks = st_stats.blocks;
+  fprintf(out, "job=%s values=%u blocks=%u time=%.3f steps=%u sps=%.0f plan=%.0f underruns=%u qmin=%u qavg=%.2f",
+    job_name.c_str(), (unsigned)job.size(), (unsigned)blocks, stepper_time, (unsigned)st_stats.steps,
+    stepper_time > 0 ? st_stats.steps / stepper_time : 0,
+    plan_stats.blocks ? (double)plan_stats.cycles / plan_stats.blocks * 1e9 / SystemCoreClock : 0,
+    (unsigned)st_stats.underruns, (unsigned)(blocks ? st_stats.depth_min : 0),
+    blocks ? (double)st_stats.depth_sum / blocks : 0);
+  int32_t diff = 0;
+  if (equivalence)
+  {
+    std::vector<tStepTrace> fixed = st_trace;
+    float_lines = true;
+    run_job(job);
+    float_lines = false;
+    diff = trace_diff(fixed, st_trace);
+    fprintf(out, " float_blocks=%u float_diff=%d", (unsigned)st_trace.size(), (int)diff);
+  }
+  fprintf(out, "\n");
+  return diff <= 1;
+}
+
+int main(int argc, char **argv)
+{
+  const char *config = "";
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++)
+  {
+    if (!strcmp(argv[i], "-e"))
+      equivalence = true;
+    else if (i + 1 >= argc)
+      break;
+    else if (!strcmp(argv[i], "-c"))
+      config = argv[++i];
+    else if (!strcmp(argv[i], "-v"))
+      value_cost = atof(argv[++i]) * 1e-6;
+    else if (!strcmp(argv[i], "-b"))
+      block_cost = atof(argv[++i]) * 1e-6;
+    else if (!strcmp(argv[i], "-o") && (out = fopen(argv[++i], "a")) == NULL)
+    {
+      printf("%s: cannot open\n", argv[i]);
+      return 1;
+    }
+  }
+  if (i >= argc)
+  {
+    printf("usage: bench [-c config.txt] [-v usec_per_value] [-b usec_per_block] [-e] [-o results] job.lgc ...\n");
+    return 1;
+  }
+  host_init(config);
+  int failed = 0;
+  for (; i < argc; i++)
+  {
+    std::vector<int> job;
+    if (!read_job(argv[i], job))
+    {
+      printf("%s: cannot read\n", argv[i]);
+      return 1;
+    }
+    if (!bench(argv[i], job))
+    {
+      printf("%s: the float version differs by more than a step\n", argv[i]);
+      failed++;
+    }
+  }
+  if (out != stdout)
+    fclose(out);
+  return failed != 0;
+}
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""
+make_corpus.py
+Write the benchmark jobs (simplecode) to a directory: dense text, curves,
+a large raster and a mix of them, within 300 x 150 mm. The jobs are the
+same on every run, so benchmark results can be compared across commits.
+
+  make_corpus.py <directory>
+
+  This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+
+  LaOS is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LaOS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+"""
+import math
+import os
+import random
+import sys
+
+# Simplecode, all coordinates in micron (see LaosMotion.cpp and LaosCurve.h):
+#   0 x y        move, laser off
+#   1 x y        line, laser on
+#   7 100 v      speed [1/100 %]
+#   7 101 p      power [1/100 %]
+#   9 bpp w d..  bitmap for the next line: w pixels in 32 bit words
+#   10/11 x y cx cy  clockwise/counter clockwise arc
+#   13 x1 y1 x2 y2 x y  cubic Bezier
+#   14 n dx dy..     polyline, relative
+
+
+class Job:
+    def __init__(self, name):
+        self.name = name
+        self.lines = ["; %s: LaOS benchmark job, made by make_corpus.py" % name]
+
+    def add(self, *values):
+        self.lines.append(" ".join(str(int(v)) for v in values))
+
+    def speed(self, percent):
+        self.add(7, 100, percent * 100)
+
+    def power(self, percent):
+        self.add(7, 101, percent * 100)
+
+    def move(self, x, y):
+        self.add(0, x, y)
+
+    def line(self, x, y):
+        self.add(1, x, y)
+
+    def polyline(self, x, y, points):
+        """points are absolute; the polyline starts at x, y"""
+        values = [14, len(points)]
+        for px, py in points:
+            values += [px - x, py - y]
+            x, y = px, py
+        self.add(*values)
+
+    def arc(self, x, y, cx, cy, ccw=False):
+        self.add(11 if ccw else 10, x, y, cx, cy)
+
+    def bezier(self, x1, y1, x2, y2, x, y):
+        self.add(13, x1, y1, x2, y2, x, y)
+
+    def bitmap_line(self, x, y, pixels, pitch):
+        """left to right from x, y; pixels: list of 0/1, 1 is laser on"""
+        words = []
+        for i in range(0, len(pixels), 32):
+            word = 0
+            for bit, on in enumerate(pixels[i:i+32]):
+                if on:
+                    word |= 1 << bit
+            words.append(word - (1 << 32) if word >= 1 << 31 else word) # signed, as readint() reads it
+        self.move(x, y)
+        self.add(9, 1, len(pixels), *words)
+        self.line(x + len(pixels) * pitch, y)
+
+    def write(self, directory):
+        with open(os.path.join(directory, self.name + ".lgc"), "w") as f:
+            f.write("\n".join(self.lines) + "\n")
+
+
+def glyphs(rnd, count):
+    """a stroke font: each glyph is 1..4 strokes on a 4x6 grid"""
+    font = []
+    for _ in range(count):
+        strokes = []
+        for _ in range(rnd.randint(1, 4)):
+            points = [(rnd.randint(0, 4), rnd.randint(0, 6)) for _ in range(rnd.randint(2, 6))]
+            strokes.append(points)
+        font.append(strokes)
+    return font
+
+
+def text(job, rnd, x0, y0, columns, rows, size):
+    """rows of random glyphs, 'size' micron high; half of the strokes as polylines"""
+    font = glyphs(rnd, 40)
+    unit = size // 6
+    for row in range(rows):
+        for column in range(columns):
+            gx = x0 + column * unit * 6
+            gy = y0 - row * unit * 9
+            for n, stroke in enumerate(rnd.choice(font)):
+                points = [(gx + px * unit, gy + py * unit) for px, py in stroke]
+                job.move(*points[0])
+                if n % 2:
+                    job.polyline(points[0][0], points[0][1], points[1:])
+                else:
+                    for p in points[1:]:
+                        job.line(*p)
+
+
+def dense_text(rnd):
+    job = Job("dense_text")
+    job.speed(60)
+    job.power(40)
+    text(job, rnd, 5000, 140000, 60, 30, 3000)
+    return job
+
+
+def shapes(job, rnd, x0, y0, columns, rows, pitch):
+    """circles, rounded rectangles, Bezier waves and spirals on a grid"""
+    r = pitch * 2 // 5
+    for row in range(rows):
+        for column in range(columns):
+            cx = x0 + column * pitch + pitch // 2
+            cy = y0 + row * pitch + pitch // 2
+            kind = (row + column) % 4
+            if kind == 0: # circle
+                job.move(cx + r, cy)
+                job.arc(cx + r, cy, cx, cy, rnd.random() < 0.5)
+            elif kind == 1: # rounded rectangle
+                c = r // 3
+                job.move(cx - r + c, cy - r)
+                job.line(cx + r - c, cy - r)
+                job.arc(cx + r, cy - r + c, cx + r - c, cy - r + c, True)
+                job.line(cx + r, cy + r - c)
+                job.arc(cx + r - c, cy + r, cx + r - c, cy + r - c, True)
+                job.line(cx - r + c, cy + r)
+                job.arc(cx - r, cy + r - c, cx - r + c, cy + r - c, True)
+                job.line(cx - r, cy - r + c)
+                job.arc(cx - r + c, cy - r, cx - r + c, cy - r + c, True)
+            elif kind == 2: # wave
+                x, y = cx - r, cy
+                job.move(x, y)
+                for i in range(4):
+                    h = rnd.randint(r // 4, r)
+                    step = r // 2
+                    job.bezier(x + step // 3, y + h, x + 2 * step // 3, y - h, x + step, y)
+                    x += step
+            else: # spiral of half circles
+                job.move(cx, cy)
+                x, ccw = cx, False
+                for i in range(1, 7):
+                    radius = i * r // 7
+                    nx = cx + radius if i % 2 else cx - radius
+                    job.arc(nx, cy, (x + nx) // 2, cy, ccw)
+                    x = nx
+
+
+def curves(rnd):
+    job = Job("curves")
+    job.speed(50)
+    job.power(70)
+    shapes(job, rnd, 0, 0, 16, 9, 15000)
+    return job
+
+
+def image(u, v):
+    """test image, 0..1: rings and a gradient"""
+    r = math.hypot(u - 0.5, v - 0.5)
+    return 0.5 + 0.3 * math.cos(r * 40) * (1 - u) + 0.2 * (v - 0.5)
+
+
+def raster(job, x0, y0, width, height, pitch):
+    """ordered dithering of the test image, one bitmap line per row"""
+    bayer = [[0, 8, 2, 10], [12, 4, 14, 6], [3, 11, 1, 9], [15, 7, 13, 5]]
+    w, h = width // pitch, height // pitch
+    for row in range(h):
+        pixels = [1 if image(col / w, row / h) > (bayer[row % 4][col % 4] + 0.5) / 16 else 0 for col in range(w)]
+        job.bitmap_line(x0, y0 + row * pitch, pixels, pitch)
+
+
+def large_raster(rnd):
+    job = Job("large_raster")
+    job.speed(100)
+    job.power(50)
+    raster(job, 10000, 10000, 100000, 60000, 100)
+    return job
+
+
+def mixed(rnd):
+    job = Job("mixed")
+    job.speed(100)
+    job.power(50)
+    raster(job, 10000, 10000, 40000, 30000, 100)
+    job.speed(60)
+    job.power(40)
+    text(job, rnd, 60000, 145000, 30, 10, 3000)
+    job.speed(50)
+    job.power(70)
+    shapes(job, rnd, 10000, 50000, 8, 4, 12000)
+    job.speed(20) # cut out
+    job.power(100)
+    job.move(5000, 5000)
+    for x, y in ((160000, 5000), (160000, 150000), (5000, 150000), (5000, 5000)):
+        job.line(x, y)
+    return job
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: make_corpus.py <directory>")
+    os.makedirs(sys.argv[1], exist_ok=True)
+    for make in (dense_text, curves, large_raster, mixed):
+        make(random.Random(make.__name__)).write(sys.argv[1])
+
+
+if __name__ == "__main__":
+    main()
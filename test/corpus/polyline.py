@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+polyline.py
+Convert a simplecode job: runs of lines (1 x y) become relative polylines
+(14 n dx dy ..), or with -l every polyline becomes lines again. Prints one
+line per job: the size, the values (tokens) and the values per segment
+(line or polyline vertex), before and after.
+
+  polyline.py [-l] <in.lgc> <out.lgc>
+
+  This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+
+  LaOS is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  LaOS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+"""
+import os
+import sys
+
+# values after the command, see make_corpus.py; 9 and 14 have a count
+ARGS = {0: 2, 1: 2, 2: 1, 4: 3, 5: 0, 7: 2, 10: 4, 11: 4, 13: 6}
+
+
+def read(name):
+    """the values of a job, without comments"""
+    values = []
+    with open(name) as f:
+        for line in f:
+            values += [int(v) for v in line.split(";")[0].split()]
+    return values
+
+
+def commands(values):
+    """split the values in commands: lists of the command and its values"""
+    i = 0
+    while i < len(values):
+        c = values[i]
+        if c == 9:   # 9 bpp width data..
+            n = 2 + (values[i+1] * values[i+2] + 31) // 32
+        elif c == 14:  # 14 n dx dy..
+            n = 1 + 2 * max(values[i+1], 0)
+        elif c in ARGS:
+            n = ARGS[c]
+        else:
+            sys.exit("command %d at value %d: unknown" % (c, i))
+        yield values[i:i+n+1]
+        i += n + 1
+
+
+def segments(cmds):
+    return sum(1 if c[0] == 1 else c[1] if c[0] == 14 else 0 for c in cmds)
+
+
+def to_polylines(cmds):
+    """each run of lines after a known position becomes one polyline. The
+    line after a bitmap (9) is the bitmap line: it stays a line."""
+    out, run = [], []
+    pos, bitmap = None, False
+
+    def flush():
+        if len(run) == 1:
+            out.append([1, run[0][0], run[0][1]])
+        elif run:
+            values = [14, len(run)]
+            x, y = start
+            for px, py in run:
+                values += [px - x, py - y]
+                x, y = px, py
+            out.append(values)
+        del run[:]
+
+    for c in cmds:
+        if c[0] == 1 and pos is not None and not bitmap:
+            if not run:
+                start = pos
+            run.append((c[1], c[2]))
+            pos = (c[1], c[2])
+            continue
+        flush()
+        out.append(c)
+        bitmap = c[0] == 9 or (bitmap and c[0] != 1)
+        if c[0] in (0, 1, 4):
+            pos = (c[1], c[2])
+        elif c[0] in (10, 11, 13):
+            pos = (c[-2], c[-1])
+        elif c[0] == 14 and pos is not None:
+            pos = (pos[0] + sum(c[2::2]), pos[1] + sum(c[3::2]))
+    flush()
+    return out
+
+
+def to_lines(cmds):
+    """each polyline becomes lines to its vertices, unless the first one
+    would be a bitmap line"""
+    out, pos, bitmap = [], None, False
+    for c in cmds:
+        bitmap = c[0] == 9 or (bitmap and c[0] != 1)
+        if c[0] == 14 and pos is not None and not bitmap:
+            x, y = pos
+            for dx, dy in zip(c[2::2], c[3::2]):
+                x, y = x + dx, y + dy
+                out.append([1, x, y])
+            pos = (x, y)
+            continue
+        out.append(c)
+        if c[0] in (0, 1, 4):
+            pos = (c[1], c[2])
+        elif c[0] in (10, 11, 13):
+            pos = (c[-2], c[-1])
+        elif c[0] == 14 and pos is not None:
+            pos = (pos[0] + sum(c[2::2]), pos[1] + sum(c[3::2]))
+    return out
+
+
+def main():
+    args = sys.argv[1:]
+    lines = args[:1] == ["-l"]
+    if lines:
+        args = args[1:]
+    if len(args) != 2:
+        sys.exit("usage: polyline.py [-l] <in.lgc> <out.lgc>")
+    before = list(commands(read(args[0])))
+    after = to_lines(before) if lines else to_polylines(before)
+    with open(args[1], "w") as f:
+        f.write("\n".join(" ".join(str(v) for v in c) for c in after) + "\n")
+    n = segments(before)
+    if n != segments(after):
+        sys.exit("%s: the segments differ" % args[1])
+    size = [os.path.getsize(a) for a in args]
+    count = [sum(len(c) for c in before), sum(len(c) for c in after)]
+    print("job=%s bytes=%d/%d values=%d/%d segments=%d values_per_segment=%.2f/%.2f" % (
+        os.path.splitext(os.path.basename(args[0]))[0], size[0], size[1], count[0], count[1],
+        n, count[0] / max(n, 1), count[1] / max(n, 1)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,178 @@
+/**
+ * motion_host.cpp
+ * Run simplecode jobs through LaosMotion and the planner on the host
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "motion_host.h"
+
+#define AREA 200000 // [micron]
+
+GlobalConfig *cfg = NULL;
+LaosMotion *mot = NULL;
+
+void host_init(const char *config)
+{
+  cfg = new GlobalConfig(config);
+  cfg->dryrun = 1;
+  cfg->zhome = 0;
+  host_power_cycle();
+}
+
+void host_power_cycle()
+{
+  extern int power;
+  power = 10000; // its initial value: the LaosMotion constructor leaves it
+  delete mot;
+  st_host_reset();
+  mot = new LaosMotion();
+}
+
+size_t host_feed(const std::vector<int> &job, size_t from, size_t to, tFeedHook hook)
+{
+  size_t i = from;
+  while (i < to)
+  {
+    if (mot->ready())
+      mot->write(job[i++]);
+    else if (!st_host_run())
+    {
+      printf("host_feed: not ready, with an empty queue\n");
+      exit(1);
+    }
+    if (hook && !hook(i))
+      break;
+  }
+  return i;
+}
+
+bool host_end_job(tFeedHook hook)
+{
+  while (!mot->ready())
+  {
+    st_host_run();
+    if (hook && !hook(0))
+      return false;
+  }
+  mot->queue(); // flush
+  return true;
+}
+
+bool host_drain(tFeedHook hook, size_t next)
+{
+  while (st_host_run())
+  {
+    if (hook && !hook(next))
+      return false;
+  }
+  return true;
+}
+
+static int rnd(int lo, int hi)
+{
+  return lo + rand() % (hi - lo + 1);
+}
+
+static int clamp(int v)
+{
+  return v < 0 ? 0 : (v > AREA ? AREA : v);
+}
+
+static void add(std::vector<int> &job, int a, int b)
+{
+  job.push_back(a);
+  job.push_back(b);
+}
+
+void host_random_job(std::vector<int> &job, int commands)
+{
+  int x = 0, y = 0;
+  job.push_back(0);
+  add(job, x, y);
+  for (int c = 0; c < commands; c++)
+  {
+    int r = rand() % 100;
+    if (r < 25) // line
+    {
+      x = clamp(x + rnd(-20000, 20000));
+      y = clamp(y + rnd(-20000, 20000));
+      job.push_back(1);
+      add(job, x, y);
+    }
+    else if (r < 35) // move
+    {
+      x = rnd(0, AREA);
+      y = rnd(0, AREA);
+      job.push_back(0);
+      add(job, x, y);
+    }
+    else if (r < 45) // speed and power
+    {
+      job.push_back(7);
+      add(job, 100, rnd(100, 10000));
+      job.push_back(7);
+      add(job, 101, rnd(0, 10000));
+    }
+    else if (r < 60) // polyline
+    {
+      int n = rnd(1, 20);
+      job.push_back(14);
+      job.push_back(n);
+      for (int i = 0; i < n; i++)
+      {
+        int dx = clamp(x + rnd(-3000, 3000)) - x, dy = clamp(y + rnd(-3000, 3000)) - y;
+        if (abs(dx) < 50 && abs(dy) < 50) dx = (x < AREA/2) ? 50 : -50; // not shorter than a step
+        x += dx;
+        y += dy;
+        add(job, dx, dy);
+      }
+    }
+    else if (r < 70) // arc, around a center in the area
+    {
+      int cx = clamp(x + rnd(-20000, 20000)), cy = clamp(y + rnd(-20000, 20000));
+      double radius = sqrt((double)(x-cx)*(x-cx) + (double)(y-cy)*(y-cy));
+      double a = rnd(0, 359) * M_PI / 180;
+      x = clamp(cx + (int)(radius * cos(a)));
+      y = clamp(cy + (int)(radius * sin(a)));
+      job.push_back(rnd(10, 11));
+      add(job, x, y);
+      add(job, cx, cy);
+    }
+    else if (r < 80) // Bezier
+    {
+      job.push_back(13);
+      for (int i = 0; i < 3; i++)
+      {
+        x = clamp(x + rnd(-20000, 20000));
+        y = clamp(y + rnd(-20000, 20000));
+        add(job, x, y);
+      }
+    }
+    else // bitmap line, 0.1 mm pixels
+    {
+      int width = rnd(8, 600);
+      if (x + width * 100 > AREA) x = AREA - width * 100;
+      job.push_back(9);
+      add(job, 1, width);
+      for (int i = 0; i < (width + 31) / 32; i++)
+        job.push_back(rand() ^ (rand() << 16));
+      x += width * 100;
+      job.push_back(1);
+      add(job, x, y);
+    }
+  }
+}
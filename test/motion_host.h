@@ -0,0 +1,60 @@
+/**
+ * motion_host.h
+ * Run simplecode jobs through LaosMotion and the planner on the host, with
+ * the stepper of stepper_host.h
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MOTION_HOST_H
+#define MOTION_HOST_H
+
+#include <vector>
+#include "global.h"
+#include "LaosMotion.h"
+#include "stepper_host.h"
+
+extern GlobalConfig *cfg;
+extern LaosMotion *mot;
+
+// Called after each value written and each block executed, with the index
+// of the next value to write. Return false to stop feeding.
+typedef bool (*tFeedHook)(size_t next);
+
+// Read the configuration (no file: all defaults), with sys.dryrun on and
+// z.home 0, and boot
+void host_init(const char *config = "");
+
+// Boot again: a new LaosMotion and a reset stepper. The trace is cleared.
+void host_power_cycle();
+
+// Write job[from..to) the way LaosMenu::Feed() does: the next value when
+// LaosMotion is ready for it, otherwise the stepper executes a block.
+// Returns the index of the next value (to, unless the hook stopped it).
+size_t host_feed(const std::vector<int> &job, size_t from, size_t to, tFeedHook hook = NULL);
+
+// End of the job: wait until LaosMotion is ready (a curve is queued) and
+// queue the line held for merging. Returns false if the hook stopped it.
+bool host_end_job(tFeedHook hook = NULL);
+
+// Execute all queued blocks. Returns false if the hook stopped it.
+bool host_drain(tFeedHook hook = NULL, size_t next = 0);
+
+// A random job [micron] in a 200x200 mm area, starting with a move to 0,0:
+// moves, lines, speed and power settings, polylines, arcs, Bezier curves
+// and bitmap lines
+void host_random_job(std::vector<int> &job, int commands);
+
+#endif
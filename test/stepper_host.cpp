@@ -0,0 +1,273 @@
+/**
+ * stepper_host.cpp
+ * Host stand-in for the stepper
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "mbed.h"
+#include "global.h"
+#include "stepper_host.h"
+#include "ramp.h"
+
+volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e;
+volatile tStepperStats st_stats;
+std::vector<tStepTrace> st_trace;
+double st_time = 0;
+bool st_host_steps = false;
+std::vector<tStepEvent> st_steps;
+void (*st_host_busy)() = NULL;
+uint32_t st_host_changed = 0;
+
+tHostSwitch st_switch[3];
+
+static int job_active = 0;
+static int power_override = 100; // [%]
+static block_t current; // the block being executed, as it was when it started
+
+extern unsigned long bitmap[], bitmap_size;
+
+// checksum of the bitmap line the stepper reads
+static uint32_t bitmap_sum()
+{
+  uint32_t sum = 2166136261u;
+  for (unsigned long i = 0; i < bitmap_size; i++)
+    sum = (sum ^ (uint32_t)bitmap[i]) * 16777619u;
+  return sum;
+}
+
+// Time to run the trapezoid of a block [sec], rates in [steps/sec]
+static double block_time(const block_t *b)
+{
+  double n = b->step_event_count;
+  double a = b->rate_delta * ACCELERATION_TICKS_PER_SECOND / 60.0; // [steps/sec2]
+  double vmin = MINIMUM_STEPS_PER_MINUTE / 60.0;
+  double vi = max(b->initial_rate / 60.0, vmin);
+  double vn = max(b->nominal_rate / 60.0, vmin);
+  double vf = max(b->final_rate / 60.0, vmin);
+  double up = min((double)b->accelerate_until, n);
+  double down = max(min((double)b->decelerate_after, n), up);
+  double t = 0, v = vi;
+  if (a > 0 && up > 0)
+  {
+    v = min(vn, sqrt(vi*vi + 2*a*up));
+    t += (v - vi) / a;
+  }
+  t += (down - up) / v;
+  if (a > 0 && n > down)
+  {
+    double v2 = sqrt(max(vf*vf, v*v - 2*a*(n - down)));
+    t += (v - v2) / a;
+  }
+  return t;
+}
+
+static int switch_pressed(int axis, int32_t pos)
+{
+  const tHostSwitch &s = st_switch[axis];
+  return s.stuck || !s.dir || (s.dir > 0 ? pos >= s.at : pos <= s.at);
+}
+
+// A homing block, step by step as the step interrupt does it: an axis
+// stops on its switch, the block ends when all moving axes have stopped.
+// Returns the step events done.
+static uint32_t home_steps(const block_t *b)
+{
+  uint32_t steps[3] = { b->steps_x, b->steps_y, b->steps_z };
+  int dirbit[3] = { X_DIRECTION_BIT, Y_DIRECTION_BIT, Z_DIRECTION_BIT };
+  volatile int32_t *pos[3] = { &actpos_x, &actpos_y, &actpos_z };
+  int32_t counter[3];
+  unsigned mask = 0, hit = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    counter[i] = -(b->step_event_count >> 1);
+    if (steps[i]) mask |= 1 << i;
+  }
+  uint32_t n;
+  for (n = 0; n < b->step_event_count && hit != mask; n++)
+  {
+    for (int i = 0; i < 3; i++)
+      if ((mask & (1 << i)) && switch_pressed(i, *pos[i]))
+        hit |= 1 << i;
+    for (int i = 0; i < 3; i++)
+    {
+      counter[i] += steps[i];
+      if (counter[i] > 0)
+      {
+        if (!(hit & (1 << i)))
+          *pos[i] += (b->direction_bits & (1 << dirbit[i])) ? -1 : 1;
+        counter[i] -= b->step_event_count;
+      }
+    }
+  }
+  return n;
+}
+
+// Time of a block from its step events [sec], as the step interrupt runs
+// it: the period after each step event is set by ramp_step(), the last one
+// keeps the period of the step event before it
+static double ramp_time(const block_t *block)
+{
+  extern GlobalConfig *cfg;
+  block_t b = *block; // ramp_reset() sets decelerate_after
+  tRampGen g;
+  memset(&g, 0, sizeof(g));
+  ramp_reset(&g, &b, cfg->scurve);
+  double t = 0;
+  float mm = b.millimeters / b.step_event_count;
+  for (uint32_t i = 1; i <= b.step_event_count; i++)
+  {
+    if (i < b.step_event_count)
+      ramp_step(&g, &b, i);
+    tStepEvent e = { (float)to_int(g.c), g.c / 1024.0f, mm };
+    st_steps.push_back(e);
+    t += e.period;
+  }
+  return t * 1e-6;
+}
+
+void st_init()
+{
+  job_active = 0;
+}
+
+void st_host_reset()
+{
+  st_trace.clear();
+  st_steps.clear();
+  st_time = 0;
+  st_host_changed = 0;
+  memset((void*)&st_stats, 0, sizeof(st_stats));
+  actpos_x = actpos_y = actpos_z = actpos_e = 0;
+  job_active = 0;
+  power_override = 100;
+}
+
+double st_host_start()
+{
+  block_t *b = plan_get_current_block();
+  if (b == NULL)
+    return -1;
+  current = *b;
+  b = &current;
+  st_stats.started++;
+  if (job_active)
+  {
+    uint32_t depth = plan_queue_items(); // including this block
+    st_stats.blocks++;
+    st_stats.depth_sum += depth;
+    if (depth < st_stats.depth_min) st_stats.depth_min = depth;
+  }
+  uint32_t done = b->step_event_count;
+  if (b->check_endstops)
+    done = home_steps(b);
+  else if (b->action_type != AT_WAIT)
+  {
+    actpos_x += (b->direction_bits & (1<<X_DIRECTION_BIT)) ? -(int32_t)b->steps_x : b->steps_x;
+    actpos_y += (b->direction_bits & (1<<Y_DIRECTION_BIT)) ? -(int32_t)b->steps_y : b->steps_y;
+    actpos_z += (b->direction_bits & (1<<Z_DIRECTION_BIT)) ? -(int32_t)b->steps_z : b->steps_z;
+    actpos_e += (b->direction_bits & (1<<E_DIRECTION_BIT)) ? -(int32_t)b->steps_e : b->steps_e;
+  }
+  tStepTrace s;
+  double mm_per_step = b->step_event_count ? b->millimeters / b->step_event_count : 0;
+  s.x = actpos_x;
+  s.y = actpos_y;
+  s.z = actpos_z;
+  s.steps = b->step_event_count;
+  s.options = b->options;
+  s.power = b->power;
+  s.bitmap = (b->options & OPT_BITMAP) ? bitmap_sum() : 0;
+  s.entry = b->initial_rate / 60.0 * mm_per_step;
+  s.exit = b->final_rate / 60.0 * mm_per_step;
+  s.nominal = b->nominal_rate / 60.0 * mm_per_step;
+  s.accel = b->rate_delta * ACCELERATION_TICKS_PER_SECOND / 60.0 * mm_per_step;
+  s.accel_max = b->acceleration;
+  s.mm = b->millimeters;
+  if (st_host_steps && !b->check_endstops && b->action_type == AT_MOVE && b->step_event_count)
+    s.time = ramp_time(b);
+  else
+    s.time = b->step_event_count ? block_time(b) * done / b->step_event_count : 0; // a homing block: roughly
+  st_time += s.time;
+  st_trace.push_back(s);
+  return s.time;
+}
+
+void st_host_finish()
+{
+  // the stepper reads the block while it runs: it must stay the same
+  if (memcmp(&current, plan_get_current_block(), sizeof(current)) != 0)
+    st_host_changed++;
+  if (job_active) st_stats.steps += current.step_event_count;
+  plan_discard_current_block();
+}
+
+int st_host_run()
+{
+  if (st_host_start() < 0)
+    return 0;
+  if (st_host_busy)
+    st_host_busy();
+  st_host_finish();
+  return 1;
+}
+
+void st_host_idle()
+{
+  if (job_active) st_stats.underruns++;
+}
+
+void st_host_drain()
+{
+  while (st_host_run());
+}
+
+void st_synchronize()
+{
+  st_host_drain();
+}
+
+void st_wake_up()
+{
+}
+
+void st_job_start()
+{
+  st_stats.underruns = 0;
+  st_stats.blocks = 0;
+  st_stats.steps = 0;
+  st_stats.depth_sum = 0;
+  st_stats.depth_min = 0xffffffff;
+  job_active = 1;
+}
+
+void st_job_end()
+{
+  job_active = 0;
+}
+
+void st_set_power_override(int percent)
+{
+  power_override = max(OVERRIDE_MIN, min(OVERRIDE_MAX, percent));
+}
+
+int st_get_power_override()
+{
+  return power_override;
+}
+
+int hit_home_stop_x(int axis) { return switch_pressed(0, actpos_x); }
+int hit_home_stop_y(int axis) { return switch_pressed(1, actpos_y); }
+int hit_home_stop_z(int axis) { return switch_pressed(2, actpos_z); }
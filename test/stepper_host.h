@@ -0,0 +1,101 @@
+/**
+ * stepper_host.h
+ * Host stand-in for the stepper: executes the planned blocks one at a time,
+ * records what it would output and how long that would take
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * It implements stepper.h, so LaosMotion and the planner link against it
+ * unchanged. Nothing runs by itself: the test calls st_host_run() where
+ * the step interrupt would take the next block.
+ */
+#ifndef STEPPER_HOST_H
+#define STEPPER_HOST_H
+
+#include <vector>
+#include "planner.h"
+#include "stepper.h"
+
+// One executed block
+typedef struct {
+  int32_t x, y, z;     // position at the end [steps]
+  uint32_t steps;      // step events
+  uint8_t options;     // OPT_LASER_ON, OPT_BITMAP
+  uint16_t power;      // laser power setpoint [0..10000]
+  uint32_t bitmap;     // checksum of the bitmap line of an OPT_BITMAP block, else 0
+  float entry, exit;   // speed at the start and the end [mm/sec]
+  float nominal;       // plateau speed [mm/sec]
+  float accel;         // acceleration of the ramps [mm/sec2]
+  float accel_max;     // acceleration limit of the block [mm/sec2]
+  float mm;            // length [mm]
+  double time;         // time to execute it [sec]
+} tStepTrace;
+
+// The executed blocks, oldest first
+extern std::vector<tStepTrace> st_trace;
+
+// Simulated time of the executed blocks [sec]
+extern double st_time;
+
+// One step event, when st_host_steps is set: the blocks are timed step by
+// step with the trapezoid generator of the step interrupt (ramp.h), and
+// st_time is the sum of the step periods
+typedef struct {
+  float period;        // time to the next step event, as the step timer runs it [usec]
+  float c;             // the same, before it is rounded to the timer [usec]
+  float mm;            // length of the step event [mm]
+} tStepEvent;
+extern bool st_host_steps;
+extern std::vector<tStepEvent> st_steps;
+
+// Called by st_host_run() while a block executes: the stepper has taken
+// it, and it is still in the queue
+extern void (*st_host_busy)();
+
+// Blocks that changed while they were executed (the planner must not touch
+// them once the stepper has taken them)
+extern uint32_t st_host_changed;
+
+// Virtual home switches, per axis (0: x, 1: y, 2: z): pressed while the
+// position [steps] is at 'at' or beyond it in direction 'dir' (-1, 1), or
+// always if it is 'stuck'. With dir 0 (the default) a switch is always
+// pressed. A homing block (AT_MOVE_ENDSTOP) stops each axis on its switch.
+typedef struct {
+  int32_t at;
+  int dir;
+  bool stuck;
+} tHostSwitch;
+extern tHostSwitch st_switch[3];
+
+// Forget the trace, the time and the statistics (a power cycle)
+void st_host_reset();
+
+// Execute the oldest queued block: returns 0 if the queue is empty
+int st_host_run();
+
+// The same in two steps: the stepper takes the oldest block and returns
+// the time it takes [sec], or -1 if the queue is empty. The block stays in
+// the queue until st_host_finish().
+double st_host_start();
+void st_host_finish();
+
+// The queue is empty while a job is fed: count an underrun
+void st_host_idle();
+
+// Execute all queued blocks
+void st_host_drain();
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * ConfigFile.cpp
+ * Host stand-in for the config file reader
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ConfigFile.h"
+
+// "key value ; comment" per line; the first occurrence of a key wins
+ConfigFile::ConfigFile(const char *name)
+{
+  FILE *fp = fopen(name, "r");
+  m_Open = (fp != NULL);
+  if (fp == NULL)
+    return;
+  char line[256], key[64], value[64];
+  while (fgets(line, sizeof(line), fp))
+  {
+    char *comment = strchr(line, ';');
+    if (comment) *comment = 0;
+    if (sscanf(line, "%63s %63s", key, value) == 2 && m_Values.find(key) == m_Values.end())
+      m_Values[key] = value;
+  }
+  fclose(fp);
+}
+
+bool ConfigFile::Value(const char *key, char *value, size_t maxlen, const char *def)
+{
+  std::map<std::string, std::string>::const_iterator i = m_Values.find(key);
+  strncpy(value, i == m_Values.end() ? def : i->second.c_str(), maxlen);
+  value[maxlen-1] = 0;
+  return i != m_Values.end();
+}
+
+bool ConfigFile::Value(const char *key, int *value, int def)
+{
+  std::map<std::string, std::string>::const_iterator i = m_Values.find(key);
+  *value = (i == m_Values.end()) ? def : atoi(i->second.c_str());
+  return i != m_Values.end();
+}
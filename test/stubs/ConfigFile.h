@@ -0,0 +1,39 @@
+/**
+ * ConfigFile.h
+ * Host stand-in for the config file reader: the same file format, read
+ * with the C library. Without a file every key gets its default.
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _CONFIG_FILE_H_
+#define _CONFIG_FILE_H_
+
+#include <map>
+#include <string>
+
+class ConfigFile {
+public:
+  ConfigFile(const char *name);
+  bool Value(const char *key, char *value, size_t maxlen, const char *def);
+  bool Value(const char *key, int *value, int def);
+  bool IsOpen(void) { return m_Open; }
+
+private:
+  bool m_Open;
+  std::map<std::string, std::string> m_Values;
+};
+
+#endif
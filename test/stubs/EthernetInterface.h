@@ -0,0 +1,87 @@
+/**
+ * EthernetInterface.h
+ * Host stand-in for the mbed network library: a UDP socket that receives
+ * the packets a test queued in udp_in, and records what it sends in udp_out,
+ * and an interface that connects when the test lets it
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ETHERNETINTERFACE_H
+#define ETHERNETINTERFACE_H
+
+#include <string.h>
+#include <unistd.h>
+#include <deque>
+#include <string>
+
+// the one client
+class Endpoint {
+public:
+  Endpoint() { strcpy(m_Address, "10.0.0.2"); }
+  char* get_address() { return m_Address; }
+  int get_port() { return 1234; }
+private:
+  char m_Address[17];
+};
+
+extern std::deque<std::string> udp_in;  // packets to receive, in order
+extern std::deque<std::string> udp_out; // packets sent
+
+class UDPSocket {
+public:
+  int bind(int port) { return 0; }
+  void set_blocking(bool blocking, unsigned int timeout = 1500) {}
+  int close() { return 0; }
+  int receiveFrom(Endpoint &remote, char *buffer, int length)
+  {
+    if (udp_in.empty())
+      return 0;
+    int n = udp_in.front().size() < (size_t)length ? udp_in.front().size() : length;
+    memcpy(buffer, udp_in.front().data(), n);
+    udp_in.pop_front();
+    return n;
+  }
+  int sendTo(Endpoint &remote, char *packet, int length)
+  {
+    udp_out.push_back(std::string(packet, length));
+    return length;
+  }
+};
+
+extern volatile int eth_hold;     // connect() waits while set
+extern int eth_result;            // what connect() returns
+extern unsigned int eth_timeout;  // what connect() was given
+
+class EthernetInterface {
+public:
+  EthernetInterface() { strcpy(m_Ip, "0.0.0.0"); }
+  int init() { strcpy(m_Ip, "10.0.0.7"); return 0; } // DHCP
+  int init(const char *ip, const char *mask, const char *gateway) { strcpy(m_Ip, ip); return 0; }
+  int connect(unsigned int timeout_ms = 15000)
+  {
+    eth_timeout = timeout_ms;
+    while (eth_hold)
+      usleep(1000);
+    return eth_result;
+  }
+  char* getIPAddress() { return m_Ip; }
+  char* getNetworkMask() { return (char *)"255.255.255.0"; }
+  char* getGateway() { return (char *)"10.0.0.1"; }
+private:
+  char m_Ip[17];
+};
+
+#endif
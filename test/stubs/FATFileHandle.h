@@ -0,0 +1,66 @@
+/**
+ * FATFileHandle.h
+ * Host stand-in for the FAT file handle: a C library file, with counters of
+ * the writes, and a card that can be full
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MBED_FATFILEHANDLE_H
+#define MBED_FATFILEHANDLE_H
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+typedef struct {
+  int writes;       // write() calls
+  int unaligned;    // writes that do not start at, or are not, whole sectors
+  long bytes;       // written
+  long room;        // free space on the card [bytes], < 0: no limit
+} tFatStats;
+
+extern tFatStats fat_stats;
+
+class FATFileHandle {
+public:
+  FATFileHandle(FILE *fp) : m_File(fp), m_Pos(0) {}
+  int close()
+  {
+    int r = fclose(m_File);
+    delete this;
+    return r;
+  }
+  ssize_t write(const void* buffer, size_t length)
+  {
+    fat_stats.writes++;
+    if ((m_Pos % 512) || (length % 512))
+      fat_stats.unaligned++;
+    if (fat_stats.room >= 0 && (long)length > fat_stats.room)
+      return -1;
+    if (fat_stats.room >= 0)
+      fat_stats.room -= length;
+    size_t n = fwrite(buffer, 1, length, m_File);
+    fat_stats.bytes += n;
+    m_Pos += n;
+    return n;
+  }
+  int preallocate(unsigned long size) { return fat_stats.room >= 0 && (long)size > fat_stats.room ? -1 : 0; }
+private:
+  FILE *m_File;
+  long m_Pos;
+};
+
+#endif
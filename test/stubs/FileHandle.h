@@ -0,0 +1,43 @@
+/**
+ * FileHandle.h
+ * Host stand-in for the mbed file handle interface, for the real
+ * FATFileHandle of test_fat
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MBED_FILEHANDLE_H
+#define MBED_FILEHANDLE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+namespace mbed {
+
+class FileHandle {
+public:
+  virtual ~FileHandle() {}
+  virtual ssize_t write(const void *buffer, size_t length) = 0;
+  virtual int close() = 0;
+  virtual ssize_t read(void *buffer, size_t length) = 0;
+  virtual int isatty() = 0;
+  virtual off_t lseek(off_t offset, int whence) = 0;
+  virtual int fsync() = 0;
+  virtual off_t flen() = 0;
+};
+
+}
+
+#endif
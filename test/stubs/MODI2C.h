@@ -0,0 +1,80 @@
+/**
+ * MODI2C.h
+ * Host stand-in for the non-blocking I2C driver: writes are recorded, and
+ * complete at once, or never (i2c_hang); reads return i2c_key at once,
+ * after using the CPU for i2c_read_ns (the interrupts of a transfer).
+ * Build with -include: the guard is the one of the real header, which
+ * LaosDisplay.cpp includes from its own directory.
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MODI2C_H
+#define MODI2C_H
+
+#include <string>
+#include <vector>
+#include "mbed.h"
+
+#define I2C_ABORTED 0xF8
+
+extern std::vector<std::string> i2c_writes; // the data of each write
+extern bool i2c_hang;                       // writes do not finish
+extern int i2c_status;                      // status of a finished write
+extern int i2c_aborts;
+extern int i2c_reads;                       // reads started
+extern char i2c_key;                        // what a read returns
+extern int i2c_read_ns;                     // CPU time a read takes [nsec]
+
+class MODI2C {
+public:
+  MODI2C(PinName sda, PinName scl) : m_Pending(NULL) {}
+  void frequency(int hz) {}
+  int read(int address, char *data, int length, bool repeated = false)
+  {
+    memset(data, 0, length);
+    return 0;
+  }
+  int read_nb(int address, char *data, int length, bool repeated = false, int *status = NULL)
+  {
+    i2c_reads++;
+    for (uint32_t t = host_cycles(); host_cycles() - t < (uint32_t)i2c_read_ns; )
+      ;
+    memset(data, i2c_key, length);
+    if (status != NULL)
+      *status = 0x58;
+    return 0;
+  }
+  int write(int address, char *data, int length, bool repeated = false, int *status = NULL)
+  {
+    i2c_writes.push_back(std::string(data, length));
+    if (status != NULL)
+      *status = i2c_hang ? 0 : i2c_status;
+    m_Pending = i2c_hang ? status : NULL;
+    return 0;
+  }
+  int getQueue() { return m_Pending != NULL; }
+  void abort()
+  {
+    i2c_aborts++;
+    if (m_Pending != NULL)
+      *m_Pending = I2C_ABORTED;
+    m_Pending = NULL;
+  }
+private:
+  int *m_Pending;
+};
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * laosfilesystem.h
+ * Host stand-in for the SD file system: the name sizes, and a card that is
+ * a directory of the host. Files are opened with the C library, by their
+ * full path; LaosFileSystem::openfile() takes the long name in pathname.
+ * openhandle() gives the FATFileHandle stand-in. A test can replace the
+ * fopen() of openfile() with 'open', e.g. with a slow card.
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _LAOSFILESYSTEM_
+#define _LAOSFILESYSTEM_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "FATFileHandle.h"
+
+#define MAXFILESIZE 21
+#define SHORTFILESIZE 13
+
+class LaosFileSystem {
+public:
+  LaosFileSystem() : open(fopen) { pathname[0] = 0; }
+  FILE* openfile(char* name, const char *mode)
+  {
+    char fullname[MAXFILESIZE+2+256];
+    snprintf(fullname, sizeof(fullname), "%s%s", pathname, name);
+    return open(fullname, mode);
+  }
+  FATFileHandle* openhandle(char* name, int flags)
+  {
+    FILE *fp = openfile(name, (flags & O_CREAT) ? "wb" : "rb");
+    return fp == NULL ? NULL : new FATFileHandle(fp);
+  }
+  void shorten(char* name, int max)
+  {
+    if ((int)strlen(name) > max-1)
+      name[max-1] = 0;
+  }
+  char pathname[MAXFILESIZE+2]; // the directory, with a trailing '/'
+  FILE* (*open)(const char *path, const char *mode);
+};
+
+inline void removefile(char *name)
+{
+  extern LaosFileSystem sd;
+  char fullname[MAXFILESIZE+2+256];
+  snprintf(fullname, sizeof(fullname), "%s%s", sd.pathname, name);
+  unlink(fullname);
+}
+
+inline int isFirmware(char *name)
+{
+  const char *ext = strrchr(name, '.');
+  return ext != NULL && !strcmp(ext, ".bin");
+}
+
+#endif
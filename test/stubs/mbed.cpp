@@ -0,0 +1,38 @@
+/**
+ * mbed.cpp
+ * Host stand-in for the mbed library: the cycle counter and the time of
+ * the wait functions
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <time.h>
+#include "mbed.h"
+
+static CoreDebug_Type core_debug;
+static DWT_Type dwt;
+CoreDebug_Type *CoreDebug = &core_debug;
+DWT_Type *DWT = &dwt;
+uint32_t SystemCoreClock = 1000000000;
+uint32_t host_us = 0;
+Ticker *Ticker::all[HOST_TICKERS];
+
+// host nanoseconds, wrapping like the 32 bit counter
+uint32_t host_cycles()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)ts.tv_sec * 1000000000u + (uint32_t)ts.tv_nsec;
+}
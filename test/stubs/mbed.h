@@ -0,0 +1,189 @@
+/**
+ * mbed.h
+ * Host stand-in for the mbed library, for the tests in this directory
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Only what the modules under test use. The pins do nothing, and the DWT
+ * cycle counter counts host nanoseconds (SystemCoreClock is 1 GHz). Timers
+ * read host_us, which only the wait functions and host_tickers() advance. The
+ * exclusive access intrinsics always succeed: the tests run on one thread.
+ */
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef int PinName;
+enum {
+  p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18, p19, p20,
+  p21, p22, p23, p24, p25, p26, p27, p28, p29, p30,
+  LED1, LED2, LED3, LED4, USBTX, USBRX, NC
+};
+enum PinMode { PullUp, PullDown, PullNone };
+
+class DigitalOut {
+public:
+  DigitalOut(PinName pin, int value = 0) : m_Value(value) {}
+  DigitalOut& operator=(int value) { m_Value = value; return *this; }
+  DigitalOut& operator=(DigitalOut& other) { m_Value = other.m_Value; return *this; }
+  operator int() { return m_Value; }
+  void write(int value) { m_Value = value; }
+  int read() { return m_Value; }
+private:
+  int m_Value;
+};
+
+class DigitalIn {
+public:
+  DigitalIn(PinName pin) {}
+  void mode(PinMode mode) {}
+  operator int() { return 0; }
+  int read() { return 0; }
+};
+
+enum PortName { Port0, Port1, Port2, Port3, Port4 };
+
+class PortIn {
+public:
+  PortIn(PortName port, int mask = 0xFFFFFFFF) {}
+  int read() { return 0; }
+};
+
+class PwmOut {
+public:
+  PwmOut(PinName pin) : m_Value(0) {}
+  void period(float seconds) {}
+  PwmOut& operator=(float value) { m_Value = value; return *this; }
+  operator float() { return m_Value; }
+private:
+  float m_Value;
+};
+
+extern uint32_t host_us; // [usec]
+
+class Timer {
+public:
+  Timer() : m_Start(host_us) {}
+  void start() { m_Start = host_us; }
+  void stop() {}
+  void reset() { m_Start = host_us; }
+  int read_ms() { return (host_us - m_Start) / 1000; }
+  int read_us() { return host_us - m_Start; }
+  float read() { return (host_us - m_Start) / 1e6; }
+private:
+  uint32_t m_Start;
+};
+
+// Tickers fire only when a test calls host_tickers() with the time
+struct TickerCall {
+  virtual ~TickerCall() {}
+  virtual void call() = 0;
+};
+
+template<typename T> struct TickerMember : TickerCall {
+  TickerMember(T *object, void (T::*member)(void)) : o(object), m(member) {}
+  void call() { (o->*m)(); }
+  T *o;
+  void (T::*m)(void);
+};
+
+#define HOST_TICKERS 4
+
+class Ticker {
+public:
+  Ticker() : m_Call(NULL) {}
+  ~Ticker() { detach(); }
+  template<typename T> void attach(T *object, void (T::*member)(void), float interval)
+  {
+    detach();
+    m_Call = new TickerMember<T>(object, member);
+    m_Interval = interval * 1e6;
+    m_Next = host_us + m_Interval;
+    for (int i = 0; i < HOST_TICKERS; i++)
+      if (all[i] == NULL)
+      {
+        all[i] = this;
+        break;
+      }
+  }
+  void detach()
+  {
+    delete m_Call;
+    m_Call = NULL;
+    for (int i = 0; i < HOST_TICKERS; i++)
+      if (all[i] == this)
+        all[i] = NULL;
+  }
+  // fire all tickers that are due at host_us
+  static void run()
+  {
+    for (int i = 0; i < HOST_TICKERS; i++)
+      while (all[i] != NULL && (int32_t)(host_us - all[i]->m_Next) >= 0)
+      {
+        all[i]->m_Next += all[i]->m_Interval;
+        all[i]->m_Call->call();
+      }
+  }
+private:
+  TickerCall *m_Call;
+  uint32_t m_Interval, m_Next; // [usec]
+  static Ticker *all[HOST_TICKERS];
+};
+
+// Set the time [usec] and fire the tickers that are due
+inline void host_tickers(uint32_t us)
+{
+  host_us = us;
+  Ticker::run();
+}
+
+class Serial {
+public:
+  Serial(PinName tx, PinName rx) {}
+  void baud(int baudrate) {}
+  int putc(int c) { return c; }
+  int getc() { return 0; }
+  int readable() { return 0; }
+};
+
+inline void wait_us(int us) { host_us += us; }
+inline void wait_ms(int ms) { wait_us(ms * 1000); }
+inline void wait(float seconds) { wait_us(seconds * 1e6); }
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+inline uint32_t __LDREXW(volatile uint32_t *addr) { return *addr; }
+inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) { *addr = value; return 0; }
+inline void __CLREX() {}
+inline void __DMB() {}
+
+// Cortex-M3 cycle counter
+uint32_t host_cycles();
+struct HostCycles {
+  operator uint32_t() const { return host_cycles(); }
+};
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+typedef struct { volatile uint32_t CTRL; HostCycles CYCCNT; } DWT_Type;
+extern CoreDebug_Type *CoreDebug;
+extern DWT_Type *DWT;
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+extern uint32_t SystemCoreClock;
+
+#endif
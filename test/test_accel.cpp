@@ -0,0 +1,164 @@
+/**
+ * test_accel.cpp
+ * Per axis acceleration limits: every block accelerates each axis within
+ * its x.accel or y.accel (../config/config.txt: 2000 and 500 mm/sec2), at
+ * the highest path acceleration those allow; X dominated and diagonal jobs
+ * run faster than with one acceleration for all axes (motion.accel, as
+ * before), Y moves do not change; and the cornering speed follows
+ * motion.tolerance
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "config.h"
+#include "motion_host.h"
+#include "test.h"
+
+#define ACCEL_TOL 1.02  // acceleration over the limit (rounding of the step rates)
+
+extern config_t config; // planner.cpp
+
+// Run a job from 0,0; the simulated time [sec]
+static double run(const std::vector<int> &job)
+{
+  host_power_cycle();
+  mot->home(0, 0, 0);
+  mot->setOriginAbsolute(0, 0, 0);
+  mot->reset();
+  host_feed(job, 0, job.size());
+  host_end_job();
+  host_drain();
+  return st_time;
+}
+
+// Largest acceleration of an axis over its limit, of all blocks of the
+// last run; and whether each block got the highest acceleration allowed
+static double check_axes(bool &highest)
+{
+  double worst = 0;
+  int32_t x = 0, y = 0;
+  highest = true;
+  for (size_t i = 0; i < st_trace.size(); i++)
+  {
+    const tStepTrace &s = st_trace[i];
+    double dx = (s.x - x) / config.steps_per_mm_x, dy = (s.y - y) / config.steps_per_mm_y;
+    x = s.x;
+    y = s.y;
+    if (s.mm <= 0)
+      continue;
+    double ux = fabs(dx) / s.mm, uy = fabs(dy) / s.mm;
+    worst = fmax(worst, s.accel * ux / config.acceleration_x);
+    worst = fmax(worst, s.accel * uy / config.acceleration_y);
+    double limit = fmin(ux > 0 ? config.acceleration_x / ux : 1e30, uy > 0 ? config.acceleration_y / uy : 1e30);
+    if (fabs(s.accel_max - limit) > limit * 0.01)
+      highest = false;
+  }
+  return worst;
+}
+
+// Lines at 'angle' [deg] from the X axis, back and forth, 'mm' long
+static void zigzag(std::vector<int> &job, double angle, int mm, int lines)
+{
+  int start[] = { 7, 100, 10000, 7, 101, 5000, 0, 100000, 100000 };
+  job.assign(start, start + sizeof(start) / sizeof(start[0]));
+  double ux = cos(angle * M_PI / 180), uy = sin(angle * M_PI / 180);
+  int x = 100000, y = 100000;
+  for (int i = 0; i < lines; i++)
+  {
+    int d = (i % 2 ? -1 : 1) * mm * 1000;
+    x += (int)lround(d * ux);
+    y += (int)lround(d * uy);
+    // a small offset across: a corner instead of a reversal
+    x += (int)lround(-500 * uy);
+    y += (int)lround(500 * ux);
+    job.push_back(1);
+    job.push_back(x);
+    job.push_back(y);
+  }
+}
+
+// Accelerations as before: motion.accel for all axes
+static void one_accel(bool on)
+{
+  static int xaccel, yaccel;
+  if (on)
+  {
+    xaccel = cfg->xaccel;
+    yaccel = cfg->yaccel;
+    cfg->xaccel = cfg->yaccel = cfg->accel;
+  }
+  else
+  {
+    cfg->xaccel = xaccel;
+    cfg->yaccel = yaccel;
+  }
+}
+
+static void test_direction(const char *name, double angle, bool faster)
+{
+  std::vector<int> job;
+  zigzag(job, angle, 20, 40);
+  one_accel(true);
+  double before = run(job);
+  one_accel(false);
+  double now = run(job);
+  bool highest;
+  double worst = check_axes(highest);
+  printf("%s: %.2f sec, was %.2f; highest axis acceleration %.2f of its limit\n", name, now, before, worst);
+  CHECK(worst <= ACCEL_TOL);
+  CHECK(highest);
+  if (faster)
+    CHECK(now < before * 0.9);
+  else
+    CHECK(fabs(now - before) < before * 0.001);
+}
+
+// A larger cornering tolerance: faster through the corners of a staircase
+// of 5 mm steps
+static void test_tolerance()
+{
+  int start[] = { 7, 100, 10000, 7, 101, 5000, 0, 10000, 10000 };
+  std::vector<int> job(start, start + sizeof(start) / sizeof(start[0]));
+  for (int i = 1; i <= 40; i++)
+  {
+    job.push_back(1);
+    job.push_back(10000 + (i + 1) / 2 * 5000);
+    job.push_back(10000 + i / 2 * 5000);
+  }
+  int tolerance = cfg->tolerance;
+  double t[3];
+  int tol[3] = { 10, tolerance, 500 };
+  for (int i = 0; i < 3; i++)
+  {
+    cfg->tolerance = tol[i];
+    t[i] = run(job);
+    CHECK(fabs(config.junction_deviation - tol[i] / 1000.0) < 1e-6);
+  }
+  cfg->tolerance = tolerance;
+  printf("motion.tolerance %d, %d, %d micron: %.2f, %.2f, %.2f sec\n", tol[0], tol[1], tol[2], t[0], t[1], t[2]);
+  CHECK(t[0] > t[1] && t[1] > t[2]);
+}
+
+int main()
+{
+  host_init("../config/config.txt");
+  CHECK(cfg->xaccel > cfg->accel && cfg->yaccel == cfg->accel);
+  test_direction("along X", 0, true);
+  test_direction("diagonal", 30, true);
+  test_direction("along Y", 90, false);
+  test_tolerance();
+  return TEST_RESULT("test_accel");
+}
@@ -0,0 +1,135 @@
+/**
+ * test_boot.cpp
+ * Boot sequencing of the network: EthConnect() runs in a thread of its own,
+ * as in main(), while the main thread goes on. The boot phase ends when the
+ * network is up; the thread prints nothing and leaves cfg alone, the main
+ * thread stores the address; a network that does not come up gives up
+ * after ETH_CONNECT_TIMEOUT
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <pthread.h>
+#include <stdarg.h>
+#include <string>
+#include "EthConfig.h"
+#include "LaosBoot.h"
+#include "test.h"
+
+GlobalConfig *cfg;
+std::deque<std::string> udp_in, udp_out;
+volatile int eth_hold = 0;
+int eth_result = 0;
+unsigned int eth_timeout = 0;
+
+static pthread_t main_thread;
+static int off_main = 0;  // EthConfig.cpp printed from another thread
+static std::string out;   // what it printed
+
+// EthConfig.cpp is built with printf() renamed to this
+extern "C" int eth_printf(const char *fmt, ...)
+{
+  if (!pthread_equal(pthread_self(), main_thread))
+    off_main++;
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  out += buf;
+  return n;
+}
+
+static int boot_eth;
+
+// eth_thread() of main.cpp
+static void *eth_thread(void *arg)
+{
+  EthConnect((tEthConnect *)arg);
+  boot_end(boot_eth, 1);
+  return NULL;
+}
+
+// The boot of main(): start the network, 'home' while it waits for DHCP,
+// then wait for it
+static EthernetInterface *boot(tEthConnect *c)
+{
+  out.clear();
+  off_main = 0;
+  eth_timeout = 0;
+  boot_eth = boot_begin("network", 0);
+  EthStart(c);
+  pthread_t t;
+  CHECK(pthread_create(&t, NULL, eth_thread, c) == 0);
+  for (int i = 0; i < 20; i++)
+  {
+    usleep(1000);
+    eth_printf("HOME...\n"); // the main thread prints meanwhile
+  }
+  CHECK(!boot_done(boot_eth)); // waits for DHCP
+  CHECK(strcmp(cfg->ip, "192.168.0.111") == 0);
+  eth_hold = 0;
+  while (!boot_done(boot_eth))
+    usleep(1000);
+  EthernetInterface *eth = EthDone(c);
+  CHECK(pthread_join(t, NULL) == 0);
+  CHECK(off_main == 0);
+  CHECK(eth_timeout == ETH_CONNECT_TIMEOUT);
+  return eth;
+}
+
+// DHCP: the address it got is in cfg when the phase has ended
+static void test_dhcp()
+{
+  tEthConnect c;
+  cfg->dhcp = 1;
+  eth_hold = 1;
+  eth_result = 0;
+  EthernetInterface *eth = boot(&c);
+  CHECK(c.result == 0);
+  CHECK(strcmp(cfg->ip, "10.0.0.7") == 0);
+  CHECK(strcmp(cfg->gw, "10.0.0.1") == 0);
+  CHECK(out.find("DHCP") != std::string::npos);
+  CHECK(out.find("10.0.0.7") != std::string::npos);
+  delete eth;
+  strcpy(cfg->ip, "192.168.0.111"); // the defaults again
+  strcpy(cfg->nm, "255.255.255.0");
+  strcpy(cfg->gw, "192.168.0.1");
+}
+
+// A fixed address, on a network that does not come up: the settings stay
+static void test_fail()
+{
+  tEthConnect c;
+  cfg->dhcp = 0;
+  eth_hold = 1;
+  eth_result = -1;
+  EthernetInterface *eth = boot(&c);
+  CHECK(c.result != 0);
+  CHECK(strcmp(eth->getIPAddress(), "192.168.0.111") == 0);
+  CHECK(strcmp(cfg->ip, "192.168.0.111") == 0);
+  CHECK(strcmp(cfg->gw, "192.168.0.1") == 0);
+  CHECK(out.find("NO NETWORK") != std::string::npos);
+  delete eth;
+}
+
+int main()
+{
+  main_thread = pthread_self();
+  cfg = new GlobalConfig("none.txt");
+  test_dhcp();
+  test_fail();
+  return TEST_RESULT("test_boot");
+}
@@ -0,0 +1,221 @@
+/**
+ * test_config.cpp
+ * The config file reader (laser/ConfigFile) on the bundled config/config*.txt:
+ * every key gives the same value as the reader it replaced, which scanned
+ * the file from the start with fgetc() for each Value() call; and the time
+ * to read all settings of a file, then and now
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <fcntl.h>
+#include <glob.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "ConfigFile.h"
+#include "test.h"
+
+#define LOADS 200 // per file, for the timing
+
+LaosFileSystem sd;
+
+// Value() of the old reader: scan the file from the start for the key
+static bool old_value(FILE *fp, const char *key, char *value, size_t maxlen, const char *def)
+{
+  unsigned int m = 0, n = strlen(key), s = 0;
+  int c;
+  char *v = value;
+  fseek(fp, 0L, SEEK_SET);
+  while (s != 99)
+  {
+    c = fgetc(fp);
+    if (c == EOF)
+      break;
+    switch (s)
+    {
+      case 0:
+        m = 0;
+        s = 1;
+      case 1: // read the key, skip spaces
+        if (c == key[m])
+          m++;
+        else
+          s = 0;
+        if (c == ';')
+          s = 10;
+        else if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+          if (n == m)
+          {
+            s = 2;
+            m = 0;
+          }
+          else
+            s = 0;
+        }
+        break;
+      case 2: // key matched, skip white space up to the first char
+        if (c == ';') s = 99;
+        else if (c != ' ' && c != '\t')
+        {
+          s = 3;
+          m = 1;
+          if (m < maxlen)
+            *v++ = c;
+        }
+        break;
+      case 3: // copy the value, up to eol or comment
+        if (m == maxlen || c == '\n' || c == '\r' || c == ';')
+          s = 99;
+        else
+        {
+          m++;
+          *v++ = c;
+        }
+        break;
+      case 10: // skip comments
+        if (c == '\n' || c == '\r') s = 0;
+        break;
+    }
+  }
+  if (s == 99 && m > 0)
+  {
+    *v = 0;
+    return true;
+  }
+  strncpy(value, def, maxlen);
+  return false;
+}
+
+// The keys of a file (the first word of each line that is not a comment),
+// and a few that are not there
+static std::vector<std::string> keys(const char *name)
+{
+  std::vector<std::string> k;
+  FILE *fp = fopen(name, "r");
+  char line[256], key[64];
+  while (fgets(line, sizeof(line), fp))
+    if (sscanf(line, " %63[^ \t\r\n;]", key) == 1)
+      k.push_back(key);
+  fclose(fp);
+  k.push_back("net.");
+  k.push_back("nothere");
+  return k;
+}
+
+// Trailing white space: the new reader strips it
+static std::string trim(const char *s)
+{
+  std::string t(s);
+  while (!t.empty() && (t[t.size()-1] == ' ' || t[t.size()-1] == '\t'))
+    t.erase(t.size()-1);
+  return t;
+}
+
+// stdout to /dev/null and back: the constructor prints the file name
+static int saved_stdout = -1;
+
+static void quiet(bool on)
+{
+  fflush(stdout);
+  if (on)
+  {
+    saved_stdout = dup(1);
+    int fd = open("/dev/null", O_WRONLY);
+    dup2(fd, 1);
+    close(fd);
+  }
+  else
+  {
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+  }
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void test_file(const char *path)
+{
+  const char *name = strrchr(path, '/') + 1;
+  std::vector<std::string> k = keys(path);
+  quiet(true);
+  ConfigFile cfg(name);
+  quiet(false);
+  FILE *fp = fopen(path, "r");
+  CHECK(cfg.IsOpen() && fp != NULL);
+  int found = 0;
+  for (size_t i = 0; i < k.size(); i++)
+  {
+    char a[64], b[64];
+    int ia, ib;
+    bool fa = old_value(fp, k[i].c_str(), a, sizeof(a), "def");
+    bool fb = cfg.Value(k[i].c_str(), b, sizeof(b), "def");
+    if (fa != fb || trim(a) != b)
+      printf("%s: %s: '%s', was '%s'\n", name, k[i].c_str(), b, a);
+    CHECK(fa == fb && trim(a) == b);
+    cfg.Value(k[i].c_str(), &ib, -1);
+    ia = fa ? atoi(a) : -1;
+    CHECK(ia == ib);
+    found += fb;
+  }
+  int i;
+  CHECK(found > 0 && !cfg.Value("nothere", &i, 0) && i == 0);
+
+  // the settings read at boot: read the file, look up every key
+  quiet(true);
+  double t = now();
+  for (int i = 0; i < LOADS; i++)
+  {
+    FILE *f = fopen(path, "r");
+    char a[64];
+    for (size_t j = 0; j < k.size(); j++)
+      old_value(f, k[j].c_str(), a, sizeof(a), "");
+    fclose(f);
+  }
+  double t_old = (now() - t) / LOADS;
+  t = now();
+  for (int i = 0; i < LOADS; i++)
+  {
+    ConfigFile c(name);
+    char b[64];
+    for (size_t j = 0; j < k.size(); j++)
+      c.Value(k[j].c_str(), b, sizeof(b), "");
+  }
+  double t_new = (now() - t) / LOADS;
+  quiet(false);
+  printf("%s: %d keys, read in %.1f usec, was %.1f\n", name, found, t_new * 1e6, t_old * 1e6);
+  CHECK(t_new * 5 < t_old);
+  fclose(fp);
+}
+
+int main()
+{
+  strcpy(sd.pathname, "../config/");
+  glob_t g;
+  CHECK(glob("../config/*.txt", 0, NULL, &g) == 0 && g.gl_pathc > 0);
+  for (size_t i = 0; i < g.gl_pathc; i++)
+    test_file(g.gl_pathv[i]);
+  globfree(&g);
+  return TEST_RESULT("test_config");
+}
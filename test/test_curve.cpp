@@ -0,0 +1,239 @@
+/**
+ * test_curve.cpp
+ * Simplecode arcs and Bezier curves (10, 11, 13) against the same job with
+ * the curves flattened into line commands: the file size, the planner
+ * blocks LaosMotion makes of each, and the deviation of the moves from the
+ * exact curves, with the motion.curvetolerance of ../config/config.txt
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "config.h"
+#include "motion_host.h"
+#include "test.h"
+
+#define CURVES 60
+#define SAMPLES 2000 // points of the exact curve, per curve
+#define WINDOW 8     // blocks searched for the nearest one
+
+extern config_t config; // planner.cpp
+
+// One curve: command 10, 11 or 13 from x0,y0; p: its values
+typedef struct {
+  int command;
+  int x0, y0;
+  int p[6];
+} tCurve;
+
+static std::vector<tCurve> curves;
+
+static int rnd(int lo, int hi)
+{
+  return lo + rand() % (hi - lo + 1);
+}
+
+// Circles, arcs and Bezier curves of 1 to 40 mm, each after a move
+static void make_curves()
+{
+  for (int i = 0; i < CURVES; i++)
+  {
+    tCurve c;
+    int cx = rnd(50000, 150000), cy = rnd(50000, 150000);
+    c.command = 10 + i % 4;
+    if (c.command == 12)
+      c.command = 13;
+    if (c.command == 13)
+    {
+      c.x0 = cx + rnd(-40000, 40000);
+      c.y0 = cy + rnd(-40000, 40000);
+      for (int k = 0; k < 6; k++)
+        c.p[k] = (k % 2 ? cy : cx) + rnd(-40000, 40000);
+    }
+    else
+    {
+      double r = rnd(1000, 40000), a0 = rnd(0, 359) * M_PI / 180, a1 = rnd(0, 359) * M_PI / 180;
+      c.x0 = cx + (int)lround(r * cos(a0));
+      c.y0 = cy + (int)lround(r * sin(a0));
+      bool circle = i % 8 < 2;
+      c.p[0] = circle ? c.x0 : cx + (int)lround(r * cos(a1));
+      c.p[1] = circle ? c.y0 : cy + (int)lround(r * sin(a1));
+      c.p[2] = cx;
+      c.p[3] = cy;
+    }
+    curves.push_back(c);
+  }
+}
+
+static int values(int command)
+{
+  return command == 13 ? 6 : 4;
+}
+
+// The job with curve commands, or with the segments LaosCurve makes of
+// them as lines, as a program that flattens them would send them
+static void make_job(std::vector<int> &job, bool flat)
+{
+  int start[] = { 7, 100, 5000, 7, 101, 8000 };
+  job.assign(start, start + sizeof(start) / sizeof(start[0]));
+  LaosCurve curve;
+  curve.SetTolerance(cfg->curvetolerance);
+  for (size_t i = 0; i < curves.size(); i++)
+  {
+    const tCurve &c = curves[i];
+    job.push_back(0);
+    job.push_back(c.x0);
+    job.push_back(c.y0);
+    if (!flat)
+    {
+      job.push_back(c.command);
+      job.insert(job.end(), c.p, c.p + values(c.command));
+      continue;
+    }
+    if (c.command == 13)
+      curve.Bezier(c.x0, c.y0, c.p[0], c.p[1], c.p[2], c.p[3], c.p[4], c.p[5]);
+    else
+      curve.Arc(c.x0, c.y0, c.p[0], c.p[1], c.p[2], c.p[3], c.command == 11);
+    int x, y;
+    while (curve.Next(x, y))
+    {
+      job.push_back(1);
+      job.push_back(x);
+      job.push_back(y);
+    }
+  }
+}
+
+// Size of the job as a file: one space or newline after each value
+static size_t bytes(const std::vector<int> &job)
+{
+  size_t n = 0;
+  char s[16];
+  for (size_t i = 0; i < job.size(); i++)
+    n += snprintf(s, sizeof(s), "%d", job[i]) + 1;
+  return n;
+}
+
+static void run(const std::vector<int> &job)
+{
+  host_power_cycle();
+  mot->home(0, 0, 0);
+  mot->setOriginAbsolute(0, 0, 0);
+  mot->reset();
+  host_feed(job, 0, job.size());
+  host_end_job();
+  host_drain();
+}
+
+// A point of the exact curve, at t in 0..1 [micron]; an arc as LaosCurve
+// defines it: the radius goes from the start to the end linearly
+static void point(const tCurve &c, double t, double &x, double &y)
+{
+  if (c.command == 13)
+  {
+    double u = 1 - t;
+    double b0 = u*u*u, b1 = 3*u*u*t, b2 = 3*u*t*t, b3 = t*t*t;
+    x = b0*c.x0 + b1*c.p[0] + b2*c.p[2] + b3*c.p[4];
+    y = b0*c.y0 + b1*c.p[1] + b2*c.p[3] + b3*c.p[5];
+    return;
+  }
+  double cx = c.p[2], cy = c.p[3];
+  double r0 = hypot(c.x0 - cx, c.y0 - cy), r1 = hypot(c.p[0] - cx, c.p[1] - cy);
+  double a0 = atan2(c.y0 - cy, c.x0 - cx), sweep = atan2(c.p[1] - cy, c.p[0] - cx) - a0;
+  if (c.command == 11 && sweep <= 0) sweep += 2 * M_PI;
+  if (c.command == 10 && sweep >= 0) sweep -= 2 * M_PI;
+  x = cx + (r0 + t * (r1 - r0)) * cos(a0 + t * sweep);
+  y = cy + (r0 + t * (r1 - r0)) * sin(a0 + t * sweep);
+}
+
+// Distance from p to the segment a-b
+static double seg_dist(double px, double py, double ax, double ay, double bx, double by)
+{
+  double dx = bx - ax, dy = by - ay, l = dx*dx + dy*dy;
+  double t = l > 0 ? ((px - ax) * dx + (py - ay) * dy) / l : 0;
+  t = t < 0 ? 0 : t > 1 ? 1 : t;
+  return hypot(px - (ax + t * dx), py - (ay + t * dy));
+}
+
+// Largest distance [micron] from the exact curves to the laser blocks of
+// the run, which go along them in order
+static double deviation()
+{
+  std::vector<double> vx(1, 0), vy(1, 0);
+  std::vector<bool> laser;
+  for (size_t i = 0; i < st_trace.size(); i++)
+  {
+    vx.push_back(st_trace[i].x * 1000.0 / config.steps_per_mm_x);
+    vy.push_back(st_trace[i].y * 1000.0 / config.steps_per_mm_y);
+    laser.push_back(st_trace[i].options & OPT_LASER_ON);
+  }
+  double worst = 0;
+  size_t b = 0; // the block nearest to the previous point
+  for (size_t i = 0; i < curves.size(); i++)
+  {
+    while (b < laser.size() && !laser[b])
+      b++;
+    for (int k = 0; k <= SAMPLES; k++)
+    {
+      double x, y, best = 1e30;
+      size_t nearest = b;
+      point(curves[i], (double)k / SAMPLES, x, y);
+      for (size_t j = b; j < laser.size() && j < b + WINDOW; j++)
+      {
+        if (!laser[j])
+          break;
+        double d = seg_dist(x, y, vx[j], vy[j], vx[j+1], vy[j+1]);
+        if (d < best)
+        {
+          best = d;
+          nearest = j;
+        }
+      }
+      worst = fmax(worst, best);
+      b = nearest;
+    }
+    while (b < laser.size() && laser[b])
+      b++;
+  }
+  return worst;
+}
+
+int main()
+{
+  host_init("../config/config.txt");
+  srand(1);
+  make_curves();
+  std::vector<int> job, flat;
+  make_job(job, false);
+  make_job(flat, true);
+
+  run(flat);
+  std::vector<tStepTrace> flat_trace = st_trace;
+  run(job);
+  bool same = st_trace.size() == flat_trace.size();
+  for (size_t i = 0; same && i < st_trace.size(); i++)
+    same = st_trace[i].x == flat_trace[i].x && st_trace[i].y == flat_trace[i].y;
+  double dev = deviation();
+  double step = 1000.0 / fmin(config.steps_per_mm_x, config.steps_per_mm_y);
+  printf("%d curves: %u bytes, %u as lines; %u blocks, %u as lines; deviation %.1f micron "
+    "(tolerance %d, step %.1f)\n", CURVES, (unsigned)bytes(job), (unsigned)bytes(flat),
+    (unsigned)st_trace.size(), (unsigned)flat_trace.size(), dev, cfg->curvetolerance, step);
+  CHECK(bytes(job) * 20 < bytes(flat));
+  CHECK(same); // the same blocks as the lines
+  CHECK(st_trace.size() > 10 * CURVES);
+  CHECK(dev <= cfg->curvetolerance + step);
+  CHECK(dev > cfg->curvetolerance / 4.0); // not more segments than needed
+  return TEST_RESULT("test_curve");
+}
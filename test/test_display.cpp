@@ -0,0 +1,128 @@
+/**
+ * test_display.cpp
+ * The I2C display over a stand-in driver: bytes per frame for an unchanged
+ * screen, a full one and a jog of the MOVE screen, in one byte writes; a
+ * write that hangs is aborted after LCD_TX_TIMEOUT, and a failed write
+ * makes the next update send the whole screen
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MODI2C.h"
+#include "LaosDisplay.h"
+#include "test.h"
+
+std::vector<std::string> i2c_writes;
+bool i2c_hang = false;
+int i2c_status = 0x28;
+int i2c_aborts = 0;
+int i2c_reads = 0;
+char i2c_key = 0;
+int i2c_read_ns = 0;
+
+extern "C" void mbed_reset() {}
+
+static const char *move =
+  "X: +6543210 MOVE"
+  "Y: +6543210     ";
+
+// bytes sent since the last call; each write one byte
+static int sent()
+{
+  int n = 0;
+  for (size_t i = 0; i < i2c_writes.size(); i++)
+  {
+    CHECK(i2c_writes[i].size() <= LCD_I2C_CHUNK);
+    n += i2c_writes[i].size();
+  }
+  i2c_writes.clear();
+  return n;
+}
+
+static void test_frames(LaosDisplay &dsp)
+{
+  int pos[2] = { 0, 0 };
+  sent();
+  dsp.ShowScreen(move, pos, NULL);
+  CHECK(sent() == LCD_SIZE + 1); // home and the whole screen
+  dsp.ShowScreen(move, pos, NULL);
+  CHECK(sent() == 0);
+
+  // jog x, then y, 100 updates each: x only changes the first line
+  int bytes = 0, frames = 0;
+  for (int axis = 0; axis < 2; axis++)
+  {
+    for (int i = 0; i < 100; i++)
+    {
+      pos[axis] += 100;
+      dsp.ShowScreen(move, pos, NULL);
+      int n = sent();
+      CHECK(n <= (axis ? LCD_SIZE : LCD_COLS) + 1);
+      bytes += n;
+      frames++;
+    }
+  }
+  printf("MOVE screen jog: %.1f bytes per frame, was %d\n", (double)bytes / frames, LCD_SIZE + 1);
+  CHECK(bytes < frames * (LCD_SIZE + 1) * 3 / 4);
+}
+
+// LCD_REFRESH unchanged updates: the whole screen again
+static void test_refresh(LaosDisplay &dsp)
+{
+  int pos[2] = { 1, 2 };
+  dsp.ShowScreen(move, pos, NULL);
+  sent();
+  for (int i = 0; i < LCD_REFRESH; i++)
+    dsp.ShowScreen(move, pos, NULL);
+  CHECK(sent() == 0);
+  dsp.ShowScreen(move, pos, NULL);
+  CHECK(sent() == LCD_SIZE + 1);
+}
+
+// a write that never ends: aborted after LCD_TX_TIMEOUT, the rest of the
+// screen is not sent; then the whole screen. Also for a write that fails.
+static void test_hang(LaosDisplay &dsp)
+{
+  int pos[2] = { 5, 5 };
+  dsp.ShowScreen(move, pos, NULL);
+  sent();
+  for (int fail = 0; fail < 2; fail++)
+  {
+    i2c_hang = !fail;
+    i2c_status = fail ? 0x20 : 0x28; // no ACK
+    i2c_aborts = 0;
+    pos[1]++;
+    uint32_t t = host_us;
+    dsp.ShowScreen(move, pos, NULL);
+    CHECK(sent() == 1);
+    CHECK(i2c_aborts == !fail);
+    CHECK(host_us - t <= (LCD_TX_TIMEOUT + 1) * 1000);
+    i2c_hang = false;
+    i2c_status = 0x28;
+    dsp.ShowScreen(move, pos, NULL); // the same screen: sent in full
+    CHECK(sent() == LCD_SIZE + 1);
+    dsp.ShowScreen(move, pos, NULL);
+    CHECK(sent() == 0);
+  }
+}
+
+int main()
+{
+  LaosDisplay dsp;
+  test_frames(dsp);
+  test_refresh(dsp);
+  test_hang(dsp);
+  return TEST_RESULT("test_display");
+}
@@ -0,0 +1,147 @@
+/**
+ * test_estimate.cpp
+ * The run time estimate of LaosEstimate against recorded runs: each job is
+ * run by LaosMotion and the planner on the host stepper, timed step by step
+ * with the trapezoid generator of the step interrupt, and the run time,
+ * laser-on time and distances of the run are compared with the estimate
+ * made from the file, with the settings of LaosJobMeta
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "config.h"
+#include "LaosJobMeta.h"
+#include "motion_host.h"
+#include "test.h"
+
+extern config_t config; // planner.cpp
+LaosFileSystem sd;      // LaosJobMeta.cpp, not used
+
+#define MAX_ERROR 0.02  // relative error of the run time estimates
+
+typedef struct {
+  double time, laser_time;  // [sec]
+  double travel, laser;     // laser off and on [mm]
+} tRun;
+
+// Run the job from 0,0 and record it
+static tRun record(const std::vector<int> &job)
+{
+  host_power_cycle();
+  mot->home(0, 0, 0);
+  mot->setOriginAbsolute(0, 0, 0);
+  mot->reset();
+  st_host_steps = true;
+  host_feed(job, 0, job.size());
+  host_end_job();
+  host_drain();
+  st_host_steps = false;
+  tRun r = { st_time, 0, 0, 0 };
+  for (size_t i = 0; i < st_trace.size(); i++)
+    if (st_trace[i].options & (OPT_LASER_ON | OPT_BITMAP))
+    {
+      r.laser_time += st_trace[i].time;
+      r.laser += st_trace[i].mm;
+    }
+    else
+      r.travel += st_trace[i].mm;
+  return r;
+}
+
+static tRun estimate(const std::vector<int> &job)
+{
+  LaosEstimate::TSettings s;
+  LaosJobMeta::GetEstimateSettings(s);
+  LaosEstimate est;
+  est.Setup(s);
+  est.Reset(0, 0);
+  for (size_t i = 0; i < job.size(); i++)
+    est.Write(job[i]);
+  est.Finish();
+  tRun r = { est.GetTime(), est.GetLaserTime(), est.GetTravelDistance(), est.GetLaserDistance() };
+  return r;
+}
+
+static double error(double estimate, double recorded)
+{
+  return recorded > 0 ? fabs(estimate - recorded) / recorded : fabs(estimate);
+}
+
+static void check(const char *name, const std::vector<int> &job)
+{
+  tRun run = record(job), est = estimate(job);
+  printf("%s: %.2f sec, estimate %.2f (%+.1f%%); laser on %.2f sec, estimate %.2f; "
+    "%.0f+%.0f mm, estimate %.0f+%.0f\n", name, run.time, est.time,
+    100 * (est.time - run.time) / run.time, run.laser_time, est.laser_time,
+    run.travel, run.laser, est.travel, est.laser);
+  CHECK(error(est.time, run.time) < MAX_ERROR);
+  CHECK(error(est.laser_time, run.laser_time) < MAX_ERROR);
+  CHECK(error(est.travel, run.travel) < 0.01);
+  CHECK(error(est.laser, run.laser) < 0.01);
+}
+
+// One line of 'mm' at 'speed' [% of the speed] and full power
+static void line_job(std::vector<int> &job, int mm, int speed)
+{
+  int start[] = { 7, 100, speed * 100, 7, 101, 10000, 0, 0, 0, 1, mm * 1000, 0 };
+  job.assign(start, start + sizeof(start) / sizeof(start[0]));
+}
+
+// Small text: letters of a few short strokes, 1.5 mm apart
+static void text_job(std::vector<int> &job, int letters)
+{
+  int start[] = { 7, 100, 10000, 7, 101, 5000, 0, 0, 0 };
+  job.assign(start, start + sizeof(start) / sizeof(start[0]));
+  for (int i = 0; i < letters; i++)
+  {
+    int x = (i % 100) * 1500, y = (i / 100) * 2500;
+    job.push_back(0);
+    job.push_back(x);
+    job.push_back(y);
+    for (int k = 0; k < 6; k++)
+    {
+      job.push_back(1);
+      job.push_back(x + rand() % 1000);
+      job.push_back(y + rand() % 2000);
+    }
+  }
+}
+
+int main()
+{
+  host_init("../config/config.txt"); // the machine of the benchmark
+  std::vector<int> job;
+  srand(1);
+
+  // a line from rest to rest: accelerate, cruise, decelerate
+  line_job(job, 200, 50);
+  tRun est = estimate(job);
+  double v = cfg->speed * 0.5, a = config.acceleration_x;
+  printf("200 mm line at %.0f mm/sec: estimate %.3f sec, trapezoid %.3f\n", v, est.time,
+    200 / v + v / a);
+  CHECK(error(est.time, 200 / v + v / a) < 0.01);
+  check("line", job);
+
+  text_job(job, 500);
+  check("text", job);
+  for (int i = 0; i < 3; i++)
+  {
+    job.clear();
+    host_random_job(job, 300);
+    check("random", job);
+  }
+  return TEST_RESULT("test_estimate");
+}
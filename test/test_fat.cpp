@@ -0,0 +1,210 @@
+/**
+ * test_fat.cpp
+ * Job files on a FAT image in a file: sector reads per job replay (read
+ * the job, cancel: seek to the end, resume: seek to the middle and read
+ * on) for a job written into fragmented free space, as before, and for
+ * one written with FATFileHandle::preallocate() and replayed through the
+ * fast seek map of a read-only FATFileHandle. A job in more fragments
+ * than the map holds is read as before
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "ff.h"
+#include "diskio.h"
+#include "FATFileHandle.h"
+#include "test.h"
+
+#define SECTORS 65536           // 32 MB
+#define CLUSTER 4096            // [bytes]
+#define FILLERS 4               // files written side by side to fragment the card
+#define JOB (1024 * 1024)       // [bytes]
+#define CHUNK 512               // read size of the stdio buffer
+
+static int image = -1;
+static FATFS fs;
+
+// sector reads of the FAT and of everything else
+static int fat_reads = 0, data_reads = 0;
+
+DSTATUS disk_initialize(BYTE drv) { return 0; }
+DSTATUS disk_status(BYTE drv) { return 0; }
+
+DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
+{
+  for (DWORD s = sector; s < sector + count; s++)
+  {
+    if (fs.fs_type && s >= fs.fatbase && s < fs.fatbase + fs.n_fats * fs.fsize)
+      fat_reads++;
+    else
+      data_reads++;
+  }
+  return pread(image, buff, count * 512, sector * 512) == count * 512 ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+{
+  return pwrite(image, buff, count * 512, sector * 512) == count * 512 ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
+{
+  switch (ctrl)
+  {
+    case CTRL_SYNC: return RES_OK;
+    case GET_SECTOR_COUNT: *(DWORD *)buff = SECTORS; return RES_OK;
+    case GET_BLOCK_SIZE: *(DWORD *)buff = 1; return RES_OK;
+  }
+  return RES_PARERR;
+}
+
+DWORD get_fattime() { return 0; }
+
+static std::string job;
+
+// Fill the first half of the card with FILLERS files, one cluster of each
+// in turn, and delete one: free clusters all over that half, and a free
+// second half
+static void fragment()
+{
+  FIL f[FILLERS];
+  char name[16], buf[CLUSTER];
+  memset(buf, 'f', sizeof(buf));
+  for (int i = 0; i < FILLERS; i++)
+  {
+    sprintf(name, "fill%d.sys", i);
+    CHECK(f_open(&f[i], name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+  }
+  for (int k = 0; k < SECTORS / 2 * 512 / CLUSTER / FILLERS; k++)
+    for (int i = 0; i < FILLERS; i++)
+    {
+      UINT n;
+      CHECK(f_write(&f[i], buf, sizeof(buf), &n) == FR_OK && n == sizeof(buf));
+    }
+  for (int i = 0; i < FILLERS; i++)
+    f_close(&f[i]);
+  CHECK(f_unlink("fill0.sys") == FR_OK);
+  CHECK(f_mount(0, &fs) == FR_OK); // as after a reboot: allocate from the start
+}
+
+// Write the job the way TFTPServer does, in 4 KB buffers; preallocated
+// when the size is known
+static void write_job(const char *name, bool prealloc)
+{
+  FIL fh;
+  CHECK(f_open(&fh, name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+  FATFileHandle *h = new FATFileHandle(fh);
+  if (prealloc)
+    CHECK(h->preallocate(job.size()) == 0);
+  for (size_t i = 0; i < job.size(); i += CLUSTER)
+    CHECK(h->write(job.data() + i, CLUSTER) == CLUSTER);
+  CHECK(h->close() == 0);
+}
+
+// Fragments of the cluster chain of a file
+static int fragments(const char *name)
+{
+  FIL fh;
+  DWORD tbl[1024];
+  CHECK(f_open(&fh, name, FA_READ) == FR_OK);
+  tbl[0] = sizeof(tbl) / sizeof(tbl[0]);
+  fh.cltbl = tbl;
+  CHECK(f_lseek(&fh, CREATE_LINKMAP) == FR_OK);
+  f_close(&fh);
+  return (tbl[0] - 1) / 2;
+}
+
+// The replay of a job: read it, cancel (seek to the end), resume in the
+// middle and read on; the sector reads, the open not included
+typedef struct {
+  int fat, data;
+} tReads;
+
+static tReads replay(const char *name, bool handle)
+{
+  FIL fh;
+  CHECK(f_open(&fh, name, FA_READ) == FR_OK);
+  FATFileHandle *h = handle ? new FATFileHandle(fh) : NULL;
+  fat_reads = data_reads = 0;
+  std::string s;
+  char buf[CHUNK];
+  for (int pass = 0; pass < 2; pass++)
+  {
+    if (pass)
+    {
+      // cancel, then resume from a checkpoint
+      off_t end = h ? h->lseek(0, SEEK_END) : (f_lseek(&fh, fh.fsize), (off_t)fh.fptr);
+      CHECK(end == (off_t)job.size());
+      off_t mid = h ? h->lseek(job.size() / 2, SEEK_SET) : (f_lseek(&fh, job.size() / 2), (off_t)fh.fptr);
+      CHECK(mid == (off_t)job.size() / 2);
+    }
+    for (;;)
+    {
+      UINT n;
+      if (h)
+        n = h->read(buf, sizeof(buf));
+      else
+        CHECK(f_read(&fh, buf, sizeof(buf), &n) == FR_OK);
+      if (n == 0)
+        break;
+      s.append(buf, n);
+    }
+  }
+  CHECK(s == job + job.substr(job.size() / 2));
+  tReads r = { fat_reads, data_reads };
+  if (h)
+    h->close();
+  else
+    f_close(&fh);
+  return r;
+}
+
+int main()
+{
+  char name[] = "/tmp/laosfatXXXXXX";
+  image = mkstemp(name);
+  CHECK(image >= 0 && ftruncate(image, (off_t)SECTORS * 512) == 0);
+  CHECK(f_mount(0, &fs) == FR_OK);
+  CHECK(f_mkfs(0, 1, CLUSTER) == FR_OK);
+  CHECK(f_mount(0, &fs) == FR_OK);
+
+  srand(1);
+  for (int i = 0; i < JOB; i++)
+    job += (char)('0' + rand() % 10);
+  fragment();
+  write_job("old.lgc", false);
+  write_job("new.lgc", true);
+  int old_frag = fragments("old.lgc"), new_frag = fragments("new.lgc");
+  tReads old_reads = replay("old.lgc", false), new_reads = replay("new.lgc", true);
+  printf("replay of a %d KB job: %d+%d sector reads (FAT+data) in %d fragments, "
+    "preallocated with fast seek %d+%d in %d\n", JOB / 1024, old_reads.fat, old_reads.data,
+    old_frag, new_reads.fat, new_reads.data, new_frag);
+  CHECK(new_frag == 1);
+  CHECK(old_frag > 100);
+  CHECK(new_reads.fat == 0);
+  CHECK(old_reads.fat > 0);
+  CHECK(new_reads.data <= old_reads.data);
+  // too many fragments for the map: the handle follows the chain
+  CHECK(replay("old.lgc", true).fat == old_reads.fat);
+
+  close(image);
+  unlink(name);
+  return TEST_RESULT("test_fat");
+}
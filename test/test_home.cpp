@@ -0,0 +1,123 @@
+/**
+ * test_home.cpp
+ * Homing with virtual switches: the fast seek stops on the switches, the
+ * slow approach finds them again after the back off, and homing fails
+ * when a switch is not found or is still pressed after the back off
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "motion_host.h"
+#include "test.h"
+
+#define SWITCH_MM 30 // distance of the switches from the power on position
+
+// direction of the home switch in steps, as LaosMotion::home() moves
+static int home_dir(int homedir, int scale)
+{
+  int sign = ((!homedir) ^ (scale < 0)) ? -1 : 1; // [mm]
+  return scale < 0 ? -sign : sign;
+}
+
+// Power on, with the switches of x and y SWITCH_MM away, and z homing off;
+// the approach speed of config.txt
+static void setup()
+{
+  host_power_cycle();
+  cfg->dryrun = 0;
+  cfg->autozhome = 0;
+  cfg->homespeed = 100;
+  memset(st_switch, 0, sizeof(st_switch));
+  st_switch[0].dir = home_dir(cfg->xhomedir, cfg->xscale);
+  st_switch[0].at = st_switch[0].dir * SWITCH_MM * abs(cfg->xscale) / 1000;
+  st_switch[1].dir = home_dir(cfg->yhomedir, cfg->yscale);
+  st_switch[1].at = st_switch[1].dir * SWITCH_MM * abs(cfg->yscale) / 1000;
+}
+
+// seek, back off and approach; the switches are the home position
+static void test_home()
+{
+  setup();
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  CHECK(mot->isHome);
+  CHECK(st_trace.size() == 3);
+  if (st_trace.size() != 3)
+    return;
+  CHECK(st_trace[0].x == st_switch[0].at && st_trace[0].y == st_switch[1].at);
+  int backoff_x = cfg->homebackoff * abs(cfg->xscale) / 1000000;
+  CHECK(abs(st_trace[1].x - st_switch[0].at) == backoff_x);
+  CHECK(st_trace[2].x == st_switch[0].at && st_trace[2].y == st_switch[1].at);
+  // the approach is slow, the seek is not
+  CHECK(st_trace[2].nominal * 60 <= 60.0 * 1E6 / (2.0 * cfg->homespeed * fabs(cfg->xscale / 1000.0)) * 1.01);
+  CHECK(st_trace[0].nominal > st_trace[2].nominal);
+  int x, y, z;
+  mot->getPlannedPositionAbsolute(&x, &y, &z);
+  CHECK(x == cfg->xhome && y == cfg->yhome);
+}
+
+// a switch that does not release: no slow approach, and not homed
+static void test_stuck()
+{
+  for (int axis = 0; axis < 2; axis++)
+  {
+    setup();
+    st_switch[axis].stuck = true;
+    mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+    CHECK(!mot->isHome);
+    CHECK(st_trace.size() == 2); // seek and back off
+  }
+}
+
+// a switch that is never reached: not homed
+static void test_missing()
+{
+  setup();
+  st_switch[1].at *= 1000; // beyond the seek distance
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  CHECK(!mot->isHome);
+}
+
+// z, with a fast seek: a stuck switch stops homing before x and y
+static void test_z()
+{
+  setup();
+  cfg->autozhome = 1;
+  cfg->zhomefast = 10;
+  st_switch[2].dir = home_dir(cfg->zhomedir, cfg->zscale);
+  st_switch[2].at = st_switch[2].dir * SWITCH_MM * abs(cfg->zscale) / 1000;
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  CHECK(mot->isHome);
+  CHECK(st_trace.size() == 6);
+
+  setup();
+  cfg->autozhome = 1;
+  st_switch[2].stuck = true;
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  CHECK(!mot->isHome);
+  CHECK(st_trace.size() == 2);
+  cfg->autozhome = 0;
+  cfg->zhomefast = 0;
+}
+
+int main()
+{
+  host_init();
+  test_home();
+  test_stuck();
+  test_missing();
+  test_z();
+  return TEST_RESULT("test_home");
+}
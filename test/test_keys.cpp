@@ -0,0 +1,158 @@
+/**
+ * test_keys.cpp
+ * Keypad sampling while a job runs: tokens fed per second of CPU time, and
+ * the cancel latency, with a keypad read after every token (as before) and
+ * with the keypad sampled on the ticker by the ui task. Each read costs the
+ * CPU time of the interrupts of an I2C transfer (I2C_READ_NS).
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MODI2C.h"
+#include "LaosDisplay.h"
+#include "motion_host.h"
+#include "test.h"
+
+#define I2C_READ_NS 10000  // start, address, data and stop interrupts of a 1 byte read
+#define UI_PERIOD 0.02     // the ui task runs at least this often [sec] (main.cpp)
+
+std::vector<std::string> i2c_writes;
+bool i2c_hang = false;
+int i2c_status = 0x28;
+int i2c_aborts = 0;
+int i2c_reads = 0;
+char i2c_key = 0;
+int i2c_read_ns = I2C_READ_NS;
+
+typedef struct {
+  double tokens_s;  // tokens per second of CPU time of the feeder and the keypad
+  double reads_s;   // keypad reads per second of job time
+  double latency;   // from pressing cancel to seeing it [sec]
+} tRun;
+
+static LaosDisplay *dsp;
+static double cancel_at, seen_at;
+
+// a cancel the keypad code has seen at time t [sec]
+static void key_seen(int key, double t)
+{
+  if (key == K_CANCEL && seen_at < 0)
+    seen_at = t;
+}
+
+// The ui task at time t: sample the keypad when the ticker says so
+static uint32_t ui(double t)
+{
+  uint32_t c = host_cycles();
+  i2c_key = t >= cancel_at ? K_CANCEL : 0;
+  host_tickers(t * 1e6);
+  dsp->PollKeys();
+  key_seen(dsp->GetKey(), t);
+  return host_cycles() - c;
+}
+
+// Feed the job: 'per_token' reads the keypad after each token, otherwise
+// the ui task samples it while the blocks run
+static tRun run(const std::vector<int> &job, bool per_token)
+{
+  host_power_cycle();
+  mot->home(0, 0, 0);
+  mot->setOriginAbsolute(0, 0, 0);
+  mot->reset();
+  i2c_key = 0;
+  dsp->read_nb(); // the read of the last run
+  dsp->read_nb();
+  i2c_reads = 0;
+  cancel_at = 1e9;
+  seen_at = -1;
+  if (!per_token)
+    dsp->StartKeySampling();
+  uint64_t cycles = 0;
+  size_t i = 0;
+  double d;
+  do
+  {
+    uint32_t c = host_cycles();
+    while (i < job.size() && mot->ready())
+    {
+      mot->write(job[i++]);
+      if (per_token)
+      {
+        i2c_key = st_time >= cancel_at ? K_CANCEL : 0;
+        key_seen(dsp->read_nb(), st_time);
+      }
+    }
+    if (i == job.size())
+      mot->queue(); // flush
+    cycles += host_cycles() - c;
+    d = st_host_start();
+    if (!per_token)
+      for (double t = st_time - d; t < st_time; t += UI_PERIOD)
+        cycles += ui(t);
+    if (d >= 0)
+      st_host_finish();
+    if (cancel_at > 1e8 && st_time > 0.5)
+      cancel_at = st_time; // half a second in: press cancel
+  }
+  while (d >= 0 || i < job.size());
+  if (!per_token)
+  {
+    for (double t = st_time; seen_at < 0 && t < st_time + 1; t += UI_PERIOD)
+      ui(t);
+    dsp->StopKeySampling();
+  }
+  tRun r;
+  r.tokens_s = job.size() / (cycles * 1e-9);
+  r.reads_s = i2c_reads / st_time;
+  r.latency = seen_at < 0 ? 1e9 : seen_at - cancel_at;
+  return r;
+}
+
+// Small text: letters of a few short strokes, 1.5 mm apart
+static void text_job(std::vector<int> &job, int letters)
+{
+  int start[] = { 7, 100, 10000, 7, 101, 5000, 0, 0, 0 };
+  job.assign(start, start + sizeof(start) / sizeof(start[0]));
+  for (int i = 0; i < letters; i++)
+  {
+    int x = (i % 100) * 1500, y = (i / 100) * 2500;
+    job.push_back(0);
+    job.push_back(x);
+    job.push_back(y);
+    for (int k = 0; k < 6; k++)
+    {
+      job.push_back(1);
+      job.push_back(x + rand() % 1000);
+      job.push_back(y + rand() % 2000);
+    }
+  }
+}
+
+int main()
+{
+  host_init("../config/config.txt"); // the machine of the benchmark
+  dsp = new LaosDisplay();
+  std::vector<int> job;
+  srand(1);
+  text_job(job, 5000);
+  tRun before = run(job, true), after = run(job, false);
+  printf("%d tokens: %.0f tokens/s, was %.0f; %.0f keypad reads per second, was %.0f; "
+    "cancel seen after %.3f sec, was %.3f sec\n", (int)job.size(), after.tokens_s,
+    before.tokens_s, after.reads_s, before.reads_s, after.latency, before.latency);
+  CHECK(after.tokens_s > before.tokens_s * 1.5);
+  CHECK(after.reads_s < 1.1 / KEY_SAMPLE_INTERVAL);
+  CHECK(after.latency <= 2 * KEY_SAMPLE_INTERVAL + UI_PERIOD);
+  return TEST_RESULT("test_keys");
+}
@@ -0,0 +1,189 @@
+/**
+ * test_log.cpp
+ * Deferred logging: the cycles of a log call, of a dropped one and of
+ * printing one; a full ring drops and counts; and in a job simulated with
+ * the scheduler of main.cpp the log task keeps up with a busy feeder, where
+ * it used to wait for the planner queue to run empty
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include "mbed.h"
+#include "LaosLog.h"
+#include "LaosSched.h"
+#include "test.h"
+
+#define CALLS 100000
+
+// stdout to /dev/null and back: log_flush() prints
+static int saved_stdout = -1;
+
+static void quiet(bool on)
+{
+  fflush(stdout);
+  if (on)
+  {
+    saved_stdout = dup(1);
+    int fd = open("/dev/null", O_WRONLY);
+    dup2(fd, 1);
+    close(fd);
+  }
+  else
+  {
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+  }
+}
+
+static void drain()
+{
+  quiet(true);
+  while (log_pending())
+    log_flush();
+  quiet(false);
+}
+
+// Cycles per call [DWT->CYCCNT, host nanoseconds here]: a log call, one
+// that is dropped and printing one message
+static void test_cycles()
+{
+  drain();
+  uint32_t write = 0, drop = 0, flush = 0;
+  quiet(true);
+  for (int i = 0; i < CALLS / LOG_RING_SIZE; i++)
+  {
+    uint32_t t = DWT->CYCCNT;
+    for (int k = 0; k < LOG_RING_SIZE; k++)
+      LOGSTR(LOG_LEVEL_INFO, LOG_SYS, "%s %d %d\n", "message", i, k);
+    write += DWT->CYCCNT - t;
+    t = DWT->CYCCNT;
+    LOG_INFO(LOG_SYS, "dropped %d\n", i);
+    drop += DWT->CYCCNT - t;
+    t = DWT->CYCCNT;
+    while (log_pending())
+      log_flush(1);
+    flush += DWT->CYCCNT - t;
+  }
+  quiet(false);
+  int n = CALLS / LOG_RING_SIZE * LOG_RING_SIZE;
+  printf("log call %u cycles, dropped %u, print %u\n", write / n,
+    drop / (CALLS / LOG_RING_SIZE), flush / (n + CALLS / LOG_RING_SIZE));
+  CHECK(write / n * 10 < flush / n);
+}
+
+// A full ring: the rest is dropped and counted, the report of it is pending
+static void test_full()
+{
+  drain();
+  unsigned int dropped = log_dropped();
+  for (int i = 0; i < LOG_RING_SIZE + 5; i++)
+    LOG_INFO(LOG_SYS, "message %d\n", i);
+  CHECK(log_dropped() - dropped == 5);
+  CHECK(log_pending() == LOG_RING_SIZE + 1);
+  quiet(true);
+  CHECK(log_flush(1) == LOG_RING_SIZE - 1);
+  quiet(false);
+  CHECK(log_pending() == LOG_RING_SIZE - 1);
+  drain();
+  CHECK(log_pending() == 0);
+}
+
+// A job: the stepper takes a block every 2 ms out of a queue of 16, the
+// feeder adds one per run and logs every 8th; net and ui poll. Time is in
+// 0.1 ms: a feeder run takes 0.2 ms, a poll 0.1 ms and printing a message
+// 4 ms (50 characters at 115200 baud).
+#define QUEUE 16
+#define LOG_EVERY 8
+static int now = 0, queue = 0, fed = 0, step_at = 0, underruns = 0;
+static bool idle_only = false; // the old rule: print when the queue is empty
+
+static int read_ms() { return now / 10; }
+
+static void tick(int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    now++;
+    if (now >= step_at + 20)
+    {
+      step_at = now;
+      if (queue > 0)
+        queue--;
+      else
+        underruns++;
+    }
+  }
+}
+
+static int feed_ready() { return queue < QUEUE; }
+static void feed_run()
+{
+  queue++;
+  if (fed++ % LOG_EVERY == 0)
+    LOG_INFO(LOG_MOTION, "block %d\n", fed);
+  tick(2);
+}
+static void poll_run() { tick(1); }
+static int log_ready() { return idle_only ? queue == 0 && log_pending() : log_pending(); }
+static void log_run()
+{
+  int pending = log_pending();
+  log_flush(queue == 0 ? 4 : 1);
+  tick(40 * (pending - log_pending()));
+}
+
+static tSchedTask task_feed = { "feed", 2, feed_ready, feed_run, 0 };
+static tSchedTask task_net = { "net", 1, NULL, poll_run, 10 };
+static tSchedTask task_ui = { "ui", 1, NULL, poll_run, 20 };
+static tSchedTask task_log = { "log", 1, log_ready, log_run, 50 };
+
+static unsigned int job(bool old)
+{
+  drain();
+  idle_only = old;
+  now = queue = fed = step_at = underruns = 0;
+  unsigned int dropped = log_dropped();
+  quiet(true);
+  while (now < 100000)
+    if (!sched_run())
+      tick(1);
+  quiet(false);
+  return log_dropped() - dropped;
+}
+
+static void test_job()
+{
+  sched_set_clock(read_ms, NULL);
+  sched_add(&task_feed);
+  sched_add(&task_net);
+  sched_add(&task_ui);
+  sched_add(&task_log);
+  unsigned int old = job(true), now_dropped = job(false);
+  printf("10 s job, %d messages: %u dropped, was %u; %d underruns\n", fed / LOG_EVERY, now_dropped,
+    old, underruns);
+  CHECK(old > 0);
+  CHECK(now_dropped == 0);
+  CHECK(underruns == 0);
+}
+
+int main()
+{
+  test_cycles();
+  test_full();
+  test_job();
+  return TEST_RESULT("test_log");
+}
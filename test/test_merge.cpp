@@ -0,0 +1,217 @@
+/**
+ * test_merge.cpp
+ * Merging of collinear lines (motion.mergetolerance): the merged job has
+ * fewer blocks and does not take longer, and every point of the job stays
+ * within the tolerance of the path that is executed, also for runs of
+ * lines shorter than a step
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "motion_host.h"
+#include "test.h"
+
+#define TOLERANCE 5 // motion.mergetolerance [micron]
+
+typedef struct { double x, y; } tPoint; // [micron]
+
+// A job of polylines, with the points it passes
+typedef struct {
+  std::vector<int> values;
+  std::vector<tPoint> points;
+  int x, y;
+} tJob;
+
+static void job_start(tJob &job)
+{
+  job.values.clear();
+  job.points.clear();
+  job.x = job.y = 0;
+  int start[] = { 7, 100, 5000, 7, 101, 5000, 0, 0, 0 };
+  job.values.assign(start, start + sizeof(start) / sizeof(start[0]));
+  tPoint p = { 0, 0 };
+  job.points.push_back(p);
+}
+
+static void job_line(tJob &job, int x, int y)
+{
+  int v[] = { 1, x, y };
+  job.values.insert(job.values.end(), v, v + 3);
+  job.x = x;
+  job.y = y;
+  tPoint p = { (double)x, (double)y };
+  job.points.push_back(p);
+}
+
+// a polyline of n segments of dx, dy [micron]
+static void job_polyline(tJob &job, int n, int dx, int dy)
+{
+  job.values.push_back(14);
+  job.values.push_back(n);
+  for (int i = 0; i < n; i++)
+  {
+    job.values.push_back(dx);
+    job.values.push_back(dy);
+    job.x += dx;
+    job.y += dy;
+    tPoint p = { (double)job.x, (double)job.y };
+    job.points.push_back(p);
+  }
+}
+
+// a circle of n segments, as a polyline
+static void job_circle(tJob &job, int cx, int cy, int r, int n)
+{
+  job_line(job, cx + r, cy);
+  job.values.push_back(14);
+  job.values.push_back(n);
+  for (int i = 1; i <= n; i++)
+  {
+    int x = cx + (int)lround(r * cos(2 * M_PI * i / n));
+    int y = cy + (int)lround(r * sin(2 * M_PI * i / n));
+    job.values.push_back(x - job.x);
+    job.values.push_back(y - job.y);
+    job.x = x;
+    job.y = y;
+    tPoint p = { (double)x, (double)y };
+    job.points.push_back(p);
+  }
+}
+
+// Run a job with the merge tolerance, from 0,0; the executed path [micron]
+static void run(const tJob &job, int tolerance, std::vector<tPoint> &path)
+{
+  host_power_cycle();
+  mot->home(0, 0, 0);
+  mot->setOriginAbsolute(0, 0, 0);
+  mot->reset();
+  cfg->mergetolerance = tolerance;
+  st_job_start();
+  host_feed(job.values, 0, job.values.size());
+  host_end_job();
+  host_drain();
+  st_job_end();
+  path.clear();
+  tPoint home = { 0, 0 };
+  path.push_back(home);
+  for (size_t i = 0; i < st_trace.size(); i++)
+  {
+    tPoint p = { st_trace[i].x * 1e6 / cfg->xscale, st_trace[i].y * 1e6 / cfg->yscale };
+    path.push_back(p);
+  }
+}
+
+static double distance(const tPoint &p, const tPoint &a, const tPoint &b)
+{
+  double dx = b.x - a.x, dy = b.y - a.y;
+  double len2 = dx*dx + dy*dy;
+  double t = len2 > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0;
+  t = t < 0 ? 0 : (t > 1 ? 1 : t);
+  double ex = a.x + t * dx - p.x, ey = a.y + t * dy - p.y;
+  return sqrt(ex*ex + ey*ey);
+}
+
+// The largest distance of a point of the job to the executed path. The
+// path is followed in order: each point is matched with the first block
+// from the one of the previous point on that passes within 'limit', so a
+// point that the path passed again later does not skip the blocks between.
+// A point without a match counts with its distance to the nearest block.
+static double deviation(const tJob &job, const std::vector<tPoint> &path, double limit)
+{
+  double worst = 0;
+  size_t from = 0;
+  for (size_t i = 0; i < job.points.size(); i++)
+  {
+    double best = 1e30;
+    for (size_t j = from; j + 1 < path.size(); j++)
+    {
+      double d = distance(job.points[i], path[j], path[j+1]);
+      if (d <= limit)
+      {
+        best = d;
+        from = j;
+        break;
+      }
+      if (d < best)
+        best = d;
+    }
+    if (best > worst)
+      worst = best;
+  }
+  return worst;
+}
+
+// Runs of lines shorter than a step, which go back or turn away: merged
+// into the held line, they may not move it away from the path
+static void test_substeps()
+{
+  double step = 1e6 / cfg->xscale; // [micron]
+  tJob job;
+  job_start(job);
+  job_line(job, 10000, 0);
+  job_polyline(job, 3000, -2, 0); // back, 2 micron at a time
+  job_line(job, 20000, 0);
+  job_polyline(job, 1000, 0, 2); // sideways
+  job_line(job, 30000, 2000);
+  job_polyline(job, 500, 2, 1); // on in the same direction
+  job_polyline(job, 500, 1, -2);
+
+  std::vector<tPoint> path;
+  run(job, TOLERANCE, path);
+  double dev = deviation(job, path, TOLERANCE + step);
+  printf("short lines: %u segments, %u blocks, deviation %.1f micron\n",
+    (unsigned)merge_stats.segments, (unsigned)st_trace.size(), dev);
+  CHECK(dev <= TOLERANCE + step);
+  CHECK(st_trace.size() < 100); // they are still merged
+}
+
+// Circles and straight lines in short segments: fewer blocks, and no slower
+static void test_job()
+{
+  double step = 1e6 / cfg->xscale; // [micron]
+  tJob job;
+  job_start(job);
+  for (int i = 0; i < 5; i++)
+  {
+    job_circle(job, 30000 + i * 25000, 30000, 10000, 400 + 200 * i);
+    job_polyline(job, 300, 30, 10);
+    job_polyline(job, 300, 0, 30);
+  }
+
+  std::vector<tPoint> path;
+  run(job, 0, path);
+  size_t blocks = st_trace.size();
+  double time = st_time;
+  double dev0 = deviation(job, path, step);
+  run(job, TOLERANCE, path);
+  size_t merged_blocks = st_trace.size();
+  double merged_time = st_time;
+  double dev = deviation(job, path, TOLERANCE + step);
+  printf("%u segments: %u blocks in %.2f sec unmerged, %u blocks in %.2f sec merged, deviation %.1f micron\n",
+    (unsigned)merge_stats.segments, (unsigned)blocks, time, (unsigned)merged_blocks, merged_time, dev);
+  CHECK(merged_blocks * 3 < blocks);
+  CHECK(merged_time <= time * 1.001);
+  CHECK(dev0 <= step);
+  CHECK(dev <= TOLERANCE + step);
+}
+
+int main()
+{
+  host_init();
+  test_substeps();
+  test_job();
+  return TEST_RESULT("test_merge");
+}
@@ -0,0 +1,203 @@
+/**
+ * test_optimize.cpp
+ * Path optimizer: a job of scattered paths has less travel after it, marks
+ * the same lines in the same direction and keeps the speed/power commands
+ * in their place; Run() in steps writes the same file, and a write error
+ * makes the result unusable
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "LaosOptimize.h"
+#include "test.h"
+
+static std::string dir;
+
+typedef struct {
+  int x0, y0, x1, y1;
+} tSeg;
+
+static bool operator<(const tSeg &a, const tSeg &b)
+{
+  if (a.x0 != b.x0) return a.x0 < b.x0;
+  if (a.y0 != b.y0) return a.y0 < b.y0;
+  if (a.x1 != b.x1) return a.x1 < b.x1;
+  return a.y1 < b.y1;
+}
+
+static bool operator==(const tSeg &a, const tSeg &b)
+{
+  return !(a < b) && !(b < a);
+}
+
+// What a job marks: the lines between speed/power commands (each group
+// sorted: the order within a group may change), the speed/power commands,
+// and the travel [mm]
+typedef struct {
+  std::vector<std::vector<tSeg> > groups;
+  std::vector<std::string> barriers;
+  double travel;
+} tJob;
+
+static tJob parse(const std::string &name)
+{
+  tJob j;
+  j.groups.resize(1);
+  j.travel = 0;
+  FILE *fp = fopen(name.c_str(), "rb");
+  if (fp == NULL)
+    return j;
+  int cmd, a, b, x = 0, y = 0;
+  while (fscanf(fp, "%d %d %d", &cmd, &a, &b) == 3)
+  {
+    if (cmd == 0)
+      j.travel += sqrt((double)(a-x)*(a-x) + (double)(b-y)*(b-y)) / 1000;
+    else if (cmd == 1)
+    {
+      tSeg s = { x, y, a, b };
+      j.groups.back().push_back(s);
+    }
+    else
+    {
+      char buf[32];
+      sprintf(buf, "%d %d %d", cmd, a, b);
+      j.barriers.push_back(buf);
+      j.groups.resize(j.groups.size() + 1);
+      continue;
+    }
+    x = a;
+    y = b;
+  }
+  fclose(fp);
+  for (size_t i = 0; i < j.groups.size(); i++)
+    std::sort(j.groups[i].begin(), j.groups[i].end());
+  return j;
+}
+
+// Short open and closed paths all over the bed, with a speed/power change
+// every 'group' paths
+static std::string make_job(int paths, int group)
+{
+  std::string name = dir + "/job.lgc";
+  FILE *fp = fopen(name.c_str(), "wb");
+  fprintf(fp, "7 100 5000\n");
+  for (int i = 0; i < paths; i++)
+  {
+    if (i > 0 && i % group == 0)
+      fprintf(fp, "7 101 %d\n", 1000 + i);
+    int x = rand() % 600000, y = rand() % 400000;
+    fprintf(fp, "0 %d %d\n", x, y);
+    int n = 1 + rand() % 4;
+    for (int k = 0; k < n; k++)
+      fprintf(fp, "1 %d %d\n", x + rand() % 5000, y + rand() % 5000);
+    if (rand() % 2)
+      fprintf(fp, "1 %d %d\n", x, y); // closed
+  }
+  fclose(fp);
+  return name;
+}
+
+// Optimize name to out, in steps of n commands (0: Run()); closing out
+// counts if 'close'
+static bool optimize(const std::string &name, const std::string &out, int n, LaosOptimize &opt,
+  bool close = true)
+{
+  FILE *in = fopen(name.c_str(), "rb"), *copy = fopen(name.c_str(), "rb");
+  FILE *fp = fopen(out.c_str(), "wb");
+  bool better;
+  if (n == 0)
+    better = opt.Run(in, copy, fp);
+  else
+  {
+    opt.Start(in, copy, fp);
+    while (opt.Step(n))
+      ;
+    better = opt.Finish();
+  }
+  fclose(in);
+  fclose(copy);
+  return (fclose(fp) == 0 || !close) && better;
+}
+
+static std::string contents(const std::string &name)
+{
+  std::string s;
+  FILE *fp = fopen(name.c_str(), "rb");
+  int c;
+  while (fp != NULL && (c = getc(fp)) != EOF)
+    s += (char)c;
+  if (fp != NULL)
+    fclose(fp);
+  return s;
+}
+
+static void test_order()
+{
+  srand(1);
+  std::string name = make_job(500, 100), out = dir + "/out.lgc";
+  LaosOptimize opt;
+  CHECK(optimize(name, out, 0, opt));
+  tJob before = parse(name), after = parse(out);
+  printf("optimized: travel %.0f mm, was %.0f mm\n", after.travel, before.travel);
+  CHECK(after.travel < before.travel / 2);
+  CHECK(fabs(after.travel - opt.GetTravelAfter()) < 1);
+  CHECK(fabs(before.travel - opt.GetTravelBefore()) < 1);
+  CHECK(after.barriers == before.barriers);
+  CHECK(after.groups == before.groups);
+
+  // in steps, down to one command at a time: the same file
+  std::string out2 = dir + "/out2.lgc";
+  int steps[] = { 1, 7, LAOSOPTIMIZE_PATHS, 1000 };
+  for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+  {
+    LaosOptimize opt2;
+    CHECK(optimize(name, out2, steps[i], opt2));
+    CHECK(contents(out2) == contents(out));
+  }
+  unlink(out.c_str());
+  unlink(out2.c_str());
+  unlink(name.c_str());
+}
+
+// A full disk: Run() and Finish() return false, whatever the travel (the
+// job is larger than the stdio buffer: the error is seen before fclose())
+static void test_error()
+{
+  srand(2);
+  std::string name = make_job(2000, 2000);
+  LaosOptimize opt;
+  CHECK(optimize(name, dir + "/out.lgc", 0, opt));
+  CHECK(!optimize(name, "/dev/full", 0, opt, false));
+  CHECK(!optimize(name, "/dev/full", 16, opt, false));
+  unlink((dir + "/out.lgc").c_str());
+  unlink(name.c_str());
+}
+
+int main()
+{
+  char tmp[] = "/tmp/laosoptXXXXXX";
+  CHECK(mkdtemp(tmp) != NULL);
+  dir = tmp;
+  test_order();
+  test_error();
+  rmdir(tmp);
+  return TEST_RESULT("test_optimize");
+}
@@ -0,0 +1,96 @@
+/**
+ * test_override.cpp
+ * Feed rate override: changed at random moments of a job, also while the
+ * stepper runs a block, the executed blocks stay within their acceleration
+ * limits and join without a jump in speed
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include "motion_host.h"
+#include "test.h"
+
+#define SPEED_TOL 1.0   // speed difference at a junction [mm/sec]
+#define ACCEL_TOL 1.02  // acceleration over the limit (rounding of the step rates)
+
+static int changes = 0;
+
+// the operator presses UP or DOWN
+static void change_override()
+{
+  if (rand() % 7 == 0)
+  {
+    plan_set_feed_override(OVERRIDE_MIN + rand() % (OVERRIDE_MAX - OVERRIDE_MIN + 1));
+    changes++;
+  }
+}
+
+static bool feed_hook(size_t next)
+{
+  change_override();
+  return true;
+}
+
+// check the executed blocks against the physics of the machine
+static void check_trace()
+{
+  float last_exit = 0;
+  float worst = 0;
+  int errors = 0;
+  for (size_t i = 0; i < st_trace.size(); i++)
+  {
+    const tStepTrace &s = st_trace[i];
+    if (s.steps == 0)
+      continue;
+    bool ok = fabs(s.entry - last_exit) <= SPEED_TOL; // no jump at the junction
+    ok = ok && s.entry <= s.nominal + SPEED_TOL && s.exit <= s.nominal + SPEED_TOL;
+    ok = ok && s.accel <= s.accel_max * ACCEL_TOL;
+    // the speed change needs no more than the ramps allow over the block
+    float need = fabs(s.exit*s.exit - s.entry*s.entry) / (2 * s.mm);
+    ok = ok && need <= s.accel_max * ACCEL_TOL + 1;
+    if (s.accel_max > 0 && need / s.accel_max > worst)
+      worst = need / s.accel_max;
+    if (!ok && errors++ < 10)
+      printf("block %u: entry %.1f exit %.1f nominal %.1f [mm/sec], after %.1f; accel %.0f, needs %.0f, limit %.0f [mm/sec2]\n",
+        (unsigned)i, s.entry, s.exit, s.nominal, last_exit, s.accel, need, s.accel_max);
+    last_exit = s.exit;
+  }
+  CHECK(errors == 0);
+  CHECK(last_exit <= SPEED_TOL); // the job ends at standstill
+  printf("%u blocks, %d override changes, worst speed change %.3f of the acceleration limit\n",
+    (unsigned)st_trace.size(), changes, worst);
+}
+
+int main(int argc, char **argv)
+{
+  srand(argc > 1 ? atoi(argv[1]) : 1);
+  host_init();
+  std::vector<int> job;
+  host_random_job(job, 3000);
+
+  st_host_busy = change_override;
+  st_job_start();
+  host_feed(job, 0, job.size(), feed_hook);
+  host_end_job(feed_hook);
+  host_drain(feed_hook);
+  st_job_end();
+  st_host_busy = NULL;
+
+  CHECK(changes > 100);
+  CHECK(st_host_changed == 0); // the running block keeps its plan
+  check_trace();
+  return TEST_RESULT("test_override");
+}
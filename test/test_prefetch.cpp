@@ -0,0 +1,305 @@
+/**
+ * test_prefetch.cpp
+ * The job prefetch ring (laser/LaosPrefetch) on a slow card: a file in a
+ * temporary directory, opened through a stand-in that counts each read and
+ * charges it a card access and transfer time. The tokens are the same as
+ * with readint(); the card is read in chunk aligned reads ahead of the
+ * parser; a small job runs again from the ring, without the card; and the
+ * fill level telemetry matches what the parser waited for
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "LaosPrefetch.h"
+#include "test.h"
+
+#define ACCESS_MS 1.0  // card time per read [ms]
+#define SECTOR_MS 0.5  // and per sector
+#define LARGE "large.lgc"
+#define SMALL "small.lgc"
+
+LaosFileSystem sd;
+
+// What the card did: reads, and the time of those the parser waited for
+static struct {
+  long opens, reads, bytes, misaligned, short_reads;
+  long waits;          // reads the parser waited for
+  double busy, waited; // [ms]
+} card;
+static bool in_parser; // a read now is one the parser waits for
+
+// An open file of the card: the host file, and the stdio buffer
+typedef struct {
+  FILE *f;
+  char buf[PREFETCH_CHUNK];
+} tCardFile;
+
+static ssize_t card_read(void *cookie, char *buf, size_t n)
+{
+  FILE *f = ((tCardFile *)cookie)->f;
+  long at = ftell(f);
+  size_t got = fread(buf, 1, n, f);
+  double t = ACCESS_MS + SECTOR_MS * ((at % 512 + got + 511) / 512);
+  card.reads++;
+  card.bytes += got;
+  card.busy += t;
+  if (in_parser)
+  {
+    card.waits++;
+    card.waited += t;
+  }
+  if (at % PREFETCH_CHUNK)
+    card.misaligned++;
+  if (got < PREFETCH_CHUNK && !feof(f))
+    card.short_reads++;
+  return got;
+}
+
+static int card_seek(void *cookie, off64_t *offset, int whence)
+{
+  FILE *f = ((tCardFile *)cookie)->f;
+  if (fseek(f, *offset, whence))
+    return -1;
+  *offset = ftell(f);
+  return 0;
+}
+
+static int card_close(void *cookie)
+{
+  tCardFile *c = (tCardFile *)cookie;
+  int r = fclose(c->f);
+  delete c;
+  return r;
+}
+
+// sd.open: the file with a stdio buffer of one chunk, so a chunk read
+// with fread() is one card read
+static FILE *card_open(const char *path, const char *mode)
+{
+  static cookie_io_functions_t io = { card_read, NULL, card_seek, card_close };
+  FILE *f = fopen(path, mode);
+  if (f == NULL)
+    return NULL;
+  card.opens++;
+  tCardFile *c = new tCardFile;
+  c->f = f;
+  FILE *fp = fopencookie(c, mode, io);
+  setvbuf(fp, c->buf, _IOFBF, sizeof(c->buf));
+  return fp;
+}
+
+static std::string card_path(const char *name)
+{
+  return std::string(sd.pathname) + name;
+}
+
+// A job of about 'size' bytes: moves, lines, settings and comments
+static std::string make_job(size_t size)
+{
+  std::string s;
+  char line[64];
+  while (s.size() < size)
+  {
+    switch (rand() % 8)
+    {
+      case 0: snprintf(line, sizeof(line), "7 %d %d\n", 100 + rand() % 2, rand() % 10001); break;
+      case 1: snprintf(line, sizeof(line), "; layer %d\r\n", rand() % 100); break;
+      case 2: snprintf(line, sizeof(line), "0 %d\t%d\n", rand() % 300000, -(rand() % 1000)); break;
+      default: snprintf(line, sizeof(line), "1 %d %d\n", rand() % 300000, rand() % 200000); break;
+    }
+    s += line;
+  }
+  return s;
+}
+
+static void write_job(const char *name, const std::string &job)
+{
+  FILE *fp = fopen(card_path(name).c_str(), "wb");
+  fwrite(job.data(), 1, job.size(), fp);
+  fclose(fp);
+}
+
+// The values of a job from 'pos' on, with the rules of readint()
+static std::vector<int> tokens(const std::string &job, size_t pos)
+{
+  std::vector<int> out;
+  while (pos < job.size())
+  {
+    unsigned i = 0;
+    int sign = 1, val = 0;
+    for (; pos < job.size(); pos++)
+    {
+      char c = job[pos];
+      if (c >= '0' && c <= '9')
+      {
+        if (i < 16)
+          val = val * 10 + (c - '0');
+        i++;
+      }
+      else if (c == '-')
+        sign = -1;
+      else if (c == ';')
+        while (pos + 1 < job.size() && job[pos] != '\n')
+          pos++;
+      else if ((c == ' ' || c == '\t' || c == '\r' || c == '\n') && i)
+        break;
+    }
+    pos++;
+    out.push_back(pos <= job.size() ? val * sign : 0);
+  }
+  return out;
+}
+
+// The main loop: each pass the prefetch task reads a chunk if there is
+// room ('fill'), then the feeder takes up to 'per_pass' values
+static std::vector<int> parse(int per_pass, bool fill)
+{
+  std::vector<int> out;
+  while (!prefetch_eof())
+  {
+    if (fill && prefetch_room())
+      prefetch_fill();
+    for (int k = 0; k < per_pass && !prefetch_eof(); k++)
+    {
+      in_parser = true;
+      out.push_back(prefetch_readint());
+      in_parser = false;
+    }
+  }
+  return out;
+}
+
+static void run(const char *name, std::vector<int> &out, int per_pass, bool fill)
+{
+  char n[MAXFILESIZE];
+  strcpy(n, name);
+  memset(&card, 0, sizeof(card));
+  CHECK(prefetch_open(n));
+  out = parse(per_pass, fill);
+  prefetch_close();
+}
+
+// The card is read ahead in whole chunks; the parser does not wait
+static void test_ahead(const std::string &job)
+{
+  std::vector<int> out;
+  run(LARGE, out, 3, true);
+  long chunks = (job.size() + PREFETCH_CHUNK - 1) / PREFETCH_CHUNK;
+  printf("%u bytes: %ld card reads, the parser waited %.1f of %.1f ms; least ahead %lu bytes, "
+    "%lu waits\n", (unsigned)job.size(), card.reads, card.waited, card.busy,
+    prefetch_stats.min_level, prefetch_stats.starved);
+  CHECK(out == tokens(job, 0));
+  CHECK(card.reads == chunks && card.bytes == (long)job.size());
+  CHECK(card.misaligned == 0 && card.short_reads == 0);
+  CHECK(prefetch_stats.sd_bytes == job.size() && !prefetch_stats.cached);
+  CHECK(prefetch_stats.starved == 0 && card.waits == 0);
+  CHECK(prefetch_stats.min_level >= PREFETCH_CHUNK / 2); // after the first chunk
+}
+
+// A feeder faster than the prefetch task, and none: the ring runs dry,
+// and each wait of the telemetry is a card read of the parser
+static void test_starved(const std::string &job)
+{
+  std::vector<int> out;
+  run(LARGE, out, 500, true);
+  double waited = card.waited;
+  unsigned long starved = prefetch_stats.starved;
+  CHECK(out == tokens(job, 0));
+  CHECK(starved > 1 && (long)starved == card.waits && prefetch_stats.min_level == 0);
+
+  run(LARGE, out, 1, false);
+  printf("fast feeder: %lu waits, %.1f ms; no prefetch task: %lu waits, %.1f ms\n",
+    starved, waited, prefetch_stats.starved, card.waited);
+  CHECK(out == tokens(job, 0));
+  CHECK((long)prefetch_stats.starved == card.reads && card.waits == card.reads);
+  CHECK(card.misaligned == 0);
+}
+
+// A resume: the values from the offset on; a seek back within the ring does
+// not read the card
+static void test_seek(const std::string &job)
+{
+  char n[] = LARGE;
+  memset(&card, 0, sizeof(card));
+  CHECK(prefetch_open(n));
+  long offset = job.size() / 2;
+  while (job[offset - 1] != '\n')
+    offset++;
+  prefetch_seek(offset);
+  std::vector<int> out = parse(3, true);
+  CHECK(out == tokens(job, offset));
+  CHECK(card.misaligned == 0 && card.bytes < (long)job.size() / 2 + PREFETCH_CHUNK);
+
+  long reads = card.reads;
+  offset = job.size() - PREFETCH_SIZE / 2;
+  while (job[offset - 1] != '\n')
+    offset++;
+  prefetch_seek(offset);
+  CHECK(parse(3, true) == tokens(job, offset));
+  CHECK(card.reads == reads);
+  prefetch_close();
+}
+
+// A job that fits in the ring runs again without the card, until the file
+// is uploaded again; a larger one is read again
+static void test_cached(const std::string &large)
+{
+  std::string job = make_job(PREFETCH_SIZE - 200);
+  write_job(SMALL, job);
+  std::vector<int> out;
+  run(SMALL, out, 3, true);
+  CHECK(out == tokens(job, 0) && !prefetch_stats.cached && card.opens == 1);
+  run(SMALL, out, 3, true);
+  printf("%u byte job again: %ld card reads, %lu bytes, cached %d\n", (unsigned)job.size(),
+    card.reads, prefetch_stats.sd_bytes, prefetch_stats.cached);
+  CHECK(out == tokens(job, 0));
+  CHECK(prefetch_stats.cached && card.opens == 0 && card.reads == 0 && prefetch_stats.sd_bytes == 0);
+
+  job = make_job(PREFETCH_SIZE / 2);
+  write_job(SMALL, job);
+  prefetch_forget(SMALL);
+  run(SMALL, out, 3, true);
+  CHECK(out == tokens(job, 0) && !prefetch_stats.cached && card.bytes == (long)job.size());
+
+  run(LARGE, out, 3, true);
+  run(LARGE, out, 3, true);
+  CHECK(out == tokens(large, 0));
+  CHECK(!prefetch_stats.cached && card.bytes == (long)large.size());
+}
+
+int main()
+{
+  char dir[] = "/tmp/laosXXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  sprintf(sd.pathname, "%s/", dir);
+  sd.open = card_open;
+  srand(1);
+  std::string job = make_job(10 * PREFETCH_SIZE + 300);
+  write_job(LARGE, job);
+
+  test_ahead(job);
+  test_starved(job);
+  test_seek(job);
+  test_cached(job);
+
+  unlink(card_path(LARGE).c_str());
+  unlink(card_path(SMALL).c_str());
+  rmdir(dir);
+  return TEST_RESULT("test_prefetch");
+}
@@ -0,0 +1,98 @@
+/**
+ * test_profile.cpp
+ * The stepper interrupt profiler (ST_PROFILE) on a fake cycle counter:
+ * durations land in their log2 bucket, with count, min, max and average;
+ * the counter may wrap during a measurement; handlers longer than the step
+ * period count as late, and dropped ticks are counted
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "profile.h"
+#include "test.h"
+
+uint32_t prof_fake = 0; // the cycle counter (Makefile: PROF_CYCCNT)
+
+// An interrupt that takes 'cycles', with a step period of 'period' [usec]
+static void isr(uint32_t cycles, uint32_t period)
+{
+  PROF_START(t);
+  prof_fake += cycles;
+  PROF_ISR_END(t, period);
+}
+
+static void test_buckets()
+{
+  prof_init();
+  uint32_t d[] = { 0, 1, 2, 3, 4, 1000, 1023, 1024, 40000, 1u << 20 };
+  int bucket[] = { 0, 0, 1, 1, 2, 9, 9, 10, 15, 15 };
+  uint64_t sum = 0;
+  for (size_t i = 0; i < sizeof(d) / sizeof(d[0]); i++)
+  {
+    tProfHist before = prof_isr;
+    isr(d[i], 1000000);
+    CHECK(prof_isr.bucket[bucket[i]] == before.bucket[bucket[i]] + 1);
+    sum += d[i];
+  }
+  CHECK(prof_isr.count == sizeof(d) / sizeof(d[0]));
+  CHECK(prof_isr.min == 0);
+  CHECK(prof_isr.max == 1u << 20);
+  CHECK(prof_isr.sum == sum);
+  CHECK(prof_avg(&prof_isr) == sum / prof_isr.count);
+  CHECK(prof_late == 0);
+  prof_print();
+
+  prof_reset();
+  CHECK(prof_isr.count == 0 && prof_isr.max == 0 && prof_isr.min == 0xffffffff);
+  CHECK(prof_avg(&prof_isr) == 0);
+}
+
+// A measurement across the wrap of the 32 bit counter
+static void test_wrap()
+{
+  prof_reset();
+  prof_fake = 0xfffffff0;
+  isr(100, 1000);
+  CHECK(prof_isr.max == 100 && prof_isr.bucket[6] == 1);
+  PROF_START(t);
+  prof_fake += 3000;
+  PROF_END(prof_block, t);
+  CHECK(prof_block.count == 1 && prof_block.max == 3000 && prof_block.bucket[11] == 1);
+}
+
+// Late: longer than the step period; dropped: ticks while busy
+static void test_late()
+{
+  prof_reset();
+  isr(10 * PROF_CYCLES_PER_US, 10);
+  CHECK(prof_late == 0);
+  isr(10 * PROF_CYCLES_PER_US + 1, 10);
+  CHECK(prof_late == 1);
+  isr(5000, 1000);
+  CHECK(prof_late == 1);
+  for (int i = 0; i < 3; i++)
+    PROF_DROP();
+  CHECK(prof_drops == 3);
+  prof_reset();
+  CHECK(prof_drops == 0 && prof_late == 0);
+}
+
+int main()
+{
+  test_buckets();
+  test_wrap();
+  test_late();
+  return TEST_RESULT("test_profile");
+}
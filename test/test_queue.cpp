@@ -0,0 +1,164 @@
+/**
+ * test_queue.cpp
+ * Job queue: add, repeat counts, rotate, done and remove, on a queue file
+ * in a temporary directory; the queue is read back from the file each time
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include "LaosQueue.h"
+#include "test.h"
+
+static std::string path;
+
+// "name:runs name:runs ..." in queue order, read from the file
+static std::string dump()
+{
+  std::string s;
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL)
+    return "-";
+  tQueueEntry e;
+  while (fread(&e, sizeof(e), 1, fp) == 1)
+  {
+    char buf[MAXFILESIZE + 16];
+    sprintf(buf, "%s%s:%d", s.empty() ? "" : " ", e.name, e.runs);
+    s += buf;
+  }
+  fclose(fp);
+  return s;
+}
+
+#define CHECK_QUEUE(expect) do { std::string q = dump(); \
+    if (q != expect) printf("queue: \"%s\", expected \"%s\"\n", q.c_str(), expect); \
+    CHECK(q == expect); } while (0)
+
+static void test_add()
+{
+  tQueueEntry e;
+  CHECK(queue_count() == 0);
+  CHECK(!queue_head(&e));
+  queue_add("a.lgc");
+  queue_add("b.lgc");
+  queue_add("c.lgc");
+  CHECK_QUEUE("a.lgc:1 b.lgc:1 c.lgc:1");
+  queue_add("b.lgc"); // already queued: keeps its place and runs
+  CHECK_QUEUE("a.lgc:1 b.lgc:1 c.lgc:1");
+  CHECK(queue_count() == 3);
+  CHECK(queue_head(&e) && !strcmp(e.name, "a.lgc") && e.runs == 1);
+
+  // long names are cut to fit, and still found
+  queue_add("a_very_long_job_name_that_does_not_fit.lgc");
+  CHECK(queue_count() == 4);
+  queue_add("a_very_long_job_name_that_does_not_fit.lgc");
+  CHECK(queue_count() == 4);
+  queue_remove("a_very_long_job_name_that_does_not_fit.lgc");
+  CHECK(queue_count() == 3);
+}
+
+static void test_full()
+{
+  char name[MAXFILESIZE];
+  for (int i = queue_count(); i < QUEUE_MAX; i++)
+  {
+    sprintf(name, "job%d.lgc", i);
+    queue_add(name);
+  }
+  CHECK(queue_count() == QUEUE_MAX);
+  queue_add("more.lgc"); // the queue is full
+  CHECK(queue_count() == QUEUE_MAX);
+  for (int i = 3; i < QUEUE_MAX; i++)
+  {
+    sprintf(name, "job%d.lgc", i);
+    queue_remove(name);
+  }
+  CHECK_QUEUE("a.lgc:1 b.lgc:1 c.lgc:1");
+}
+
+static void test_runs()
+{
+  queue_set_runs("b.lgc", 3);
+  CHECK_QUEUE("a.lgc:1 b.lgc:3 c.lgc:1");
+  queue_set_runs("x.lgc", 5); // not queued
+  CHECK_QUEUE("a.lgc:1 b.lgc:3 c.lgc:1");
+  queue_done("b.lgc");
+  CHECK_QUEUE("a.lgc:1 b.lgc:2 c.lgc:1");
+  queue_done("b.lgc");
+  queue_done("b.lgc"); // the last run removes it
+  CHECK_QUEUE("a.lgc:1 c.lgc:1");
+  queue_done("b.lgc"); // no longer queued
+  CHECK_QUEUE("a.lgc:1 c.lgc:1");
+  queue_set_runs("c.lgc", 0); // 0 runs removes it
+  CHECK_QUEUE("a.lgc:1");
+  queue_add("b.lgc");
+  queue_add("c.lgc");
+  CHECK_QUEUE("a.lgc:1 b.lgc:1 c.lgc:1");
+}
+
+static void test_rotate()
+{
+  queue_set_runs("a.lgc", 2);
+  queue_rotate();
+  CHECK_QUEUE("b.lgc:1 c.lgc:1 a.lgc:2");
+  queue_rotate();
+  queue_rotate();
+  CHECK_QUEUE("a.lgc:2 b.lgc:1 c.lgc:1");
+  queue_remove("b.lgc");
+  queue_remove("c.lgc");
+  queue_rotate(); // a single job stays
+  CHECK_QUEUE("a.lgc:2");
+}
+
+// Run the queue the way the menu does: the head job, then queue_done()
+static void test_run_all()
+{
+  queue_add("b.lgc");
+  queue_set_runs("b.lgc", 3);
+  std::string order;
+  tQueueEntry e;
+  for (int i = 0; i < 10 && queue_head(&e); i++)
+  {
+    order += e.name[0];
+    queue_done(e.name);
+  }
+  CHECK(order == "aabbb");
+  CHECK(queue_count() == 0);
+  CHECK_QUEUE("");
+}
+
+int main()
+{
+  char dir[] = "/tmp/laosqueueXXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  path = std::string(dir) + "/" + QUEUE_FILE;
+
+  queue_add("a.lgc"); // no file yet: nothing happens
+  CHECK(queue_count() == 0);
+  CHECK_QUEUE("-");
+
+  queue_init(path.c_str());
+  test_add();
+  test_full();
+  test_runs();
+  test_rotate();
+  test_run_all();
+
+  unlink(path.c_str());
+  rmdir(dir);
+  return TEST_RESULT("test_queue");
+}
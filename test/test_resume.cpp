@@ -0,0 +1,353 @@
+/**
+ * test_resume.cpp
+ * RESUME JOB: a job that is interrupted at a random point and resumed from
+ * its last saved checkpoint outputs the same blocks as the uninterrupted job
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The checkpoints are taken and saved as LaosMenu does it, in job B, which
+ * is chained to job A: it starts with the blocks of job A still queued.
+ * Job B is a file in a temporary directory (the card), read with
+ * LaosPrefetch; the checkpoints are stored with checkpoint_save() and read
+ * back with checkpoint_load(). The resume is done as after a power cycle:
+ * home, restore the origin, seek to the offset, setState(), and continue.
+ */
+#include <stddef.h>
+#include <unistd.h>
+#include <string>
+#include "motion_host.h"
+#include "LaosCheckpoint.h"
+#include "LaosPrefetch.h"
+#include "test.h"
+
+#define ORIGIN_X 10000 // [micron]
+#define ORIGIN_Y 20000
+#define ZHOME 5000     // [micron], the job runs at z 0
+#define CHECKPOINT_EVERY 1000 // bytes of job B between checkpoints
+#define TRIALS 100
+#define JOB_B "job_b.lgc"
+
+LaosFileSystem sd;
+
+// A checkpoint, as LaosMenu::TakeCheckpoint() takes it
+typedef struct {
+  tCheckpoint cp;
+  uint32_t queued;    // plan_stats.queued when it was taken
+  bool saved;         // the stepper was past it: checkpoint_save() is done
+} tTaken;
+
+static std::vector<int> job_a;
+static std::vector<tTaken> taken;
+static bool in_b;         // job B is fed: take checkpoints
+static bool pending;      // the last checkpoint is not saved yet
+static long next_due;     // take a checkpoint from this offset of job B on
+static size_t stop_at;    // the power fails after this many blocks, 0: never
+
+// LaosMenu::TakeCheckpoint() and SaveCheckpoint()
+static bool checkpoint_hook(size_t)
+{
+  if (pending && plan_blocks_done(taken.back().queued))
+  {
+    // all blocks queued before the checkpoint are executed
+    CHECK(st_trace.size() >= taken.back().queued);
+    checkpoint_save(&taken.back().cp);
+    taken.back().saved = true;
+    pending = false;
+  }
+  if (in_b && !pending && prefetch_tell() >= next_due)
+  {
+    tTaken t;
+    memset(&t, 0, sizeof(t));
+    if (mot->getState(&t.cp.state))
+    {
+      strncpy(t.cp.name, JOB_B, MAXFILESIZE);
+      t.cp.size = prefetch_size();
+      t.cp.offset = prefetch_tell();
+      mot->getOriginAbsolute(&t.cp.origin[0], &t.cp.origin[1], &t.cp.origin[2]);
+      t.queued = plan_stats.queued;
+      t.saved = false;
+      taken.push_back(t);
+      pending = true;
+      next_due = t.cp.offset + CHECKPOINT_EVERY;
+    }
+  }
+  return !stop_at || st_trace.size() < stop_at;
+}
+
+// LaosMenu::Feed() and the prefetch task, on the open job: the next value
+// when LaosMotion is ready for it, otherwise the stepper executes a block.
+// Returns false if the hook stopped it.
+static bool feed_file(tFeedHook hook)
+{
+  while (!prefetch_eof())
+  {
+    if (prefetch_room())
+      prefetch_fill();
+    if (mot->ready())
+      mot->write(prefetch_readint());
+    else if (!st_host_run())
+    {
+      printf("feed_file: not ready, with an empty queue\n");
+      exit(1);
+    }
+    if (hook && !hook(0))
+      return false;
+  }
+  return true;
+}
+
+// Boot, home, and run job A and job B, until the power fails after 'stop'
+// blocks (0: never)
+static void run_jobs(size_t stop)
+{
+  host_power_cycle();
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  mot->setOriginAbsolute(ORIGIN_X, ORIGIN_Y, 0);
+  mot->reset();
+  taken.clear();
+  in_b = pending = false;
+  next_due = 1; // the first one with the blocks of job A still queued
+  stop_at = stop;
+  st_job_start();
+  if (host_feed(job_a, 0, job_a.size(), checkpoint_hook) < job_a.size() || !host_end_job(checkpoint_hook))
+    return;
+  // chained: LaosMenu::StartJobStats() without mot->reset()
+  char name[] = JOB_B;
+  CHECK(prefetch_open(name));
+  st_job_start();
+  plan_stats.blocks = 0;
+  in_b = true;
+  bool done = feed_file(checkpoint_hook) && host_end_job(checkpoint_hook);
+  prefetch_close();
+  if (!done)
+    return;
+  in_b = false;
+  if (host_drain(checkpoint_hook))
+    checkpoint_clear(); // the job is complete
+}
+
+// Boot, home and continue job B from a checkpoint; the blocks of job B are
+// in 'tail', the travel move to the checkpoint ends at 'at'
+static void resume(const tCheckpoint &cp, std::vector<tStepTrace> &tail, tStepTrace &at)
+{
+  host_power_cycle();
+  mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
+  mot->setOriginAbsolute(cp.origin[0], cp.origin[1], cp.origin[2]);
+  mot->reset();
+  st_job_start();
+  char name[MAXFILESIZE];
+  strcpy(name, cp.name);
+  CHECK(prefetch_open(name));
+  prefetch_seek(cp.offset);
+  mot->setState(&cp.state);
+  host_drain();
+  CHECK(!st_trace.empty());
+  if (!st_trace.empty())
+    at = st_trace.back();
+  size_t start = st_trace.size();
+  feed_file(NULL);
+  host_end_job();
+  host_drain();
+  prefetch_close();
+  tail.assign(st_trace.begin() + start, st_trace.end());
+}
+
+// the same output: position, steps, laser and bitmap (not the speeds)
+static bool same_output(const tStepTrace &a, const tStepTrace &b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z && a.steps == b.steps &&
+    a.options == b.options && a.power == b.power && a.bitmap == b.bitmap;
+}
+
+// The blocks from 'from' on, after a block that ends at 'start', with
+// lines in line of the same laser setting joined: LaosMotion merges those
+// as long as the stepper has other blocks to do (see ready()), and the
+// queue runs empty at other places after a resume
+static std::vector<tStepTrace> joined(const std::vector<tStepTrace> &t, size_t from, tStepTrace start)
+{
+  std::vector<tStepTrace> out;
+  tStepTrace last_start = start;
+  for (size_t i = from; i < t.size(); i++)
+  {
+    const tStepTrace &b = t[i];
+    if (!out.empty())
+    {
+      tStepTrace &last = out.back();
+      int64_t ax = last.x - last_start.x, ay = last.y - last_start.y;
+      int64_t bx = b.x - last.x, by = b.y - last.y;
+      if (!last.bitmap && !b.bitmap && b.options == last.options && b.power == last.power &&
+        b.z == last.z && last.z == last_start.z && ax * by == ay * bx && ax * bx + ay * by > 0)
+      {
+        last.x = b.x;
+        last.y = b.y;
+        last.steps += b.steps;
+        continue;
+      }
+      last_start = last;
+    }
+    out.push_back(b);
+  }
+  return out;
+}
+
+static std::string card(const char *name)
+{
+  return std::string(sd.pathname) + name;
+}
+
+// job B on the card, one value per line, after a comment
+static void write_job(const std::vector<int> &job)
+{
+  FILE *fp = fopen(card(JOB_B).c_str(), "wb");
+  CHECK(fp != NULL);
+  if (fp == NULL)
+    return;
+  fprintf(fp, "; job B\n");
+  for (size_t i = 0; i < job.size(); i++)
+    fprintf(fp, "%d\n", job[i]);
+  fclose(fp);
+}
+
+// invert byte 'at' of a file; at < 0: cut off its last -at bytes
+static void patch(const char *name, long at)
+{
+  FILE *fp = fopen(card(name).c_str(), "r+b");
+  CHECK(fp != NULL);
+  if (fp == NULL)
+    return;
+  if (at >= 0)
+  {
+    fseek(fp, at, SEEK_SET);
+    int c = fgetc(fp);
+    fseek(fp, at, SEEK_SET);
+    fputc(c ^ 0xff, fp);
+    fclose(fp);
+    return;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fclose(fp);
+  CHECK(truncate(card(name).c_str(), size + at) == 0);
+}
+
+// A checkpoint that is not complete, of another version, or of a job that
+// has changed is not offered
+static void test_invalid(const tCheckpoint &cp)
+{
+  tCheckpoint loaded;
+  checkpoint_save(&cp);
+  CHECK(checkpoint_load(&loaded));
+  CHECK(loaded.offset == cp.offset && loaded.state.z == cp.state.z);
+
+  patch(CHECKPOINT_FILE, offsetof(tCheckpoint, offset)); // a bad write
+  CHECK(!checkpoint_load(&loaded));
+  checkpoint_save(&cp);
+  patch(CHECKPOINT_FILE, offsetof(tCheckpoint, magic)); // another layout
+  CHECK(!checkpoint_load(&loaded));
+  checkpoint_save(&cp);
+  patch(CHECKPOINT_FILE, -4); // cut off
+  CHECK(!checkpoint_load(&loaded));
+
+  checkpoint_save(&cp);
+  patch(JOB_B, -1); // the job was replaced
+  CHECK(!checkpoint_load(&loaded));
+  FILE *fp = fopen(card(JOB_B).c_str(), "ab");
+  fputc('\n', fp);
+  fclose(fp);
+  CHECK(checkpoint_load(&loaded));
+  checkpoint_clear();
+  CHECK(!checkpoint_load(&loaded));
+}
+
+int main(int argc, char **argv)
+{
+  unsigned seed = argc > 1 ? atoi(argv[1]) : 1;
+  srand(seed);
+  char dir[] = "/tmp/laosXXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  sprintf(sd.pathname, "%s/", dir);
+
+  host_init();
+  cfg->zhome = ZHOME;
+  cfg->mergetolerance = 0; // only lines in line are merged, see joined()
+  std::vector<int> job_b;
+  host_random_job(job_a, 50);
+  host_random_job(job_b, 1000);
+  write_job(job_b);
+
+  tCheckpoint loaded;
+  run_jobs(0);
+  std::vector<tStepTrace> ref = st_trace;
+  std::vector<tTaken> ref_taken = taken;
+  CHECK(ref_taken.size() > 2);
+  for (size_t i = 0; i < ref_taken.size(); i++)
+    CHECK(ref_taken[i].saved);
+  CHECK(!checkpoint_load(&loaded)); // cleared at the end
+
+  int resumed = 0;
+  for (int trial = 0; trial < TRIALS; trial++)
+  {
+    size_t stop = 1 + rand() % (ref.size() - 1);
+    checkpoint_clear();
+    run_jobs(stop);
+    // the same job, up to the power failure
+    CHECK(st_trace.size() == stop);
+    bool prefix = true;
+    for (size_t i = 0; i < st_trace.size() && i < ref.size(); i++)
+      prefix = prefix && same_output(st_trace[i], ref[i]);
+    CHECK(prefix);
+
+    const tTaken *last = NULL;
+    for (size_t i = 0; i < taken.size(); i++)
+      if (taken[i].saved) last = &taken[i];
+    bool found = checkpoint_load(&loaded);
+    CHECK(found == (last != NULL));
+    if (!found || last == NULL) // RESUME JOB is not offered: the job starts again
+      continue;
+    CHECK(loaded.offset == last->cp.offset);
+    CHECK(!memcmp(&loaded.state, &last->cp.state, sizeof(tMotionState)));
+    size_t queued = last->queued;
+    CHECK(queued <= stop);
+
+    std::vector<tStepTrace> tail;
+    tStepTrace at;
+    memset(&at, 0, sizeof(at));
+    resume(loaded, tail, at);
+    // the travel move ends where the job was, z included
+    if (queued > 0)
+      CHECK(at.x == ref[queued-1].x && at.y == ref[queued-1].y && at.z == ref[queued-1].z);
+    std::vector<tStepTrace> expect = joined(ref, queued, queued ? ref[queued-1] : at);
+    std::vector<tStepTrace> got = joined(tail, 0, at);
+    CHECK(got.size() == expect.size());
+    size_t diff = 0;
+    for (size_t i = 0; i < got.size() && i < expect.size(); i++)
+      if (!same_output(got[i], expect[i])) diff++;
+    if (diff)
+      printf("seed %u, power fail after %u blocks, checkpoint at %u: %u blocks differ\n",
+        seed, (unsigned)stop, (unsigned)queued, (unsigned)diff);
+    CHECK(diff == 0);
+    resumed++;
+  }
+  printf("%u blocks, %u checkpoints, %d of %d interrupted runs resumed\n",
+    (unsigned)ref.size(), (unsigned)ref_taken.size(), resumed, TRIALS);
+
+  test_invalid(ref_taken.back().cp);
+
+  unlink(card(JOB_B).c_str());
+  unlink(card(CHECKPOINT_FILE).c_str());
+  rmdir(dir);
+  return TEST_RESULT("test_resume");
+}
@@ -0,0 +1,262 @@
+/**
+ * test_sched.cpp
+ * Scheduling policy of LaosSched, with a simulated clock: the ready task
+ * with the highest priority runs, tasks of the same priority take turns,
+ * and an overdue task goes first. The ui task reads the keypad, also while
+ * the feeder has nothing to do.
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "LaosSched.h"
+#include "test.h"
+
+static int now = 0;          // [ms]
+static uint32_t cycles = 0;
+
+static int read_ms() { return now; }
+static uint32_t read_cycles() { return cycles; }
+
+// The tasks of main.cpp; each is ready when its flag is set, and a run
+// takes 'cost' cycles and 1 ms
+enum { FEED, PREFETCH, NET, UI, LOG, NTASKS };
+static bool ready[NTASKS];
+static int runs[NTASKS];
+static uint32_t cost[NTASKS] = { 100, 200, 300, 400, 500 };
+static int last = -1;
+
+// The keypad: a key is pressed at key_down [ms]; the ui task samples it
+// (LaosDisplay::PollKeys() in main.cpp) and sets key_seen [ms]
+static int key_down = -1, key_seen = -1;
+
+static void run(int i)
+{
+  runs[i]++;
+  last = i;
+  cycles += cost[i];
+  now++;
+}
+
+static void poll_keys()
+{
+  if (key_down >= 0 && key_seen < 0 && now >= key_down)
+    key_seen = now;
+}
+
+static int feed_ready() { return ready[FEED]; }
+static int prefetch_ready() { return ready[PREFETCH]; }
+static int net_ready() { return ready[NET]; }
+static int ui_ready() { return ready[UI]; }
+static int log_ready() { return ready[LOG]; }
+static void feed_run() { run(FEED); }
+static void prefetch_run() { run(PREFETCH); }
+static void net_run() { run(NET); }
+static void ui_run() { poll_keys(); run(UI); }
+static void log_run() { run(LOG); }
+
+static tSchedTask tasks[NTASKS] = {
+  { "feed", 2, feed_ready, feed_run, 0 },
+  { "prefetch", 2, prefetch_ready, prefetch_run, 0 },
+  { "net", 1, net_ready, net_run, 10 },
+  { "ui", 1, ui_ready, ui_run, 20 },
+  { "log", 1, log_ready, log_run, 0 },
+};
+
+static void set_ready(bool feed, bool prefetch, bool net, bool ui, bool log)
+{
+  ready[FEED] = feed;
+  ready[PREFETCH] = prefetch;
+  ready[NET] = net;
+  ready[UI] = ui;
+  ready[LOG] = log;
+}
+
+// run n passes; the task of each pass in order, '-' if none ran
+static void run_passes(int n, char *order)
+{
+  for (int i = 0; i < n; i++)
+  {
+    last = -1;
+    if (!sched_run())
+      now++;
+    order[i] = last < 0 ? '-' : "fpnul"[last];
+  }
+  order[n] = 0;
+}
+
+// Let each task run once, in order, so none is overdue and the turns
+// start over at the feeder
+static void settle()
+{
+  for (int i = 0; i < NTASKS; i++)
+  {
+    memset(ready, 0, sizeof(ready));
+    ready[i] = true;
+    char order[2];
+    run_passes(1, order);
+  }
+  for (int i = 0; i < NTASKS; i++)
+    tasks[i].last = now;
+}
+
+static void test_idle()
+{
+  set_ready(false, false, false, false, false);
+  CHECK(sched_next(now) == NULL);
+  CHECK(!sched_run());
+  set_ready(false, false, false, false, true);
+  CHECK(sched_next(now) == &tasks[LOG]);
+}
+
+static void test_priority()
+{
+  char order[16];
+  settle();
+  set_ready(true, false, true, true, true); // the feeder has work: it goes first
+  run_passes(5, order);
+  CHECK(!strcmp(order, "fffff"));
+  set_ready(false, false, true, true, false); // then the others take turns
+  run_passes(4, order);
+  CHECK(!strcmp(order, "nunu"));
+}
+
+static void test_round_robin()
+{
+  char order[16];
+  settle();
+  set_ready(true, true, false, false, false);
+  run_passes(6, order);
+  CHECK(!strcmp(order, "fpfpfp"));
+  set_ready(false, true, true, true, true); // the priority goes before the turn
+  run_passes(1, order);
+  CHECK(!strcmp(order, "p"));
+  set_ready(false, false, true, true, true);
+  run_passes(6, order);
+  CHECK(!strcmp(order, "nulnul"));
+}
+
+static void test_overdue()
+{
+  settle();
+  set_ready(true, true, true, true, true);
+  now += 9;
+  CHECK(sched_next(now) == &tasks[FEED] || sched_next(now) == &tasks[PREFETCH]);
+  now += 1; // net has not run for 10 ms
+  CHECK(sched_next(now) == &tasks[NET]);
+  now += 10; // both are overdue: they take turns
+  char order[16];
+  run_passes(2, order);
+  CHECK(!strcmp(order, "un") || !strcmp(order, "nu"));
+  run_passes(1, order);
+  CHECK(order[0] == 'f' || order[0] == 'p');
+}
+
+// A busy feeder does not starve the display and the network
+static void test_max_wait()
+{
+  settle();
+  set_ready(true, true, true, true, true);
+  memset(runs, 0, sizeof(runs));
+  int net_last = now, ui_last = now, net_gap = 0, ui_gap = 0;
+  for (int i = 0; i < 1000; i++)
+  {
+    char order[2];
+    run_passes(1, order);
+    if (last == NET)
+    {
+      net_gap = now - 1 - net_last > net_gap ? now - 1 - net_last : net_gap;
+      net_last = now - 1;
+    }
+    if (last == UI)
+    {
+      ui_gap = now - 1 - ui_last > ui_gap ? now - 1 - ui_last : ui_gap;
+      ui_last = now - 1;
+    }
+  }
+  CHECK(runs[FEED] + runs[PREFETCH] > 800);
+  CHECK(runs[LOG] == 0);
+  // one pass late at most, when the other one is due too
+  CHECK(net_gap <= 11);
+  CHECK(ui_gap <= 21);
+  CHECK(runs[NET] >= 1000 / 11);
+  CHECK(runs[UI] >= 1000 / 21);
+}
+
+static void test_stats()
+{
+  sched_reset_stats();
+  settle();
+  set_ready(true, false, false, false, false);
+  char order[16];
+  run_passes(3, order);
+  CHECK(tasks[FEED].runs == 4);
+  CHECK(tasks[FEED].cycles == 4 * cost[FEED]);
+  CHECK(tasks[FEED].max_cycles == cost[FEED]);
+  CHECK(tasks[LOG].runs == 1);
+
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  if (fp == NULL)
+    return;
+  sched_fprint(fp);
+  char line[128] = "";
+  rewind(fp);
+  CHECK(fgets(line, sizeof(line), fp) != NULL);
+  fclose(fp);
+  CHECK(!strcmp(line, " feed=4/100/100 prefetch=1/200/200 net=1/300/300 ui=1/400/400 log=1/500/500"));
+
+  sched_reset_stats();
+  CHECK(tasks[FEED].runs == 0 && tasks[FEED].cycles == 0 && tasks[FEED].max_cycles == 0);
+}
+
+// A key is seen within the maximum wait of the ui task (20 ms), while the
+// feeder is busy, and while it waits for the planner (not ready)
+static void test_keys()
+{
+  for (int busy = 0; busy < 2; busy++)
+  {
+    settle();
+    set_ready(busy, busy, true, true, false);
+    tasks[UI].ready = NULL; // as in main.cpp: always ready
+    for (int press = 3; press < 200; press += 7)
+    {
+      key_down = now + press;
+      key_seen = -1;
+      char order[2];
+      for (int i = 0; i < 300 && key_seen < 0; i++)
+        run_passes(1, order);
+      CHECK(key_seen >= 0);
+      CHECK(key_seen - key_down <= 21);
+    }
+    tasks[UI].ready = ui_ready;
+  }
+  key_down = -1;
+}
+
+int main()
+{
+  sched_set_clock(read_ms, read_cycles);
+  for (int i = 0; i < NTASKS; i++)
+    sched_add(&tasks[i]);
+  test_idle();
+  test_priority();
+  test_round_robin();
+  test_overdue();
+  test_max_wait();
+  test_keys();
+  test_stats();
+  return TEST_RESULT("test_sched");
+}
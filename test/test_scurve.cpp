@@ -0,0 +1,172 @@
+/**
+ * test_scurve.cpp
+ * S-curve ramps (motion.scurve): the integer step period of ramp.h follows
+ * c = c0 / (2*sqrt(n+1/2)), and a job timed step by step with the trapezoid
+ * generator of the step interrupt keeps its peak acceleration, has a much
+ * lower peak jerk than with linear ramps, and takes at most SCURVE_PEAK
+ * times as long
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include "motion_host.h"
+#include "ramp.h"
+#include "test.h"
+
+#define BIN 0.002 // time resolution of the speed profile [sec]
+
+// The integer period against the float one, c = c0 / (2*sqrt(w^2+1/2)) with
+// w a smoothstep in time, over ramps up and down, long and short (a few steps
+// from standstill), for slow and fast accelerations (c0): within 3e-4, or one
+// unit of tFixedPt
+static void test_period()
+{
+  srand(1);
+  double worst = 0;
+  for (int k = 0; k < 2000; k++)
+  {
+    float w0 = k % 4 == 0 ? 0 : sqrt((float)(rand() % 200000));
+    float w1 = k % 3 == 0 ? 0 : (k % 5 == 0 ? w0 + (rand() % 100) / 10.0 : sqrt((float)(rand() % 200000)));
+    int32_t c0 = 200 + rand() % 40000; // [usec]
+    tRampGen g;
+    g.c0_half = to_fixed((uint32_t)c0) / 2;
+    tSRamp r;
+    scurve_setup(&r, w0, w1, c0);
+    uint32_t dt = 0;
+    for (uint32_t t = 0; t <= r.len + 1000; t += dt)
+    {
+      double u = t < r.len ? (double)t / r.len : 1;
+      double w = w0 + (w1 - w0) * u * u * (3 - 2 * u);
+      double c = c0 * 0.5 / sqrt(w * w + 0.5);
+      double err = fabs(scurve_c(&g, &r, dt) / 1024.0 - c);
+      err = err <= 1 / 1024.0 ? 0 : err / c;
+      if (err > worst)
+        worst = err;
+      dt = 1 + rand() % (1 + r.len / 32);
+    }
+  }
+  printf("S-curve period: relative error %.2g\n", worst);
+  CHECK(worst < 3e-4);
+}
+
+// The speed profile of the executed steps, in bins of BIN [mm/sec], with the
+// steps moving at a constant speed over their (unrounded) period. A bin is
+// 'slow' if a step in it takes more than a quarter of it: near standstill
+// the steps themselves are the jerk.
+static void profile(std::vector<double> &v, std::vector<bool> &slow)
+{
+  v.clear();
+  slow.clear();
+  double t = 0, bin_mm = 0;
+  bool bin_slow = false;
+  for (size_t i = 0; i < st_steps.size(); i++)
+  {
+    double dt = st_steps[i].c * 1e-6, speed = st_steps[i].mm / dt;
+    bin_slow = bin_slow || dt > BIN / 4;
+    while (t + dt >= BIN)
+    {
+      double part = BIN - t;
+      bin_mm += speed * part;
+      v.push_back(bin_mm / BIN);
+      slow.push_back(bin_slow);
+      dt -= part;
+      bin_mm = 0;
+      bin_slow = dt > 0 && st_steps[i].c * 1e-6 > BIN / 4;
+      t = 0;
+    }
+    bin_mm += speed * dt;
+    t += dt;
+  }
+}
+
+typedef struct {
+  double time;   // [sec]
+  double accel;  // peak acceleration [mm/sec2]
+  double jerk;   // peak jerk [mm/sec3]
+} tRun;
+
+// Run the job with or without S-curve ramps, timed step by step
+static tRun run(const std::vector<int> &job, int scurve, bool steps = true)
+{
+  cfg->scurve = scurve; // the planner reads it at boot
+  host_power_cycle();
+  mot->home(0, 0, 0);
+  mot->setOriginAbsolute(0, 0, 0);
+  mot->reset();
+  st_host_steps = steps;
+  host_feed(job, 0, job.size());
+  host_end_job();
+  host_drain();
+  st_host_steps = false;
+  cfg->scurve = 0;
+
+  tRun r = { st_time, 0, 0 };
+  std::vector<double> v;
+  std::vector<bool> slow;
+  profile(v, slow);
+  double a_prev = 0;
+  for (size_t i = 1; i < v.size(); i++)
+  {
+    double a = (v[i] - v[i-1]) / BIN;
+    if (!slow[i] && !slow[i-1] && fabs(a) > r.accel)
+      r.accel = fabs(a);
+    if (i > 1 && !slow[i] && !slow[i-1] && !slow[i-2] && fabs(a - a_prev) / BIN > r.jerk)
+      r.jerk = fabs(a - a_prev) / BIN;
+    a_prev = a;
+  }
+  return r;
+}
+
+// Lines with corners, from and to standstill, at full speed
+static void test_job()
+{
+  int start[] = { 7, 100, 10000, 7, 101, 5000, 0, 0, 0 };
+  std::vector<int> job(start, start + sizeof(start) / sizeof(start[0]));
+  int lines[] = { 100000, 0, 100000, 60000, 20000, 60000, 20000, 10000, 60000, 40000 };
+  for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i += 2)
+  {
+    job.push_back(1);
+    job.push_back(lines[i]);
+    job.push_back(lines[i+1]);
+  }
+
+  double planned = run(job, 0, false).time;
+  tRun linear = run(job, 0);
+  double accel = 0; // of the ramps with linear ramps, the limit of the axes on the path
+  for (size_t i = 0; i < st_trace.size(); i++)
+    if (st_trace[i].accel > accel)
+      accel = st_trace[i].accel;
+  tRun scurve = run(job, 1);
+  printf("linear ramps: %.3f sec (planned %.3f), peak acceleration %.0f mm/sec2, peak jerk %.0f mm/sec3\n",
+    linear.time, planned, linear.accel, linear.jerk);
+  printf("S-curve ramps: %.3f sec, peak acceleration %.0f mm/sec2, peak jerk %.0f mm/sec3\n",
+    scurve.time, scurve.accel, scurve.jerk);
+  CHECK(fabs(linear.time - planned) < planned * 0.02);
+  CHECK(linear.accel < accel * 1.05);
+  CHECK(scurve.accel < accel * 1.05);
+  CHECK(scurve.jerk * 10 < linear.jerk);
+  CHECK(scurve.time > linear.time);
+  CHECK(scurve.time < linear.time * SCURVE_PEAK);
+}
+
+int main()
+{
+  host_init();
+  test_period();
+  test_job();
+  return TEST_RESULT("test_scurve");
+}
@@ -0,0 +1,187 @@
+/**
+ * test_tftp.cpp
+ * TFTP uploads over a stand-in socket and card: the file is written in
+ * whole, sector aligned buffers (writes per MB); a full card ends the
+ * upload with an ERROR and no file; netascii uploads store CR LF as LF
+ *
+ *   This file is part of the LaOS project (see: http://wiki.laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include "TFTPServer.h" // before the max() of stepper.h
+#include "motion_host.h"
+#include "test.h"
+
+LaosFileSystem sd;
+std::deque<std::string> udp_in, udp_out;
+tFatStats fat_stats;
+
+static TFTPServer *srv;
+
+static std::string packet(int opcode)
+{
+  std::string p(2, 0);
+  p[1] = opcode;
+  return p;
+}
+
+static int opcode(const std::string &p)
+{
+  return p.size() < 2 ? -1 : p[1];
+}
+
+static int block(const std::string &p)
+{
+  return ((unsigned char)p[2] << 8) + (unsigned char)p[3];
+}
+
+// The card: a directory, with 'room' bytes free (< 0: no limit)
+static void card(long room)
+{
+  memset(&fat_stats, 0, sizeof(fat_stats));
+  fat_stats.room = room;
+  udp_out.clear();
+}
+
+// Send the file the way a client does: WRQ (with tsize, or not), then DATA
+// blocks of 512 bytes, each when the previous one is acknowledged; false
+// if the server sent an ERROR
+static bool upload(const char *name, const std::string &data, const char *mode = "octet",
+  bool tsize = true)
+{
+  std::string wrq = packet(2) + name + '\0' + mode + '\0';
+  if (tsize)
+  {
+    char size[16];
+    sprintf(size, "%d", (int)data.size());
+    wrq += std::string("tsize") + '\0' + size + '\0';
+  }
+  udp_in.push_back(wrq);
+  srv->poll();
+  if (udp_out.empty() || opcode(udp_out.back()) != (tsize ? 6 : 4))
+    return false;
+  for (size_t i = 0; i <= data.size(); i += 512)
+  {
+    std::string p = packet(3);
+    int n = i / 512 + 1;
+    p += (char)(n >> 8);
+    p += (char)(n & 255);
+    p += data.substr(i, 512);
+    udp_in.push_back(p);
+    srv->poll();
+    if (opcode(udp_out.back()) != 4 || block(udp_out.back()) != n)
+      return false;
+  }
+  return true;
+}
+
+static std::string contents(const char *name)
+{
+  std::string s;
+  FILE *fp = sd.openfile((char *)name, "rb");
+  int c;
+  while (fp != NULL && (c = getc(fp)) != EOF)
+    s += (char)c;
+  if (fp != NULL)
+    fclose(fp);
+  return s;
+}
+
+static bool exists(const char *name)
+{
+  FILE *fp = sd.openfile((char *)name, "rb");
+  if (fp != NULL)
+    fclose(fp);
+  return fp != NULL;
+}
+
+// 1 MB and a bit: one write per TFTP_WRITEBUF_SIZE, all of whole sectors
+// but the last
+static void test_sectors()
+{
+  std::string data;
+  for (int i = 0; i < (1 << 20) + 300; i++)
+    data += (char)rand();
+  card(-1);
+  int files = srv->fileCnt();
+  CHECK(upload("big.lgc", data));
+  CHECK(srv->fileCnt() == files + 1);
+  CHECK(contents("big.lgc") == data);
+  printf("upload of %d bytes: %d writes (%.0f per MB, %d packets), %d not of whole sectors\n",
+    (int)data.size(), fat_stats.writes, fat_stats.writes * 1048576.0 / data.size(),
+    (int)data.size() / 512 + 1, fat_stats.unaligned);
+  CHECK(fat_stats.writes == (int)(data.size() + TFTP_WRITEBUF_SIZE - 1) / TFTP_WRITEBUF_SIZE);
+  CHECK(fat_stats.unaligned == 1);
+}
+
+// A full card: ERROR, no file, not counted as received; with tsize the
+// upload is refused at once
+static void test_full()
+{
+  std::string data(100000, 'x');
+  for (int tsize = 0; tsize < 2; tsize++)
+  {
+    card(60000);
+    int files = srv->fileCnt();
+    CHECK(!upload("full.lgc", data, "octet", tsize));
+    CHECK(opcode(udp_out.back()) == 5);
+    CHECK(!exists("full.lgc"));
+    CHECK(srv->fileCnt() == files);
+    CHECK(srv->State() == listen);
+    if (!tsize) // the ERROR answers the block that filled the buffer that did not fit
+      CHECK(udp_out.size() > 2 &&
+        block(udp_out[udp_out.size()-2]) == (60000 / TFTP_WRITEBUF_SIZE + 1) * (TFTP_WRITEBUF_SIZE / 512) - 1);
+  }
+  // the last buffer does not fit: the last DATA gets no ACK
+  card(TFTP_WRITEBUF_SIZE);
+  CHECK(!upload("full.lgc", std::string(TFTP_WRITEBUF_SIZE + 100, 'x'), "octet", false));
+  CHECK(!exists("full.lgc"));
+}
+
+// netascii: CR LF is LF, CR NUL is CR, also across DATA blocks; a CR at
+// the end stays
+static void test_netascii()
+{
+  std::string data = "1 2 3\r\n" + std::string(504, 'a') + "\r\n5\r" + std::string(1, '\0')
+    + "c\rd\r";
+  std::string expect = "1 2 3\n" + std::string(504, 'a') + "\n5\rc\rd\r";
+  CHECK(data[511] == '\r'); // at the end of the first block
+  card(-1);
+  CHECK(upload("text.txt", data, "netascii"));
+  CHECK(contents("text.txt") == expect);
+  CHECK(upload("text.txt", data, "NetAscii", false));
+  CHECK(contents("text.txt") == expect);
+  CHECK(upload("bin.txt", data, "octet"));
+  CHECK(contents("bin.txt") == data);
+}
+
+int main()
+{
+  char dir[] = "/tmp/laostftpXXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  sprintf(sd.pathname, "%s/", dir);
+  host_init();
+  srv = new TFTPServer();
+  srand(1);
+  test_sectors();
+  test_full();
+  test_netascii();
+  delete srv;
+  std::string rm = std::string("rm -rf ") + dir;
+  CHECK(system(rm.c_str()) == 0);
+  return TEST_RESULT("test_tftp");
+}